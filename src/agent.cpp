@@ -1,9 +1,23 @@
 #include "agent.hpp"
+#include "endgame.hpp"
 #include "game.hpp"
+#include "pool.hpp"
 #include "rng.hpp"
+#include "solitaire.hpp"
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cmath>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <tuple>
 
 /**
  * @brief The function implementing the human policy for making moves.
@@ -360,9 +374,23 @@ std::optional<size_t> RushLocks::make_move(bool first_action, std::span<const Mo
 
 /**
  * @brief Constructor for the computational agent.
+ * @details Uses the configured parameters (see Parameters::configured()).
+ */
+Computational::Computational() : Computational(Parameters::configured()) {}
+
+/**
+ * @brief Constructor for the computational agent with the given parameters.
  * @details Calls the base class constructor, then initializes m_basic_values with penalty and frequency values.
+ * @param parameters A read-only reference to the parameters of the agent.
  */
-Computational::Computational() : Agent(), m_basic_values{} {
+Computational::Computational(const Parameters& parameters)
+    : Agent(),
+      m_alpha(parameters.alpha),
+      m_mu(parameters.mu),
+      m_delta(parameters.delta),
+      m_sigma(parameters.sigma),
+      m_epsilon(parameters.epsilon),
+      m_basic_values{} {
     // The base penalty for the leftmost space is 12, since that would be the value of this space
     // if this space plus every space to its right were marked
     int penalty = 12;
@@ -387,6 +415,84 @@ Computational::Computational() : Agent(), m_basic_values{} {
     }
 }
 
+/**
+ * @brief Reads parameters from a text file.
+ * @details The file holds one "name value" line for each of alpha, mu, delta, sigma, and epsilon, in any order, as
+ * written by save(). Blank lines and lines starting with # are ignored.
+ * @param path A read-only reference to a string holding the path of the file.
+ * @return The Parameters read from the file.
+ * @throws std::runtime_error if the file cannot be opened, or does not set every parameter exactly once.
+ */
+Computational::Parameters Computational::Parameters::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("Could not open the parameter file " + path + ".");
+    }
+
+    Parameters parameters;
+    const std::array<std::tuple<const char*, double*>, 5> fields = {
+        std::tuple("alpha", &parameters.alpha), std::tuple("mu", &parameters.mu), std::tuple("delta", &parameters.delta),
+        std::tuple("sigma", &parameters.sigma), std::tuple("epsilon", &parameters.epsilon)
+    };
+    std::array<bool, 5> found{};
+
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream iss(line);
+        std::string name;
+        if (!(iss >> name) || name[0] == '#') {
+            continue;
+        }
+
+        size_t f = 0;
+        while (f < fields.size() && name != std::get<0>(fields[f])) {
+            ++f;
+        }
+        double value = 0.0;
+        if (f == fields.size() || found[f] || !(iss >> value) || !(iss >> std::ws).eof()) {
+            throw std::runtime_error("Invalid line in the parameter file " + path + ": " + line);
+        }
+        *std::get<1>(fields[f]) = value;
+        found[f] = true;
+    }
+
+    if (std::find(found.begin(), found.end(), false) != found.end()) {
+        throw std::runtime_error("The parameter file " + path + " does not set every parameter.");
+    }
+    return parameters;
+}
+
+/**
+ * @brief Writes the parameters to a text file that load() can read back exactly.
+ * @param path A read-only reference to a string holding the path of the file.
+ * @throws std::runtime_error if the file cannot be written.
+ */
+void Computational::Parameters::save(const std::string& path) const {
+    std::ofstream file(path);
+    file << std::setprecision(std::numeric_limits<double>::max_digits10)
+         << "alpha " << alpha << "\nmu " << mu << "\ndelta " << delta << "\nsigma " << sigma << "\nepsilon " << epsilon << '\n';
+    file.close();
+    if (!file) {
+        throw std::runtime_error("Could not write the parameter file " + path + ".");
+    }
+}
+
+/**
+ * @brief Gets the parameters used by default-constructed computational agents.
+ * @details The parameters are read once, from the file whose path is in the environment variable
+ * QWIXX_COMPUTATIONAL_PARAMETERS (e.g. the best parameters written by --tune). Without this variable, the defaults
+ * are used.
+ * @return A read-only reference to the parameters.
+ * @throws std::runtime_error if the file cannot be read.
+ */
+const Computational::Parameters& Computational::Parameters::configured() {
+    static const Parameters parameters = [] {
+        const char* path = std::getenv("QWIXX_COMPUTATIONAL_PARAMETERS");
+        return (path != nullptr && path[0] != '\0') ? load(path) : Parameters{};
+    }();
+    return parameters;
+}
+
 std::optional<size_t> Computational::make_move(bool first_action, std::span<const Move> current_action_legal_moves, std::span<const Move> action_two_possible_moves, const State& state) {
     if (first_action) {
         m_made_first_action_move = false;
@@ -456,8 +562,8 @@ std::optional<size_t> Computational::make_move(bool first_action, std::span<cons
     };
     
     // Keep track of scores for both the current action and for the second action
-    std::vector<MoveValue> current_action_scores{};
-    std::vector<MoveValue> action_two_scores{};
+    FixedVector<MoveValue, GameConstants::MAX_LEGAL_MOVES> current_action_scores{};
+    FixedVector<MoveValue, GameConstants::MAX_LEGAL_MOVES> action_two_scores{};
 
     if (first_action) {
         std::optional<size_t> action_one_choice = std::nullopt;
@@ -548,4 +654,1124 @@ std::optional<size_t> Computational::make_move(bool first_action, std::span<cons
         // Return the choice
         return action_two_choice;
     }
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Constructor for the solitaire agent.
+ * @details Calls the base class constructor, then maps the value table at SolitaireTable::default_path() and looks up
+ * the configured endgame table, if any.
+ * @throws std::runtime_error if a table cannot be loaded.
+ */
+Solitaire::Solitaire()
+    : Agent(),
+      m_table(SolitaireTable::load(SolitaireTable::default_path())),
+      m_endgame_table(EndgameTable::configured()) {}
+
+/**
+ * @brief The function implementing the solitaire policy for making moves.
+ * @details Plays as if it were alone in the game, choosing the moves that maximize its points plus the optimal expected
+ * future score of the resulting solitaire position. Rows locked by other players count as locked, but the agent does
+ * not account for the extra marks it may get when other players are active, nor for the game ending earlier because
+ * of the penalties or locks of other players. As the active player, the first action is chosen together with the best
+ * second action it allows, since the penalty only applies if neither action is used. In 2-player lock races, if an
+ * endgame table is configured, the moves are chosen from the exact win probabilities instead (see endgame_move()).
+ * Also see the other documentation for make_move() in the Agent base class (src/agent.hpp).
+ */
+std::optional<size_t> Solitaire::make_move(bool first_action, std::span<const Move> current_action_legal_moves, std::span<const Move> action_two_possible_moves, const State& state) {
+    if (first_action) {
+        m_made_first_action_move = false;
+    }
+
+    std::optional<size_t> endgame_choice = std::nullopt;
+    if (endgame_move(first_action, current_action_legal_moves, action_two_possible_moves, state, endgame_choice)) {
+        m_made_first_action_move = m_made_first_action_move || (first_action && endgame_choice.has_value());
+        return endgame_choice;
+    }
+
+    const SolitaireTable::Rows rows = SolitaireTable::row_states(state.scorepads[m_position], state);
+    const int penalties = state.scorepads[m_position].get_num_penalties();
+
+    // Lambda to mark a move on a copy of the rows, returning the points scored, or -1 if the move can no longer be marked
+    auto mark = [](SolitaireTable::Rows& marked_rows, const Move move) {
+        const size_t row = static_cast<size_t>(move.color);
+        const int next = SolitaireTable::mark(marked_rows[row], move.index);
+        if (next < 0) {
+            return -1;
+        }
+        const int points = SolitaireTable::mark_points(marked_rows[row], move.index);
+        marked_rows[row] = next;
+        return points;
+    };
+
+    // Lambda to get the best value of the second action from the given rows, starting from the value of not marking
+    auto best_second_action = [&](const SolitaireTable::Rows& from, double best) {
+        for (const Move move : action_two_possible_moves) {
+            SolitaireTable::Rows marked_rows = from;
+            const int points = mark(marked_rows, move);
+            if (points >= 0) {
+                best = std::max(best, points + m_table->value(marked_rows, penalties));
+            }
+        }
+        return best;
+    };
+
+    const double penalty_value = -GameConstants::PENALTY_VALUE + m_table->value(rows, penalties + 1);
+    const bool active = (state.curr_player == m_position);
+
+    // Value of passing
+    double best;
+    if (first_action) {
+        best = active ? best_second_action(rows, penalty_value) : m_table->value(rows, penalties);
+    }
+    else {
+        best = m_made_first_action_move ? m_table->value(rows, penalties) : penalty_value;
+    }
+
+    std::optional<size_t> choice = std::nullopt;
+    for (size_t i = 0; i < current_action_legal_moves.size(); ++i) {
+        SolitaireTable::Rows marked_rows = rows;
+        const int points = mark(marked_rows, current_action_legal_moves[i]);
+        if (points < 0) {
+            continue;
+        }
+
+        double value = points + m_table->value(marked_rows, penalties);
+        if (first_action && active && !SolitaireTable::is_terminal(marked_rows, penalties)) {
+            value = points + best_second_action(marked_rows, m_table->value(marked_rows, penalties));
+        }
+
+        if (value > best) {
+            best = value;
+            choice = i;
+        }
+    }
+
+    // Remember if we made a move during the first action
+    if (first_action && choice.has_value()) {
+        m_made_first_action_move = true;
+    }
+
+    return choice;
+}
+
+/**
+ * @brief Chooses a move from the endgame table, if the position is a lock race.
+ * @details In a lock race (see EndgameTable), every legal move is a lock, which ends the game. Not locking leads to the
+ * active player's second action, then to a penalty and the next turn, whose value is read from the table. In the first
+ * action, a player locks if the other player can lock too (both locking is a saddle point), and otherwise compares
+ * locking with the value of the active player's second action on the same dice.
+ * @param choice A reference to a size_t option receiving the chosen move, if the position is a lock race.
+ * @return A bool which is true if the position is a lock race and a move was chosen, else false.
+ */
+bool Solitaire::endgame_move(bool first_action, std::span<const Move> current_action_legal_moves, std::span<const Move> action_two_possible_moves,
+                             const State& state, std::optional<size_t>& choice) const {
+    if (m_endgame_table == nullptr) {
+        return false;
+    }
+    const std::optional<size_t> closed = EndgameTable::closed_row(state);
+    if (!closed.has_value()) {
+        return false;
+    }
+
+    const size_t mover = state.curr_player;
+    const size_t other = 1 - mover;
+    const std::optional<int> mover_index = EndgameTable::player_index(state.scorepads[mover], closed.value());
+    const std::optional<int> other_index = EndgameTable::player_index(state.scorepads[other], closed.value());
+    if (!mover_index.has_value() || !other_index.has_value()) {
+        return false;
+    }
+
+    const int mover_diff = state.scorepads[mover].get_score() - state.scorepads[other].get_score();
+    const int diff = (m_position == mover) ? mover_diff : -mover_diff;
+
+    // Lambda to get the points a player scores by marking a lock
+    auto lock_points = [&](size_t player, const Move move) {
+        return 2 * state.scorepads[player].get_num_marks(move.color) + 3;
+    };
+
+    // Value for the mover of its second action, after no lock in the first action: its best lock, or a penalty
+    double penalty_value;
+    if (state.scorepads[mover].get_num_penalties() + 1 == GameConstants::MAX_PENALTIES) {
+        penalty_value = EndgameTable::result(mover_diff - GameConstants::PENALTY_VALUE);
+    }
+    else {
+        // The penalty count is the last digit of the player index
+        penalty_value = 1.0 - m_endgame_table->value(other_index.value(), mover_index.value() + 1, GameConstants::PENALTY_VALUE - mover_diff);
+    }
+    double second_action_value = penalty_value;
+    for (const Move move : action_two_possible_moves) {
+        second_action_value = std::max(second_action_value, EndgameTable::result(mover_diff + lock_points(mover, move)));
+    }
+
+    // Our best lock in the current action
+    choice = std::nullopt;
+    int points = 0;
+    for (size_t i = 0; i < current_action_legal_moves.size(); ++i) {
+        const int move_points = lock_points(m_position, current_action_legal_moves[i]);
+        if (move_points > points) {
+            points = move_points;
+            choice = i;
+        }
+    }
+
+    if (!first_action) {
+        if (EndgameTable::result(diff + points) <= penalty_value) {
+            choice = std::nullopt;
+        }
+        return true;
+    }
+
+    // Whether the other player can lock with the same white dice
+    const size_t opponent = 1 - m_position;
+    const int white_sum = index_to_value(current_action_legal_moves[0].color, current_action_legal_moves[0].index);
+    bool opponent_can_lock = false;
+    for (size_t j = 0; j < GameConstants::NUM_ROWS; ++j) {
+        const Color color = static_cast<Color>(j);
+        opponent_can_lock = opponent_can_lock || (!state.locked_rows[j] && index_to_value(color, GameConstants::LOCK_INDEX) == white_sum
+                                                  && state.scorepads[opponent].get_num_marks(color) >= GameConstants::MIN_MARKS_FOR_LOCK);
+    }
+
+    const double continuation = (m_position == mover) ? second_action_value : 1.0 - second_action_value;
+    if (!opponent_can_lock && EndgameTable::result(diff + points) <= continuation) {
+        choice = std::nullopt;
+    }
+    return true;
+}
+
+/**
+ * @struct SearchTurn
+ * @brief The dice of a turn, as far as the search agents need them.
+ * @details The first action only depends on the sum of the white dice, and the second action on the moves that the
+ * dice allow the active player. These moves are checked for legality again after the first action.
+ */
+struct SearchTurn {
+    int white_sum;                                                          //< Sum of the white dice.
+    FixedVector<Move, GameConstants::MAX_LEGAL_MOVES> action_two_moves;     //< Second action moves of the active player, before the first action.
+};
+
+/**
+ * @brief Checks whether a player can mark a move in a searched state.
+ * @param state A read-only reference to the searched state.
+ * @param player A size_t representing the player.
+ * @param move The move to check.
+ * @return A bool which is true if the move's row is still in the game and the space can be marked, else false.
+ */
+static bool search_is_legal(const State& state, size_t player, const Move move) {
+    return !state.locked_rows[static_cast<size_t>(move.color)]
+           && ((legal_mask_table[state.scorepads[player].get_row_mask(move.color)] >> move.index) & 1);
+}
+
+/**
+ * @brief Computes what the search agents need to know about a roll of the dice at the start of a turn.
+ * @param state A read-only reference to the searched state at the start of the turn.
+ * @param rolls A read-only reference to the rolls of the white dice, followed by the colored dice in the order of the Color enum.
+ * The rolls of the dice of locked rows are ignored.
+ * @return The SearchTurn of the roll.
+ */
+static SearchTurn search_turn(const State& state, const std::array<int, GameConstants::NUM_DICE>& rolls) {
+    SearchTurn turn{};
+    turn.white_sum = rolls[0] + rolls[1];
+    for (size_t j = 0; j < GameConstants::NUM_ROWS; ++j) {
+        if (state.locked_rows[j]) {
+            continue;
+        }
+
+        // Both white dice give the same move if they are equal
+        const size_t num_white = (rolls[0] == rolls[1]) ? 1 : 2;
+        for (size_t w = 0; w < num_white; ++w) {
+            const Move move = {static_cast<Color>(j), sum_to_index_table[j][rolls[w] + rolls[2 + j]]};
+            if (search_is_legal(state, state.curr_player, move)) {
+                turn.action_two_moves.push_back(move);
+            }
+        }
+    }
+    return turn;
+}
+
+/**
+ * @brief Closes the rows locked during an action of a searched state, as Game::run() does.
+ * @param state A reference to the searched state, whose locks bitset holds the new locks.
+ */
+static void search_apply_locks(State& state) {
+    for (size_t j = 0; j < GameConstants::NUM_ROWS; ++j) {
+        if (state.locks.test(j)) {
+            state.lock_row(j);
+            for (Scorepad& scorepad : state.scorepads) {
+                scorepad.close_row(static_cast<Color>(j));
+            }
+            ++state.num_locks;
+        }
+    }
+    state.locks.reset();
+    if (state.num_locks >= 2) {
+        state.is_terminal = true;
+    }
+}
+
+/**
+ * @brief Constructor for the expectimax agent.
+ * @details Calls the base class constructor and sets the node budget. A time budget per move can be added with the
+ * environment variable QWIXX_SEARCH_MS, in milliseconds. The search then stops at whichever budget runs out first, so
+ * its moves depend on the speed of the machine, and trials using it are not reproducible.
+ * @param max_nodes A long long representing the number of nodes the agent may search per move.
+ * @throws std::runtime_error if QWIXX_SEARCH_MS is set but is not a positive number of milliseconds.
+ */
+Expectimax::Expectimax(long long max_nodes)
+    : Agent(),
+      m_max_nodes(max_nodes),
+      m_max_time(0),
+      m_transpositions(LOG2_TRANSPOSITION_BUCKETS) {
+
+    if (const char* max_time = std::getenv("QWIXX_SEARCH_MS")) {
+        char* end = nullptr;
+        const long long milliseconds = std::strtoll(max_time, &end, 10);
+        if (end == max_time || *end != '\0' || milliseconds <= 0) {
+            throw std::runtime_error("QWIXX_SEARCH_MS must be a positive number of milliseconds.");
+        }
+        m_max_time = std::chrono::milliseconds(milliseconds);
+    }
+}
+
+/**
+ * @brief The function implementing the expectimax policy for making moves.
+ * @details Searches the turns ahead with depth-limited expectimax, and chooses the move with the best value. A turn is
+ * searched as a sequence of decisions: the first action moves of every player, starting with this agent and followed
+ * by the other players in seating order, then the second action move of the active player. This agent maximizes the
+ * value, and the other players minimize it, as if they knew its first action move (a cautious model, which in games
+ * with more than 2 players also assumes that they play against this agent). The dice of the next turn are a chance
+ * node. Enumerating them exactly means 21 white rolls times up to 1296 colored rolls, so SAMPLES_PER_CHANCE_NODE rolls
+ * are sampled from the game's generator instead (sparse sampling), and the value is their average. The rolls are sampled
+ * once per move and depth, and shared by all chance nodes at that depth: the moves are then compared on the same dice,
+ * which keeps the sampling noise from growing with the number of nodes compared. At the depth limit,
+ * positions are scored with the 2-player evaluation function (see leaf_value()), and finished games with their result.
+ *
+ * The search is repeated with depths 0, 1, 2, and so on (iterative deepening), and stops once the node budget, or the
+ * time budget if one is set, runs out. The move of the deepest search that finished is played, and the search at
+ * depth 0 always finishes. The values of chance nodes are kept in a transposition table keyed by State::key() and the
+ * turn count (capped at Evaluator2p::RAMP_END, since the weights of the evaluation function depend on it up to there),
+ * so a position reached through moves in a different order is only searched once, and a value stored by one iteration
+ * is not reused by the next for the same position one turn later. Each move starts a new search of the
+ * table, whose earlier entries then no longer match, which keeps the moves reproducible under a node budget regardless
+ * of which games the agent played before.
+ * Also see the other documentation for make_move() in the Agent base class (src/agent.hpp).
+ */
+std::optional<size_t> Expectimax::make_move(bool first_action, std::span<const Move> current_action_legal_moves, std::span<const Move> action_two_possible_moves, const State& state) {
+    if (first_action) {
+        m_made_first_action_move = false;
+    }
+
+    // Every first action move is for the sum of the white dice
+    SearchTurn turn{};
+    if (first_action) {
+        turn.white_sum = index_to_value(current_action_legal_moves[0].color, current_action_legal_moves[0].index);
+        for (const Move move : action_two_possible_moves) {
+            turn.action_two_moves.push_back(move);
+        }
+    }
+
+    // Lambda to search every choice at the given depth, returning the best one
+    auto search = [&](int depth) {
+        std::optional<size_t> choice = std::nullopt;
+        double best = 0.0;
+        for (size_t i = 0; i <= current_action_legal_moves.size() && !m_aborted; ++i) {
+            // The first choice is passing
+            const std::optional<Move> move = (i == 0) ? std::nullopt : std::optional<Move>(current_action_legal_moves[i - 1]);
+
+            double value;
+            if (first_action) {
+                std::array<std::optional<Move>, GameConstants::MAX_PLAYERS> chosen{};
+                value = first_action_value(state, turn, depth, 0, chosen, &move);
+            }
+            else {
+                State next = state;
+                if (move.has_value()) {
+                    next.scorepads[m_position].mark_move(move.value());
+                    if (move.value().index == GameConstants::LOCK_INDEX) {
+                        next.locks.set(static_cast<size_t>(move.value().color));
+                    }
+                    search_apply_locks(next);
+                }
+                value = end_turn_value(next, m_made_first_action_move || move.has_value(), depth);
+            }
+
+            if (i == 0 || value > best) {
+                best = value;
+                choice = (i == 0) ? std::nullopt : std::optional<size_t>(i - 1);
+            }
+        }
+        return choice;
+    };
+
+    // Sample the rolls of the chance nodes, one set per depth
+    for (auto& depth_rolls : m_sampled_rolls) {
+        for (auto& rolls : depth_rolls) {
+            for (int& roll : rolls) {
+                roll = Philox::to_die(rng()());
+            }
+        }
+    }
+
+    m_transpositions.new_search();
+    m_nodes = 0;
+    m_deadline = std::chrono::steady_clock::now() + m_max_time;
+
+    // The search at depth 0 ignores the budget, so that there is always a move to play
+    m_can_abort = false;
+    m_aborted = false;
+    std::optional<size_t> choice = search(0);
+
+    m_can_abort = true;
+    for (int depth = 1; depth <= MAX_DEPTH && !out_of_budget(); ++depth) {
+        const std::optional<size_t> deeper_choice = search(depth);
+        if (m_aborted) {
+            break;
+        }
+        choice = deeper_choice;
+    }
+
+    // Remember if we made a move during the first action
+    if (first_action && choice.has_value()) {
+        m_made_first_action_move = true;
+    }
+
+    return choice;
+}
+
+/**
+ * @brief Searches the first action moves of the players from the given chooser on.
+ * @details Players choose in the order given in make_move(). Once every player has chosen, the turn is resolved by
+ * resolve_turn().
+ * @param state A read-only reference to the state at the start of the turn.
+ * @param turn A read-only reference to the dice of the turn.
+ * @param depth An int representing the number of turns left to search after this one.
+ * @param chooser A size_t representing the number of players that have already chosen.
+ * @param chosen A reference to an array holding the first action move chosen by each player so far.
+ * @param own_move A pointer to the first action move of this agent, or nullptr if it should be searched.
+ * @return A double representing the value of the turn for this agent.
+ */
+double Expectimax::first_action_value(const State& state, const SearchTurn& turn, int depth, size_t chooser,
+                                      std::array<std::optional<Move>, GameConstants::MAX_PLAYERS>& chosen, const std::optional<Move>* own_move) {
+    const size_t num_players = state.scorepads.size();
+    if (chooser == num_players) {
+        return resolve_turn(state, turn, depth, chosen);
+    }
+
+    const size_t player = (m_position + chooser) % num_players;
+    if (player == m_position && own_move != nullptr) {
+        chosen[player] = *own_move;
+        return first_action_value(state, turn, depth, chooser + 1, chosen, own_move);
+    }
+
+    const bool maximizing = (player == m_position);
+    chosen[player] = std::nullopt;
+    double best = first_action_value(state, turn, depth, chooser + 1, chosen, own_move);
+
+    for (size_t j = 0; j < GameConstants::NUM_ROWS && !m_aborted; ++j) {
+        const Color color = static_cast<Color>(j);
+        const Move move = {color, sum_to_index_table[j][turn.white_sum]};
+        if (!search_is_legal(state, player, move)) {
+            continue;
+        }
+
+        chosen[player] = move;
+        const double value = first_action_value(state, turn, depth, chooser + 1, chosen, own_move);
+        best = maximizing ? std::max(best, value) : std::min(best, value);
+    }
+
+    return best;
+}
+
+/**
+ * @brief Commits the first action moves of a turn, then searches the second action of the active player.
+ * @param state A read-only reference to the state at the start of the turn.
+ * @param turn A read-only reference to the dice of the turn.
+ * @param depth An int representing the number of turns left to search after this one.
+ * @param chosen A read-only reference to an array holding the first action move chosen by each player.
+ * @return A double representing the value of the turn for this agent.
+ */
+double Expectimax::resolve_turn(const State& state, const SearchTurn& turn, int depth, const std::array<std::optional<Move>, GameConstants::MAX_PLAYERS>& chosen) {
+    ++m_nodes;
+    const size_t mover = state.curr_player;
+
+    State next = state;
+    for (size_t i = 0; i < next.scorepads.size(); ++i) {
+        if (chosen[i].has_value()) {
+            next.scorepads[i].mark_move(chosen[i].value());
+            if (chosen[i].value().index == GameConstants::LOCK_INDEX) {
+                next.locks.set(static_cast<size_t>(chosen[i].value().color));
+            }
+        }
+    }
+    search_apply_locks(next);
+    if (next.is_terminal) {
+        return terminal_value(next);
+    }
+
+    // Value of passing in the second action
+    const bool maximizing = (mover == m_position);
+    double best = end_turn_value(next, chosen[mover].has_value(), depth);
+
+    for (const Move move : turn.action_two_moves) {
+        if (m_aborted) {
+            break;
+        }
+        if (!search_is_legal(next, mover, move)) {
+            continue;
+        }
+
+        State after = next;
+        after.scorepads[mover].mark_move(move);
+        if (move.index == GameConstants::LOCK_INDEX) {
+            after.locks.set(static_cast<size_t>(move.color));
+        }
+        search_apply_locks(after);
+
+        const double value = end_turn_value(after, true, depth);
+        best = maximizing ? std::max(best, value) : std::min(best, value);
+    }
+
+    return best;
+}
+
+/**
+ * @brief Ends a turn, giving the active player a penalty if they made no move, and moves on to the next turn.
+ * @param state A copy of the state after both actions of the turn.
+ * @param active_player_made_move A bool which is true if the active player made a move during the turn, else false.
+ * @param depth An int representing the number of turns left to search.
+ * @return A double representing the value of the position for this agent.
+ */
+double Expectimax::end_turn_value(State state, bool active_player_made_move, int depth) {
+    if (!active_player_made_move && state.scorepads[state.curr_player].mark_penalty()) {
+        state.is_terminal = true;
+    }
+    if (state.is_terminal) {
+        return terminal_value(state);
+    }
+
+    state.set_curr_player((state.curr_player + 1) % state.scorepads.size());
+    return next_turn_value(state, depth);
+}
+
+/**
+ * @brief Computes the value of a position at the start of a turn.
+ * @details At depth 0, the position is scored by leaf_value(). Otherwise, this is a chance node over the dice of the
+ * turn: its value is the average over the rolls sampled for this depth of the value of the turn, searched to one turn
+ * less. These values are stored in the transposition table.
+ * @param state A read-only reference to the state at the start of the turn.
+ * @param depth An int representing the number of turns left to search.
+ * @return A double representing the value of the position for this agent, or 0 if the search ran out of budget.
+ */
+double Expectimax::next_turn_value(const State& state, int depth) {
+    ++m_nodes;
+    if (out_of_budget()) {
+        return 0.0;
+    }
+    if (depth == 0) {
+        return leaf_value(state);
+    }
+
+    // The leaves below are scored with weights that depend on the turn count, until it reaches RAMP_END
+    static_assert(Evaluator2p::RAMP_END < static_cast<int>(ZobristKeys::NUM_TURN_COUNT_KEYS));
+    const std::uint64_t key = state.key() ^ zobrist_keys.turn_counts[static_cast<size_t>(std::min(state.turn_count, Evaluator2p::RAMP_END))];
+    if (const std::optional<double> value = m_transpositions.probe(key, depth)) {
+        return value.value();
+    }
+
+    double total = 0.0;
+    for (int sample = 0; sample < SAMPLES_PER_CHANCE_NODE; ++sample) {
+        const SearchTurn turn = search_turn(state, m_sampled_rolls[depth - 1][sample]);
+
+        State next = state;
+        next.turn_count += 1;
+        std::array<std::optional<Move>, GameConstants::MAX_PLAYERS> chosen{};
+        total += first_action_value(next, turn, depth - 1, 0, chosen, nullptr);
+        if (m_aborted) {
+            return 0.0;
+        }
+    }
+
+    const double value = total / SAMPLES_PER_CHANCE_NODE;
+    m_transpositions.store(key, depth, value);
+    return value;
+}
+
+/**
+ * @brief Scores a position at the depth limit with the 2-player evaluation function.
+ * @details In games with more than 2 players, the position is scored as a 2-player game between this agent and the
+ * opponent with the highest score.
+ * @param state A read-only reference to the state at the start of a turn.
+ * @return A double in [-1, 1] representing the value of the position for this agent.
+ */
+double Expectimax::leaf_value(const State& state) const {
+    if (state.scorepads.size() == 2) {
+        const double evaluation = m_evaluator.evaluate(state);
+        return (m_position == 0) ? evaluation : -evaluation;
+    }
+
+    size_t opponent = (m_position == 0) ? 1 : 0;
+    for (size_t i = 0; i < state.scorepads.size(); ++i) {
+        if (i != m_position && state.scorepads[i].get_score() > state.scorepads[opponent].get_score()) {
+            opponent = i;
+        }
+    }
+
+    State view = state;
+    view.scorepads = FixedVector<Scorepad, GameConstants::MAX_PLAYERS>(2, state.scorepads[m_position]);
+    view.scorepads[1] = state.scorepads[opponent];
+    view.set_curr_player((state.curr_player == m_position) ? 0 : 1);
+    return m_evaluator.evaluate(view);
+}
+
+/**
+ * @brief Scores a finished game.
+ * @param state A read-only reference to the terminal state.
+ * @return A double representing the result for this agent: 1 if its score is higher than every other score, 0 if it
+ * is tied for the highest score, and -1 otherwise.
+ */
+double Expectimax::terminal_value(const State& state) const {
+    int best_other_score = std::numeric_limits<int>::min();
+    for (size_t i = 0; i < state.scorepads.size(); ++i) {
+        if (i != m_position) {
+            best_other_score = std::max(best_other_score, state.scorepads[i].get_score());
+        }
+    }
+
+    const int score = state.scorepads[m_position].get_score();
+    return (score > best_other_score) ? 1.0 : (score == best_other_score) ? 0.0 : -1.0;
+}
+
+/**
+ * @brief Checks whether the search of the current move has run out of budget.
+ * @details The clock is only read every 256 nodes. Once the budget has run out, the search of the current depth is
+ * abandoned. The search at depth 0 is never abandoned.
+ * @return A bool which is true if the current search should stop, else false.
+ */
+bool Expectimax::out_of_budget() {
+    if (!m_can_abort || m_aborted) {
+        return m_aborted;
+    }
+    if (m_nodes >= m_max_nodes) {
+        m_aborted = true;
+    }
+    else if (m_max_time.count() > 0 && (m_nodes & 255) == 0 && std::chrono::steady_clock::now() >= m_deadline) {
+        m_aborted = true;
+    }
+    return m_aborted;
+}
+
+/**
+ * @struct MctsPosition
+ * @brief A position of the searched game, between two decisions of the Monte Carlo tree search agent.
+ * @details Holds a copy of the State, which is stored inline and so is copied without allocating memory, plus what is
+ * needed to resume the current turn: the dice, the first action moves registered so far, and the player choosing next.
+ * Decisions of players without a legal move are skipped (see mcts_skip_forced()), as Game::run() does not ask them.
+ */
+struct MctsPosition {
+    /// @brief The next event of the game.
+    enum class Phase { Roll, FirstAction, SecondAction, Over };
+
+    State state;                                                            //< State of the game. Rolls increment its turn count.
+    SearchTurn turn;                                                        //< Dice of the current turn.
+    std::array<std::optional<Move>, GameConstants::MAX_PLAYERS> registered; //< First action moves registered so far.
+    size_t first_chooser;           //< Player choosing first in the first action.
+    size_t num_chosen;              //< Number of players that have chosen in the first action.
+    bool active_player_made_move;   //< Whether the active player made a move in the current turn.
+    Phase phase;                    //< Next event of the game.
+};
+
+/**
+ * @brief Gets the player making the next decision of a searched position.
+ * @param position A read-only reference to a position in the first or second action.
+ * @return A size_t representing the player.
+ */
+static size_t mcts_decider(const MctsPosition& position) {
+    if (position.phase == MctsPosition::Phase::FirstAction) {
+        return (position.first_chooser + position.num_chosen) % position.state.scorepads.size();
+    }
+    return position.state.curr_player;
+}
+
+/**
+ * @brief Generates the legal moves of the next decision of a searched position.
+ * @param position A read-only reference to a position in the first or second action.
+ * @param moves A reference to an array receiving the legal moves.
+ * @return A size_t representing the number of legal moves.
+ */
+static size_t mcts_legal_moves(const MctsPosition& position, std::array<Move, GameConstants::MAX_LEGAL_MOVES>& moves) {
+    const size_t player = mcts_decider(position);
+    size_t num_moves = 0;
+    if (position.phase == MctsPosition::Phase::FirstAction) {
+        for (size_t j = 0; j < GameConstants::NUM_ROWS; ++j) {
+            const Move move = {static_cast<Color>(j), sum_to_index_table[j][position.turn.white_sum]};
+            if (search_is_legal(position.state, player, move)) {
+                moves[num_moves++] = move;
+            }
+        }
+    }
+    else {
+        for (const Move move : position.turn.action_two_moves) {
+            if (search_is_legal(position.state, player, move)) {
+                moves[num_moves++] = move;
+            }
+        }
+    }
+    return num_moves;
+}
+
+/**
+ * @brief Ends the turn of a searched position, giving the active player a penalty if they made no move.
+ * @param position A reference to the position after the second action.
+ */
+static void mcts_end_turn(MctsPosition& position) {
+    State& state = position.state;
+    if (!position.active_player_made_move && state.scorepads[state.curr_player].mark_penalty()) {
+        state.is_terminal = true;
+    }
+    if (state.is_terminal) {
+        position.phase = MctsPosition::Phase::Over;
+        return;
+    }
+    state.set_curr_player((state.curr_player + 1) % state.scorepads.size());
+    position.phase = MctsPosition::Phase::Roll;
+}
+
+/**
+ * @brief Applies the events of a searched position that involve no decision.
+ * @details Skips the players without a legal move, commits the first action once every player has chosen, and ends
+ * the turn if the active player has no legal move in the second action.
+ * @param position A reference to the position.
+ */
+static void mcts_skip_forced(MctsPosition& position) {
+    std::array<Move, GameConstants::MAX_LEGAL_MOVES> moves;
+    while (true) {
+        if (position.phase == MctsPosition::Phase::FirstAction) {
+            State& state = position.state;
+            if (position.num_chosen == state.scorepads.size()) {
+                for (size_t i = 0; i < state.scorepads.size(); ++i) {
+                    if (position.registered[i].has_value()) {
+                        state.scorepads[i].mark_move(position.registered[i].value());
+                        if (position.registered[i].value().index == GameConstants::LOCK_INDEX) {
+                            state.locks.set(static_cast<size_t>(position.registered[i].value().color));
+                        }
+                    }
+                }
+                position.active_player_made_move = position.registered[state.curr_player].has_value();
+                search_apply_locks(state);
+                position.phase = state.is_terminal ? MctsPosition::Phase::Over : MctsPosition::Phase::SecondAction;
+            }
+            else if (mcts_legal_moves(position, moves) == 0) {
+                position.registered[mcts_decider(position)] = std::nullopt;
+                ++position.num_chosen;
+            }
+            else {
+                return;
+            }
+        }
+        else if (position.phase == MctsPosition::Phase::SecondAction && mcts_legal_moves(position, moves) == 0) {
+            mcts_end_turn(position);
+        }
+        else {
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Rolls the dice of a searched position, starting a new turn.
+ * @param position A reference to a position whose next event is a roll.
+ * @param generator A reference to the random number generator of the search.
+ */
+static void mcts_roll(MctsPosition& position, Philox& generator) {
+    std::array<int, GameConstants::NUM_DICE> rolls;
+    for (int& roll : rolls) {
+        roll = Philox::to_die(generator());
+    }
+
+    position.state.turn_count += 1;
+    position.turn = search_turn(position.state, rolls);
+    position.registered.fill(std::nullopt);
+    position.first_chooser = position.state.curr_player;
+    position.num_chosen = 0;
+    position.active_player_made_move = false;
+    position.phase = MctsPosition::Phase::FirstAction;
+    mcts_skip_forced(position);
+}
+
+/**
+ * @brief Applies the next decision of a searched position.
+ * @param position A reference to a position in the first or second action.
+ * @param move The move chosen by the deciding player, or the null option for passing.
+ */
+static void mcts_choose(MctsPosition& position, const std::optional<Move> move) {
+    if (position.phase == MctsPosition::Phase::FirstAction) {
+        position.registered[mcts_decider(position)] = move;
+        ++position.num_chosen;
+    }
+    else {
+        if (move.has_value()) {
+            State& state = position.state;
+            state.scorepads[state.curr_player].mark_move(move.value());
+            if (move.value().index == GameConstants::LOCK_INDEX) {
+                state.locks.set(static_cast<size_t>(move.value().color));
+            }
+            search_apply_locks(state);
+            position.active_player_made_move = true;
+        }
+        mcts_end_turn(position);
+    }
+    mcts_skip_forced(position);
+}
+
+/**
+ * @brief Computes the reward of each player in a finished game.
+ * @param state A read-only reference to the terminal state.
+ * @return An array holding 1 divided by the number of winners for each winner (the players with the highest score), and 0 for the other players.
+ */
+static std::array<double, GameConstants::MAX_PLAYERS> mcts_rewards(const State& state) {
+    int best_score = std::numeric_limits<int>::min();
+    for (const Scorepad& scorepad : state.scorepads) {
+        best_score = std::max(best_score, scorepad.get_score());
+    }
+
+    std::array<double, GameConstants::MAX_PLAYERS> rewards{};
+    int num_winners = 0;
+    for (size_t i = 0; i < state.scorepads.size(); ++i) {
+        if (state.scorepads[i].get_score() == best_score) {
+            rewards[i] = 1.0;
+            ++num_winners;
+        }
+    }
+    for (double& reward : rewards) {
+        reward /= num_winners;
+    }
+    return rewards;
+}
+
+/// @brief Total number of rollouts played by Mcts agents, over all threads.
+static std::atomic<long long> mcts_total_rollouts = 0;
+
+/// @brief Total time spent searching trees by Mcts agents, in nanoseconds, summed over the threads searching them.
+static std::atomic<long long> mcts_total_search_nanoseconds = 0;
+
+/**
+ * @struct Mcts::Node
+ * @brief A node of a search tree.
+ * @details The children of a decision node are its options in order: passing, then each legal move. They are added one
+ * per visit, so the first visits try every option once. The children of a chance node are the rolls seen so far, keyed
+ * by the SearchTurn they lead to (see make_move()).
+ */
+struct Mcts::Node {
+    /// @brief Value of player for nodes that no player chose, i.e. the rolls of chance nodes and the root.
+    static constexpr std::uint8_t NO_PLAYER = std::numeric_limits<std::uint8_t>::max();
+
+    std::vector<std::pair<std::uint64_t, std::uint32_t>> children;  //< Key (option or roll) and index of each child.
+    std::uint32_t visits = 0;           //< Number of rollouts through this node.
+    double reward = 0.0;                //< Total reward of these rollouts for the player who chose this node.
+    std::uint8_t player = NO_PLAYER;    //< Player who chose this node.
+};
+
+/**
+ * @brief Computes the key of the roll of a chance node.
+ * @details Rolls with the same white sum and the same second action moves for the active player lead to the same
+ * decisions, so they share a child.
+ * @param turn A read-only reference to the SearchTurn of the roll.
+ * @return A 64-bit integer representing the key.
+ */
+static std::uint64_t mcts_roll_key(const SearchTurn& turn) {
+    std::uint64_t key = static_cast<std::uint64_t>(turn.white_sum);
+    for (const Move move : turn.action_two_moves) {
+        key |= std::uint64_t(1) << (4 + GameConstants::NUM_CELLS_PER_ROW * static_cast<size_t>(move.color) + move.index);
+    }
+    return key;
+}
+
+/**
+ * @brief Constructor for the Monte Carlo tree search agent.
+ * @details Calls the base class constructor and sets the number of rollouts per move. The trees of a move can be
+ * searched in parallel by setting the environment variable QWIXX_SEARCH_THREADS to the number of threads. The moves
+ * do not depend on it, since each tree has its own random stream. The threads are started at the first move, and only
+ * if the agent does not play inside a task that already runs on several workers (e.g. a trial with --threads N for
+ * N > 1), since every agent of every worker would otherwise start its own threads. The variable is then ignored, with
+ * a warning.
+ * @param rollouts_per_move An int representing the number of rollouts per move, split evenly between the trees.
+ * @throws std::runtime_error if QWIXX_SEARCH_THREADS is set but is not a positive number.
+ */
+Mcts::Mcts(int rollouts_per_move)
+    : Agent(),
+      m_rollouts_per_move(rollouts_per_move),
+      m_search_threads(1) {
+
+    if (const char* threads = std::getenv("QWIXX_SEARCH_THREADS")) {
+        char* end = nullptr;
+        const long num_threads = std::strtol(threads, &end, 10);
+        if (end == threads || *end != '\0' || num_threads <= 0) {
+            throw std::runtime_error("QWIXX_SEARCH_THREADS must be a positive number.");
+        }
+        m_search_threads = static_cast<unsigned int>(std::min<long>(num_threads, NUM_TREES));
+    }
+}
+
+/// @brief Destructor, stops the search threads if there are any.
+Mcts::~Mcts() = default;
+
+/**
+ * @brief The function implementing the Monte Carlo tree search policy for making moves.
+ * @details Searches NUM_TREES independent trees from the current decision, and plays the option whose node was visited
+ * most often over all trees. Each iteration of a tree descends from the root, choosing options with the UCT formula
+ * (average reward plus EXPLORATION * sqrt(ln(visits of the parent) / visits of the child)) from the point of view of
+ * the deciding player, until it adds a node. The game is then played to the end with the GreedyImproved policy (with
+ * ROLLOUT_MAX_SKIPS) for every player, and each node on the path receives the reward of its player: 1 for a win,
+ * divided among tied winners. Each turn starts with a chance node: its rolls are drawn from the tree's random stream,
+ * so each roll is explored in proportion to its probability, and rolls that lead to the same decisions share a node.
+ * The players choose their first action moves one after the other in the tree, starting with this agent at the root
+ * and with the active player in later turns, so a player choosing later sees the earlier choices of the same action.
+ * The rollouts of a tree continue the turn in which they start with the policy, whose bookkeeping of its own first
+ * action move may be missing for that turn.
+ *
+ * The trees are independent (root parallelization), which keeps the moves reproducible: each tree draws its rolls
+ * from its own stream, keyed by a value drawn from the game's generator, so the moves do not depend on the threads
+ * searching the trees (see the constructor). Virtual loss, which spreads the threads of a shared tree over different
+ * paths, has no use with independent trees. The search copies the State passed in once per iteration and otherwise
+ * works on the copies, which are stored inline. The number of rollouts and the time spent per tree are added to
+ * global counters (see rollouts_per_core_second()).
+ * Also see the other documentation for make_move() in the Agent base class (src/agent.hpp).
+ */
+std::optional<size_t> Mcts::make_move(bool first_action, std::span<const Move> current_action_legal_moves, std::span<const Move> action_two_possible_moves, const State& state) {
+    if (first_action) {
+        m_made_first_action_move = false;
+    }
+
+    // The root is the current decision of this agent
+    MctsPosition root{};
+    root.state = state;
+    root.registered.fill(std::nullopt);
+    root.first_chooser = m_position;
+    root.num_chosen = 0;
+    root.active_player_made_move = m_made_first_action_move;
+    if (first_action) {
+        root.phase = MctsPosition::Phase::FirstAction;
+        root.turn.white_sum = index_to_value(current_action_legal_moves[0].color, current_action_legal_moves[0].index);
+        for (const Move move : action_two_possible_moves) {
+            root.turn.action_two_moves.push_back(move);
+        }
+    }
+    else {
+        root.phase = MctsPosition::Phase::SecondAction;
+        for (const Move move : current_action_legal_moves) {
+            root.turn.action_two_moves.push_back(move);
+        }
+    }
+
+    const std::uint64_t seed = (static_cast<std::uint64_t>(rng()()) << 32) | rng()();
+    const size_t num_players = state.scorepads.size();
+
+    // Lambda to search one tree, returning the number of visits of each option of the root
+    auto search_tree = [&](int tree_index) {
+        std::vector<Node>& tree = m_trees[tree_index];
+        tree.clear();
+        tree.emplace_back();
+
+        Philox generator(seed, static_cast<std::uint64_t>(tree_index));
+        std::vector<GreedyImproved> policies(num_players, GreedyImproved(ROLLOUT_MAX_SKIPS));
+        for (size_t i = 0; i < num_players; ++i) {
+            policies[i].set_position(i);
+        }
+
+        std::array<Move, GameConstants::MAX_LEGAL_MOVES> moves;
+        std::vector<std::uint32_t> path;
+        const int num_rollouts = m_rollouts_per_move / NUM_TREES + (tree_index < m_rollouts_per_move % NUM_TREES ? 1 : 0);
+        for (int rollout = 0; rollout < num_rollouts; ++rollout) {
+            MctsPosition position = root;
+            std::uint32_t node = 0;
+            path.assign(1, 0);
+
+            // Descend until a node is added or the game ends
+            bool added = false;
+            while (!added && position.phase != MctsPosition::Phase::Over) {
+                std::uint32_t child = 0;
+                if (position.phase == MctsPosition::Phase::Roll) {
+                    mcts_roll(position, generator);
+                    const std::uint64_t key = mcts_roll_key(position.turn);
+                    auto it = std::find_if(tree[node].children.begin(), tree[node].children.end(), [key](const auto& entry) { return entry.first == key; });
+                    if (it != tree[node].children.end()) {
+                        child = it->second;
+                    }
+                    else {
+                        child = static_cast<std::uint32_t>(tree.size());
+                        tree[node].children.emplace_back(key, child);
+                        tree.emplace_back();
+                    }
+                }
+                else {
+                    const size_t num_moves = mcts_legal_moves(position, moves);
+                    const size_t player = mcts_decider(position);
+                    size_t option = tree[node].children.size();
+                    if (option <= num_moves) {
+                        child = static_cast<std::uint32_t>(tree.size());
+                        tree[node].children.emplace_back(option, child);
+                        tree.emplace_back();
+                        tree[child].player = static_cast<std::uint8_t>(player);
+                        added = true;
+                    }
+                    else {
+                        const double log_visits = std::log(static_cast<double>(tree[node].visits));
+                        double best = -1.0;
+                        for (size_t k = 0; k < tree[node].children.size(); ++k) {
+                            const Node& candidate = tree[tree[node].children[k].second];
+                            const double value = candidate.reward / candidate.visits + EXPLORATION * std::sqrt(log_visits / candidate.visits);
+                            if (value > best) {
+                                best = value;
+                                option = k;
+                            }
+                        }
+                        child = tree[node].children[option].second;
+                    }
+                    mcts_choose(position, option == 0 ? std::nullopt : std::optional<Move>(moves[option - 1]));
+                }
+                node = child;
+                path.push_back(node);
+            }
+
+            // Play the game to the end with the policy
+            while (position.phase != MctsPosition::Phase::Over) {
+                if (position.phase == MctsPosition::Phase::Roll) {
+                    mcts_roll(position, generator);
+                    continue;
+                }
+                const size_t num_moves = mcts_legal_moves(position, moves);
+                const bool policy_first_action = (position.phase == MctsPosition::Phase::FirstAction);
+                const std::span<const Move> legal_moves(moves.data(), num_moves);
+                const std::span<const Move> action_two_moves = policy_first_action ? std::span<const Move>(position.turn.action_two_moves.begin(), position.turn.action_two_moves.end())
+                                                                                   : legal_moves;
+                const std::optional<size_t> choice = policies[mcts_decider(position)].make_move(policy_first_action, legal_moves, action_two_moves, position.state);
+                mcts_choose(position, choice.has_value() ? std::optional<Move>(moves[choice.value()]) : std::nullopt);
+            }
+
+            const std::array<double, GameConstants::MAX_PLAYERS> rewards = mcts_rewards(position.state);
+            for (const std::uint32_t visited : path) {
+                tree[visited].visits += 1;
+                if (tree[visited].player != Node::NO_PLAYER) {
+                    tree[visited].reward += rewards[tree[visited].player];
+                }
+            }
+        }
+        return num_rollouts;
+    };
+
+    // Search the trees, on the pool if there is one
+    std::array<std::exception_ptr, NUM_TREES> errors{};
+    auto search_trees = [&](unsigned int worker_index, unsigned int num_workers) {
+        for (int t = static_cast<int>(worker_index); t < NUM_TREES; t += static_cast<int>(num_workers)) {
+            try {
+                const auto start = std::chrono::steady_clock::now();
+                const int num_rollouts = search_tree(t);
+                const auto duration = std::chrono::steady_clock::now() - start;
+                mcts_total_rollouts += num_rollouts;
+                mcts_total_search_nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+            }
+            catch (...) {
+                errors[t] = std::current_exception();
+            }
+        }
+    };
+    // Start the search threads, unless the agent already plays on one of several workers
+    if (m_search_threads > 1 && m_pool == nullptr) {
+        if (WorkerPool::current_num_workers() > 1) {
+            static std::atomic<bool> warned = false;
+            if (!warned.exchange(true)) {
+                std::cerr << "Warning: QWIXX_SEARCH_THREADS is ignored, since the games already run on several threads.\n";
+            }
+            m_search_threads = 1;
+        }
+        else {
+            m_pool = std::make_unique<WorkerPool>(m_search_threads);
+        }
+    }
+    if (m_pool != nullptr) {
+        const unsigned int num_workers = m_pool->size();
+        m_pool->run(num_workers, [&](unsigned int worker_index) { search_trees(worker_index, num_workers); });
+    }
+    else {
+        search_trees(0, 1);
+    }
+    for (const auto& error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    // Play the option visited most often over all trees, preferring the earlier option on ties
+    std::array<std::uint64_t, GameConstants::MAX_LEGAL_MOVES + 1> visits{};
+    for (const std::vector<Node>& tree : m_trees) {
+        for (const auto& [option, child] : tree[0].children) {
+            visits[option] += tree[child].visits;
+        }
+    }
+    std::array<Move, GameConstants::MAX_LEGAL_MOVES> moves;
+    const size_t num_moves = mcts_legal_moves(root, moves);
+    size_t best_option = 0;
+    for (size_t option = 1; option <= num_moves; ++option) {
+        if (visits[option] > visits[best_option]) {
+            best_option = option;
+        }
+    }
+
+    // Find the chosen move among the legal moves passed in
+    std::optional<size_t> choice = std::nullopt;
+    if (best_option > 0) {
+        const Move move = moves[best_option - 1];
+        for (size_t i = 0; i < current_action_legal_moves.size(); ++i) {
+            if (current_action_legal_moves[i].color == move.color && current_action_legal_moves[i].index == move.index) {
+                choice = i;
+            }
+        }
+    }
+
+    // Remember if we made a move during the first action
+    if (first_action && choice.has_value()) {
+        m_made_first_action_move = true;
+    }
+
+    return choice;
+}
+
+/**
+ * @brief Gets the search speed of all Mcts agents so far.
+ * @details Each tree is searched by a single thread, so the time summed over the trees is the core time of the search.
+ * @return A double option holding the number of rollouts per second of core time, or the null option if no rollouts were played.
+ */
+std::optional<double> Mcts::rollouts_per_core_second() {
+    const long long rollouts = mcts_total_rollouts.load();
+    const long long nanoseconds = mcts_total_search_nanoseconds.load();
+    if (rollouts == 0 || nanoseconds == 0) {
+        return std::nullopt;
+    }
+    return static_cast<double>(rollouts) / (static_cast<double>(nanoseconds) * 1e-9);
+}
+
+/**
+ * @brief Creates an AgentRef from a pointer to an agent.
+ * @details Looks up the concrete type of the agent once, so that the per-move dispatch in
+ * call_make_move() does not need a virtual call for the built-in policy agents. Agents of
+ * any other type, including the human agent and the search agents, are stored as plain Agent pointers.
+ * @param agent A pointer to the agent. Must not be null.
+ * @return An AgentRef holding the agent as a pointer to its concrete type, if known.
+ */
+AgentRef make_agent_ref(Agent* agent) {
+    if (auto* random = dynamic_cast<Random*>(agent)) {
+        return random;
+    }
+    if (auto* greedy = dynamic_cast<Greedy*>(agent)) {
+        return greedy;
+    }
+    if (auto* greedy_improved = dynamic_cast<GreedyImproved*>(agent)) {
+        return greedy_improved;
+    }
+    if (auto* rush_locks = dynamic_cast<RushLocks*>(agent)) {
+        return rush_locks;
+    }
+    if (auto* computational = dynamic_cast<Computational*>(agent)) {
+        return computational;
+    }
+    return agent;
+}
@@ -1,13 +1,25 @@
 #pragma once
 
+#include <array>
+#include <chrono>
+#include <cstdint>
 #include <memory>
 #include <optional>
 #include <span>
+#include <string>
+#include <variant>
+#include <vector>
 
+#include "evaluation.hpp"
 #include "globals.hpp"
+#include "transposition.hpp"
 
 struct Move;
+struct SearchTurn;
 class State;
+class EndgameTable;
+class SolitaireTable;
+class WorkerPool;
 
 /**
  * @class Agent agent.hpp "src/agent.hpp"
@@ -61,7 +73,7 @@ protected:
  * @brief Methods and data for the human agent.
  * @details See the definition of Human::make_move() in src/agent.cpp.
  */
-class Human : public Agent {
+class Human final : public Agent {
 public:
     /// @brief Default constructor, uses the base class constructor.
     Human() : Agent() {};
@@ -78,7 +90,7 @@ public:
  * @brief Methods and data for the random agent.
  * @details See the definition of Random::make_move() in src/agent.cpp.
  */
-class Random : public Agent {
+class Random final : public Agent {
 public:
     /// @brief Default constructor, uses the base class constructor.
     Random() : Agent() {};
@@ -95,7 +107,7 @@ public:
  * @brief Methods and data for the greedy agent.
  * @details See the definition of Greedy::make_move() in src/agent.cpp.
  */
-class Greedy : public Agent {
+class Greedy final : public Agent {
 public:
     /**
      * @brief Default constructor, uses the base class constructor and then initializes m_max_skips to the value passed in.
@@ -118,7 +130,7 @@ protected:
  * @brief Methods and data for the improved greedy agent.
  * @details See the definition of GreedyImproved::make_move() in src/agent.cpp.
  */
-class GreedyImproved : public Agent {
+class GreedyImproved final : public Agent {
 public:
     /**
      * @brief Default constructor, uses the base class constructor and then initializes m_standard_max_skips to the value passed in.
@@ -144,7 +156,7 @@ protected:
  * @brief Methods and data for the rush agent.
  * @details See the definition of RushLocks::make_move() in src/agent.cpp.
  */
-class RushLocks : public Agent {
+class RushLocks final : public Agent {
 public:
     /// @brief Default constructor, uses the base class constructor.
     RushLocks() : Agent() {};
@@ -165,9 +177,28 @@ protected:
  * @brief Methods and data for the computational agent.
  * @details See the definition of Computational::make_move() in src/agent.cpp.
  */
-class Computational : public Agent {
+class Computational final : public Agent {
 public:
+    /**
+     * @struct Parameters
+     * @brief The tunable parameters of the computational agent.
+     * @details The defaults are the values the agent has always used. Other values can be found with the tuner (see
+     * run_tuning_generation()), and are read and written as text files with one "name value" line per parameter.
+     */
+    struct Parameters {
+        double alpha = 0.949905;    //< The alpha parameter is a discount factor for losing access to the move in the future.
+        double mu = 0.49005;        //< The mu parameter is a discount factor for not likely being able to mark all spaces to the right of the move.
+        double delta = 0.823284;    //< The delta parameter is a discount factor for losing access to moves to the left of the current move in the future.
+        double sigma = 0.921692;    //< The sigma parameter is a discount factor for losing access to moves to the left of the current move in the future.
+        double epsilon = 0.71407;   //< The epsilon parameter is an estiamte of the total fraction of all spaces on the scorepad that will be filled by the game's end.
+
+        static Parameters load(const std::string& path);
+        void save(const std::string& path) const;
+        static const Parameters& configured();
+    };
+
     Computational();
+    explicit Computational(const Parameters& parameters);
 
     /**
      * @struct MoveData
@@ -185,10 +216,140 @@ public:
     std::optional<size_t> make_move(bool first_action, std::span<const Move> current_action_legal_moves, std::span<const Move> action_two_possible_moves, const State& state) override;
 protected:
     bool m_made_first_action_move = false;      //< Used by the agent to check if it made a move during the first action.
-    double m_alpha = 0.949905;      //< The alpha parameter is a discount factor for losing access to the move in the future.
-    double m_mu = 0.49005;          //< The mu parameter is a discount factor for not likely being able to mark all spaces to the right of the move.
-    double m_delta = 0.823284;      //< The delta parameter is a discount factor for losing access to moves to the left of the current move in the future.
-    double m_sigma = 0.921692;      //< The sigma parameter is a discount factor for losing access to moves to the left of the current move in the future.
-    double m_epsilon = 0.71407;     //< The epsilon parameter is an estiamte of the total fraction of all spaces on the scorepad that will be filled by the game's end.
+    double m_alpha;         //< See Parameters::alpha.
+    double m_mu;            //< See Parameters::mu.
+    double m_delta;         //< See Parameters::delta.
+    double m_sigma;         //< See Parameters::sigma.
+    double m_epsilon;       //< See Parameters::epsilon.
     std::array<MoveData, GameConstants::NUM_CELLS_PER_ROW> m_basic_values;  //< Holds the basic values (base penalty and roll frequency) for each move.
-};
\ No newline at end of file
+};
+
+/**
+ * @class Solitaire agent.hpp "src/agent.hpp"
+ * @brief Methods and data for the solitaire agent.
+ * @details See the definition of Solitaire::make_move() in src/agent.cpp.
+ */
+class Solitaire final : public Agent {
+public:
+    Solitaire();
+
+    /**
+     * @brief Function used by the solitaire agent to determine its move.
+     * @details See the documentation for make_move() in the Agent base class.
+     */
+    std::optional<size_t> make_move(bool first_action, std::span<const Move> current_action_legal_moves, std::span<const Move> action_two_possible_moves, const State& state) override;
+protected:
+    bool m_made_first_action_move = false;              //< Used by the agent to check if it made a move during the first action.
+    std::shared_ptr<const SolitaireTable> m_table;      //< Optimal expected future score of every solitaire position.
+    const EndgameTable* m_endgame_table;                //< Exact values of 2-player lock races, or nullptr if none is configured.
+
+    bool endgame_move(bool first_action, std::span<const Move> current_action_legal_moves, std::span<const Move> action_two_possible_moves,
+                      const State& state, std::optional<size_t>& choice) const;
+};
+
+/**
+ * @class Expectimax agent.hpp "src/agent.hpp"
+ * @brief Methods and data for the expectimax agent.
+ * @details See the definition of Expectimax::make_move() in src/agent.cpp.
+ */
+class Expectimax final : public Agent {
+public:
+    explicit Expectimax(long long max_nodes);
+
+    /**
+     * @brief Function used by the expectimax agent to determine its move.
+     * @details See the documentation for make_move() in the Agent base class.
+     */
+    std::optional<size_t> make_move(bool first_action, std::span<const Move> current_action_legal_moves, std::span<const Move> action_two_possible_moves, const State& state) override;
+
+    /// @brief Number of dice rolls sampled at each chance node.
+    static constexpr int SAMPLES_PER_CHANCE_NODE = 12;
+
+    /// @brief Largest search depth, in turns after the current one.
+    static constexpr int MAX_DEPTH = 8;
+
+    /// @brief Base-2 logarithm of the number of buckets of the transposition table (2 MB).
+    static constexpr unsigned int LOG2_TRANSPOSITION_BUCKETS = 16;
+protected:
+    bool m_made_first_action_move = false;      //< Used by the agent to check if it made a move during the first action.
+    long long m_max_nodes;                      //< Node budget per move.
+    std::chrono::milliseconds m_max_time;       //< Time budget per move, or 0 for none (see the constructor).
+    Evaluator2p m_evaluator;                    //< Evaluation function used at the leaves.
+    TranspositionTable m_transpositions;        //< Values of the chance nodes searched for the current move.
+    long long m_nodes = 0;                      //< Nodes searched for the current move.
+    bool m_can_abort = false;                   //< Whether the current iteration may be stopped by the budget.
+    bool m_aborted = false;                     //< Whether the current iteration ran out of budget.
+    std::chrono::steady_clock::time_point m_deadline;   //< End of the time budget of the current move.
+    std::array<std::array<std::array<int, GameConstants::NUM_DICE>, SAMPLES_PER_CHANCE_NODE>, MAX_DEPTH> m_sampled_rolls;  //< Rolls of the chance nodes of the current move, by depth left minus 1.
+
+    double first_action_value(const State& state, const SearchTurn& turn, int depth, size_t chooser,
+                              std::array<std::optional<Move>, GameConstants::MAX_PLAYERS>& chosen, const std::optional<Move>* own_move);
+    double resolve_turn(const State& state, const SearchTurn& turn, int depth, const std::array<std::optional<Move>, GameConstants::MAX_PLAYERS>& chosen);
+    double end_turn_value(State state, bool active_player_made_move, int depth);
+    double next_turn_value(const State& state, int depth);
+    double leaf_value(const State& state) const;
+    double terminal_value(const State& state) const;
+    bool out_of_budget();
+};
+
+/**
+ * @class Mcts agent.hpp "src/agent.hpp"
+ * @brief Methods and data for the Monte Carlo tree search agent.
+ * @details See the definition of Mcts::make_move() in src/agent.cpp.
+ */
+class Mcts final : public Agent {
+public:
+    explicit Mcts(int rollouts_per_move);
+    ~Mcts() override;
+
+    /**
+     * @brief Function used by the Monte Carlo tree search agent to determine its move.
+     * @details See the documentation for make_move() in the Agent base class.
+     */
+    std::optional<size_t> make_move(bool first_action, std::span<const Move> current_action_legal_moves, std::span<const Move> action_two_possible_moves, const State& state) override;
+
+    static std::optional<double> rollouts_per_core_second();
+
+    /// @brief Number of independent trees searched for each move (root parallelization).
+    static constexpr int NUM_TREES = 4;
+
+    /// @brief Exploration constant of the UCT formula, for rewards between 0 and 1.
+    static constexpr double EXPLORATION = 1.0;
+
+    /// @brief Maximum number of skips of the GreedyImproved policy used for the rollouts.
+    static constexpr int ROLLOUT_MAX_SKIPS = 2;
+protected:
+    struct Node;
+
+    bool m_made_first_action_move = false;      //< Used by the agent to check if it made a move during the first action.
+    int m_rollouts_per_move;                    //< Number of rollouts per move, over all trees.
+    unsigned int m_search_threads;              //< Number of threads searching the trees, as set by QWIXX_SEARCH_THREADS.
+    std::unique_ptr<WorkerPool> m_pool;         //< Threads searching the trees, started at the first move, or nullptr to search them on the calling thread.
+    std::array<std::vector<Node>, NUM_TREES> m_trees;   //< Nodes of each tree. Kept between moves to reuse their memory.
+};
+
+/**
+ * @brief A pointer to an agent, tagged with the agent's concrete type where it is known.
+ * @details The built-in agents are final classes, so a call to make_move() through a pointer of
+ * their concrete type is resolved at compile time and can be inlined, especially with interprocedural
+ * optimization. The last alternative holds every other agent and goes through the virtual function as before:
+ * the human agent, the search agents, and any agent added outside this file. The search agents are left out of the
+ * variant on purpose, since a virtual call costs nothing next to the search behind each of their moves. Use
+ * make_agent_ref() to create one and call_make_move() to query the agent.
+ */
+using AgentRef = std::variant<Random*, Greedy*, GreedyImproved*, RushLocks*, Computational*, Agent*>;
+
+AgentRef make_agent_ref(Agent* agent);
+
+/**
+ * @brief Asks an agent for its move, dispatching on the agent's concrete type.
+ * @details See the documentation for make_move() in the Agent base class.
+ * @param agent A read-only reference to the AgentRef of the agent to query.
+ * @return A size_t option which is expected to equal an index into current_action_legal_moves or the null option.
+ */
+inline std::optional<size_t> call_make_move(const AgentRef& agent, bool first_action, std::span<const Move> current_action_legal_moves,
+                                            std::span<const Move> action_two_possible_moves, const State& state) {
+    return std::visit([&](auto* concrete_agent) {
+        return concrete_agent->make_move(first_action, current_action_legal_moves, action_two_possible_moves, state);
+    }, agent);
+}
@@ -0,0 +1,473 @@
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <stdexcept>
+
+#include "batch.hpp"
+#include "game.hpp"
+#include "rng.hpp"
+
+/**
+ * @brief Default constructor.
+ * @details Translates the agent identifiers (as used by get_players()) into the parameters of the greedy policies.
+ * Throws an exception if the player count is invalid, if one of the agents is not supported (see supports()), or
+ * if the evaluation function is used in a game without exactly 2 players. All lanes are idle until run() is called.
+ * @param agent_ids A read-only vector of ints identifying the agent of each player.
+ * @param seed A 64-bit integer representing the seed of the trial.
+ * @param use_evaluation A bool indicating whether the evaluation function should be used.
+ */
+BatchGame::BatchGame(const std::vector<int>& agent_ids, std::uint64_t seed, bool use_evaluation)
+    : m_num_players(agent_ids.size()),
+      m_seed(seed),
+      m_max_skips{},
+      m_improved{},
+      m_use_evaluation(use_evaluation) {
+
+    if (!supports(agent_ids)) {
+        throw std::runtime_error("Unsupported players for batch games.");
+    }
+    if (m_use_evaluation && m_num_players != 2) {
+        throw std::runtime_error("The evaluation function is only defined for 2-player games.");
+    }
+    if (m_use_evaluation) {
+        m_positions.resize(NUM_LANES);
+        m_evaluations.resize(NUM_LANES);
+    }
+
+    for (size_t i = 0; i < m_num_players; ++i) {
+        m_improved[i] = agent_ids[i] > 10;
+        m_max_skips[i] = m_improved[i] ? agent_ids[i] - 10 : agent_ids[i];
+    }
+
+    for (size_t lane = 0; lane < NUM_LANES; ++lane) {
+        start_game(lane, -1);
+    }
+}
+
+/**
+ * @brief Checks whether games between the given agents can be run by a BatchGame object.
+ * @param agent_ids A read-only vector of ints identifying the agent of each player, as used by get_players().
+ * @return A bool which is true if the player count is valid and every agent is a Greedy agent (1 to 10)
+ * or a GreedyImproved agent (11 to 20), else false.
+ */
+bool BatchGame::supports(const std::vector<int>& agent_ids) {
+    if (agent_ids.size() < GameConstants::MIN_PLAYERS || agent_ids.size() > GameConstants::MAX_PLAYERS) {
+        return false;
+    }
+    return std::all_of(agent_ids.begin(), agent_ids.end(), [](int id) { return id >= 1 && id <= 20; });
+}
+
+/**
+ * @brief Runs games until no games are left.
+ * @details Fills every lane with a game, then plays one turn of all running games at a time. Whenever a
+ * game ends, its results are passed to game_done and its lane is refilled by calling next_game. Lanes for
+ * which next_game returns -1 stay idle, and this method returns once all lanes are idle.
+ * @param next_game A callable returning the index of the next game to run, or -1 if there are none left.
+ * @param game_done A callable receiving the index of a game that has ended and a read-only reference to its results.
+ * The GameData object is reused for the next game, so it must be copied if it needs to be kept.
+ */
+void BatchGame::run(const std::function<int()>& next_game, const std::function<void(int, const GameData&)>& game_done) {
+    switch (m_num_players) {
+        case 2: run_impl<2>(next_game, game_done); break;
+        case 3: run_impl<3>(next_game, game_done); break;
+        case 4: run_impl<4>(next_game, game_done); break;
+        default: run_impl<5>(next_game, game_done); break;
+    }
+}
+
+/**
+ * @brief Runs games with N players until no games are left.
+ * @details See run().
+ */
+template <size_t N>
+void BatchGame::run_impl(const std::function<int()>& next_game, const std::function<void(int, const GameData&)>& game_done) {
+    GameData data;
+
+    for (size_t lane = 0; lane < NUM_LANES; ++lane) {
+        start_game(lane, next_game());
+    }
+
+    while (std::any_of(m_game_index.begin(), m_game_index.end(), [](int game_index) { return game_index >= 0; })) {
+        play_turn<N>();
+
+        // Report the games that have ended and replace them
+        for (size_t lane = 0; lane < NUM_LANES; ++lane) {
+            if (m_game_index[lane] >= 0 && m_is_terminal[lane]) {
+                finish_game<N>(lane, data);
+                game_done(m_game_index[lane], data);
+                start_game(lane, next_game());
+            }
+        }
+    }
+}
+
+/**
+ * @brief Plays one turn of every running game.
+ * @details Follows the same steps as Game::run(): the position is evaluated if the evaluation function is used, the turn counter is incremented and the dice are rolled, then the
+ * first action is resolved, and, in games that have not ended yet, the second action is resolved, penalties are marked,
+ * and the next player becomes active. The agents' policies are those of Greedy::make_move() and GreedyImproved::make_move(),
+ * expressed as choices between the moves found by choose_moves_kernel(). Each step is a loop over all lanes, in which lanes
+ * that are idle (or, for the second action, whose game ended during the first action) are masked out.
+ */
+template <size_t N>
+void BatchGame::play_turn() {
+    if constexpr (N == 2) {
+        if (m_use_evaluation) {
+            evaluate_kernel();
+        }
+    }
+
+    LaneArray<int> playing;
+    for (size_t lane = 0; lane < NUM_LANES; ++lane) {
+        playing[lane] = m_game_index[lane] >= 0;
+        m_turn_count[lane] += 1;
+    }
+
+    roll_dice_kernel();
+
+    // Register the first action moves of all players, based on the state before any of them is marked
+    std::array<Choices, N> registered;
+    LaneArray<int> max_skips;
+    for (size_t p = 0; p < N; ++p) {
+        max_skips.fill(m_max_skips[p]);
+        choose_moves_kernel<ActionType::First>(m_next_index[p], m_num_marked[p], max_skips, registered[p]);
+
+        if (m_improved[p]) {
+            // About to pass as the active player: if there is no acceptable second action move either, choose
+            // the first action move again with one more skip allowed
+            Choices tentative_action_two;
+            choose_moves_kernel<ActionType::Second>(m_next_index[p], m_num_marked[p], max_skips, tentative_action_two);
+
+            Choices lenient;
+            max_skips.fill(m_max_skips[p] + 1);
+            choose_moves_kernel<ActionType::First>(m_next_index[p], m_num_marked[p], max_skips, lenient);
+
+            for (size_t lane = 0; lane < NUM_LANES; ++lane) {
+                const int retry_mask = -static_cast<int>((registered[p].row[lane] < 0) & (m_curr_player[lane] == static_cast<int>(p)) & (tentative_action_two.row[lane] < 0));
+                const int row = (lenient.row[lane] & retry_mask) | (registered[p].row[lane] & ~retry_mask);
+                const int index = (lenient.index[lane] & retry_mask) | (registered[p].index[lane] & ~retry_mask);
+                registered[p].row[lane] = row;
+                registered[p].index[lane] = index;
+
+                // The agent is only asked for a move (and only updates its flag) if it has a legal move
+                const int asked = registered[p].num_legal[lane] > 0;
+                m_made_first_action_move[p][lane] = (asked & (row >= 0)) | ((asked ^ 1) & m_made_first_action_move[p][lane]);
+            }
+        }
+    }
+
+    // Make the first action moves
+    LaneArray<int> active_player_made_move{};
+    LaneArray<int> new_locks{};
+    for (size_t p = 0; p < N; ++p) {
+        for (size_t lane = 0; lane < NUM_LANES; ++lane) {
+            active_player_made_move[lane] |= (m_curr_player[lane] == static_cast<int>(p)) & (registered[p].row[lane] >= 0);
+        }
+        mark_moves_kernel(p, playing, registered[p], new_locks);
+    }
+    lock_kernel(playing, new_locks);
+
+    // Gather the rows and the maximum number of skips of the active player of each game that is still running
+    LaneArray<int> second_action;
+    RowArrays active_next_index{};
+    RowArrays active_num_marked{};
+    for (size_t lane = 0; lane < NUM_LANES; ++lane) {
+        second_action[lane] = playing[lane] & (m_is_terminal[lane] ^ 1);
+        max_skips[lane] = 0;
+    }
+    for (size_t p = 0; p < N; ++p) {
+        for (size_t r = 0; r < GameConstants::NUM_ROWS; ++r) {
+            for (size_t lane = 0; lane < NUM_LANES; ++lane) {
+                // Exactly one player is active, so only their values are added
+                const int is_active_mask = -static_cast<int>(m_curr_player[lane] == static_cast<int>(p));
+                active_next_index[r][lane] += m_next_index[p][r][lane] & is_active_mask;
+                active_num_marked[r][lane] += m_num_marked[p][r][lane] & is_active_mask;
+            }
+        }
+        for (size_t lane = 0; lane < NUM_LANES; ++lane) {
+            // A GreedyImproved agent allows one more skip if it will take a penalty otherwise
+            const int player_max_skips = m_max_skips[p] + (static_cast<int>(m_improved[p]) & (m_made_first_action_move[p][lane] ^ 1));
+            max_skips[lane] = m_curr_player[lane] == static_cast<int>(p) ? player_max_skips : max_skips[lane];
+        }
+    }
+
+    // Resolve the second action
+    Choices action_two;
+    choose_moves_kernel<ActionType::Second>(active_next_index, active_num_marked, max_skips, action_two);
+
+    new_locks.fill(0);
+    LaneArray<int> is_active;
+    for (size_t p = 0; p < N; ++p) {
+        for (size_t lane = 0; lane < NUM_LANES; ++lane) {
+            is_active[lane] = second_action[lane] & (m_curr_player[lane] == static_cast<int>(p));
+        }
+        mark_moves_kernel(p, is_active, action_two, new_locks);
+    }
+    lock_kernel(second_action, new_locks);
+
+    // Mark penalties and move on to the next player
+    for (size_t lane = 0; lane < NUM_LANES; ++lane) {
+        active_player_made_move[lane] |= action_two.row[lane] >= 0;
+    }
+    for (size_t p = 0; p < N; ++p) {
+        for (size_t lane = 0; lane < NUM_LANES; ++lane) {
+            const int penalty = second_action[lane] & (m_curr_player[lane] == static_cast<int>(p)) & (active_player_made_move[lane] ^ 1);
+            m_penalties[p][lane] += penalty;
+            m_is_terminal[lane] |= penalty & (m_penalties[p][lane] >= GameConstants::MAX_PENALTIES);
+        }
+    }
+    for (size_t lane = 0; lane < NUM_LANES; ++lane) {
+        const int next_player = (m_curr_player[lane] + 1 == static_cast<int>(N)) ? 0 : m_curr_player[lane] + 1;
+        m_curr_player[lane] = second_action[lane] ? next_player : m_curr_player[lane];
+    }
+}
+
+/**
+ * @brief Starts a new game in the given lane.
+ * @details Clears the scorepads and the rest of the state, and selects the starting player from stream
+ * game_index of the seed in the same way as Game::reset(). The calling thread's random number generator
+ * is left on this stream.
+ * @param lane A size_t representing the lane to use.
+ * @param game_index An int representing the index of the game to start, or -1 to leave the lane idle.
+ */
+void BatchGame::start_game(size_t lane, int game_index) {
+    m_game_index[lane] = game_index;
+
+    for (size_t p = 0; p < GameConstants::MAX_PLAYERS; ++p) {
+        for (size_t r = 0; r < GameConstants::NUM_ROWS; ++r) {
+            m_rows[p][r][lane] = 0;
+            m_next_index[p][r][lane] = 0;
+            m_num_marked[p][r][lane] = 0;
+        }
+        m_penalties[p][lane] = 0;
+        m_made_first_action_move[p][lane] = 0;
+    }
+    m_locked_rows[lane] = 0;
+    m_num_locks[lane] = 0;
+    m_turn_count[lane] = 0;
+    m_is_terminal[lane] = 0;
+    m_curr_player[lane] = 0;
+    m_evaluation_histories[lane].clear();
+
+    if (game_index >= 0) {
+        seed_rng(m_seed, static_cast<std::uint64_t>(game_index));
+        std::uniform_int_distribution<size_t> dist(0, m_num_players - 1);
+        m_curr_player[lane] = static_cast<int>(dist(rng()));
+    }
+}
+
+/**
+ * @brief Writes the results of the game in the given lane to a GameData object.
+ * @details Computes the final scores and the winners as in Game::run(), and reconstructs the final state.
+ * As in Game::run(), the evaluation history ends with the final evaluation (1 if player 0 won, else -1), after the
+ * evaluations made at the start of each turn if the evaluation function is used.
+ * @param lane A size_t representing the lane of the game, which must have ended.
+ * @param data A reference to the GameData object to overwrite.
+ */
+template <size_t N>
+void BatchGame::finish_game(size_t lane, GameData& data) const {
+    data.final_state = State(N, static_cast<size_t>(m_curr_player[lane]));
+    data.final_score.clear();
+
+    for (size_t p = 0; p < N; ++p) {
+        std::array<std::uint16_t, GameConstants::NUM_ROWS> rows{};
+        int score = 0;
+        for (size_t r = 0; r < GameConstants::NUM_ROWS; ++r) {
+            rows[r] = static_cast<std::uint16_t>(m_rows[p][r][lane]);
+
+            // A marked lock counts as two marks
+            const int num_marks = m_num_marked[p][r][lane] + (m_next_index[p][r][lane] == GameConstants::LOCK_INDEX + 1);
+            score += (num_marks * (num_marks + 1)) / 2;
+        }
+        score -= GameConstants::PENALTY_VALUE * m_penalties[p][lane];
+
+        data.final_score.push_back(score);
+        data.final_state.scorepads[p] = Scorepad(rows, m_penalties[p][lane], static_cast<unsigned int>(m_locked_rows[lane]));
+    }
+
+    for (size_t r = 0; r < GameConstants::NUM_ROWS; ++r) {
+        if ((m_locked_rows[lane] >> r) & 1) {
+            data.final_state.lock_row(r);
+        }
+    }
+    data.final_state.turn_count = m_turn_count[lane];
+    data.final_state.num_locks = m_num_locks[lane];
+    data.final_state.is_terminal = true;
+
+    // All players with the max score are deemed winners
+    const int max_val = *std::max_element(data.final_score.begin(), data.final_score.end());
+    data.winners.clear();
+    for (size_t p = 0; p < N; ++p) {
+        if (data.final_score[p] == max_val) {
+            data.winners.push_back(p);
+        }
+    }
+
+    data.p0_evaluation_history.assign(m_evaluation_histories[lane].begin(), m_evaluation_histories[lane].end());
+    data.p0_evaluation_history.push_back(data.winners[0] == 0 ? 1.0 : -1.0);
+    data.num_turns = m_turn_count[lane];
+}
+
+/**
+ * @brief Evaluates the position of every game of a 2-player batch.
+ * @details Computes the features of both players of all lanes from their rows (see row_terms_table), evaluates
+ * them at once, and appends the evaluations to the histories of the lanes that are running a game.
+ */
+void BatchGame::evaluate_kernel() {
+    for (size_t i = 0; i < 2; ++i) {
+        const RowArrays& rows = m_rows[i];
+        for (size_t lane = 0; lane < NUM_LANES; ++lane) {
+            // Multiplying by a row's open flag (1 if the row is unlocked, 0 if it is locked) zeroes out its terms
+            // when locked, as Scorepad::close_row() does
+            std::array<int, GameConstants::NUM_ROWS> open;
+            for (size_t j = 0; j < GameConstants::NUM_ROWS; ++j) {
+                open[j] = ((m_locked_rows[lane] >> j) & 1) ^ 1;
+            }
+            const int red = rows[0][lane];
+            const int yellow = rows[1][lane];
+            const int green = rows[2][lane];
+            const int blue = rows[3][lane];
+
+            m_positions.score[i][lane] = row_terms_table.score[red] + row_terms_table.score[yellow] + row_terms_table.score[green]
+                                         + row_terms_table.score[blue] - GameConstants::PENALTY_VALUE * m_penalties[i][lane];
+            m_positions.freq_count_left[i][lane] = open[0] * row_terms_table.freq_count_left[red] + open[1] * row_terms_table.freq_count_left[yellow]
+                                                   + open[2] * row_terms_table.freq_count_left[green] + open[3] * row_terms_table.freq_count_left[blue];
+            m_positions.top_progress[i][lane] = std::max(static_cast<double>(open[0]) * row_terms_table.lock_progress[red],
+                                                         static_cast<double>(open[1]) * row_terms_table.lock_progress[yellow]);
+            m_positions.bottom_progress[i][lane] = std::max(static_cast<double>(open[2]) * row_terms_table.lock_progress[green],
+                                                            static_cast<double>(open[3]) * row_terms_table.blue_lock_progress[blue]);
+        }
+    }
+    for (size_t lane = 0; lane < NUM_LANES; ++lane) {
+        m_positions.turn_count[lane] = m_turn_count[lane];
+    }
+
+    m_evaluator.evaluate(m_positions, m_evaluations);
+
+    for (size_t lane = 0; lane < NUM_LANES; ++lane) {
+        if (m_game_index[lane] >= 0) {
+            m_evaluation_histories[lane].push_back(m_evaluations[lane]);
+        }
+    }
+}
+
+/**
+ * @brief Rolls the dice of the current turn of every game.
+ * @details Turn t of game i uses dice 6t to 6t + 5 of the dice sequence of stream i (see Philox::fill_dice()). These
+ * always lie within two consecutive blocks, starting at either word 0 or word 2 of the first block, so every lane
+ * computes two blocks and selects six of their words, without branches.
+ */
+void BatchGame::roll_dice_kernel() {
+    for (size_t lane = 0; lane < NUM_LANES; ++lane) {
+        // 32-bit arithmetic suffices for the index of the first die, and lets the compiler vectorize the loop
+        const std::uint64_t stream = static_cast<std::uint64_t>(static_cast<std::int64_t>(m_game_index[lane]));
+        const std::uint32_t first_die = static_cast<std::uint32_t>(GameConstants::NUM_DICE) * static_cast<std::uint32_t>(m_turn_count[lane] - 1);
+        const std::array<std::uint32_t, 4> first_block = Philox::dice_block(m_seed, stream, first_die >> 2);
+        const std::array<std::uint32_t, 4> second_block = Philox::dice_block(m_seed, stream, (first_die >> 2) + 1);
+        const bool offset = (first_die & 3) != 0;
+
+        m_rolls[0][lane] = Philox::to_die(offset ? first_block[2] : first_block[0]);
+        m_rolls[1][lane] = Philox::to_die(offset ? first_block[3] : first_block[1]);
+        m_rolls[2][lane] = Philox::to_die(offset ? second_block[0] : first_block[2]);
+        m_rolls[3][lane] = Philox::to_die(offset ? second_block[1] : first_block[3]);
+        m_rolls[4][lane] = Philox::to_die(offset ? second_block[2] : second_block[0]);
+        m_rolls[5][lane] = Philox::to_die(offset ? second_block[3] : second_block[1]);
+    }
+}
+
+/**
+ * @brief Chooses the greedy move of one player in every game.
+ * @details Generates the legal moves in the same order as generate_legal_moves() (rows in the order of the Color enum,
+ * and, for the second action, the move using the first white die before the move using the second white die), and
+ * chooses the first move with the fewest skipped spaces among those skipping at most max_skips spaces, as in
+ * Greedy::make_move(). A space is legal if its row has not been locked, it lies to the right of all marks in its row,
+ * and, if it is the lock space, at least MIN_MARKS_FOR_LOCK spaces of its row have been marked.
+ * @param next_index A read-only reference to the index after the rightmost mark of each row of the player, for each lane.
+ * @param num_marked A read-only reference to the number of marked spaces of each row of the player, for each lane.
+ * @param max_skips A read-only reference to the maximum number of skipped spaces allowed in each lane.
+ * @param choices A reference to the Choices object to overwrite.
+ */
+template <ActionType A>
+void BatchGame::choose_moves_kernel(const RowArrays& next_index, const RowArrays& num_marked, const LaneArray<int>& max_skips, Choices& choices) const {
+    LaneArray<int> fewest_skips_seen;
+    fewest_skips_seen.fill(std::numeric_limits<int>::max());
+    choices.row.fill(-1);
+    choices.index.fill(0);
+    choices.num_legal.fill(0);
+
+    for (size_t r = 0; r < GameConstants::NUM_ROWS; ++r) {
+        const bool ascending = r == static_cast<size_t>(Color::red) || r == static_cast<size_t>(Color::yellow);
+
+        for (size_t lane = 0; lane < NUM_LANES; ++lane) {
+            // Conditions are combined with bitwise operators, since short-circuit evaluation would prevent vectorization
+            const int row_open = ((m_locked_rows[lane] >> r) & 1) ^ 1;
+            const int lock_allowed = num_marked[r][lane] >= GameConstants::MIN_MARKS_FOR_LOCK;
+            const int next = next_index[r][lane];
+
+            auto consider = [&](int sum) {
+                const int index = ascending ? sum - 2 : 12 - sum;
+                const int legal = row_open & (index >= next) & ((index != static_cast<int>(GameConstants::LOCK_INDEX)) | lock_allowed);
+                const int num_skips = index - next;
+                const int better = legal & (num_skips <= max_skips[lane]) & (num_skips < fewest_skips_seen[lane]);
+
+                choices.num_legal[lane] += legal;
+                fewest_skips_seen[lane] = better ? num_skips : fewest_skips_seen[lane];
+                choices.row[lane] = better ? static_cast<int>(r) : choices.row[lane];
+                choices.index[lane] = better ? index : choices.index[lane];
+            };
+
+            if constexpr (A == ActionType::First) {
+                consider(m_rolls[0][lane] + m_rolls[1][lane]);
+            }
+            else {
+                consider(m_rolls[0][lane] + m_rolls[2 + r][lane]);
+                consider(m_rolls[1][lane] + m_rolls[2 + r][lane]);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Marks the chosen moves of one player on their scorepads.
+ * @param player A size_t representing the player whose scorepads are marked.
+ * @param active A read-only reference to flags indicating the lanes in which the move should be marked.
+ * @param choices A read-only reference to the chosen moves.
+ * @param new_locks A reference to a bitmask of rows for each lane, to which the rows whose lock was marked are added.
+ */
+void BatchGame::mark_moves_kernel(size_t player, const LaneArray<int>& active, const Choices& choices, LaneArray<int>& new_locks) {
+    for (size_t r = 0; r < GameConstants::NUM_ROWS; ++r) {
+        for (size_t lane = 0; lane < NUM_LANES; ++lane) {
+            const int hit = active[lane] & (choices.row[lane] == static_cast<int>(r));
+            const int index = choices.index[lane];
+
+            // Compute hit << index one bit of the index at a time, since shifts by a different amount in each lane
+            // cannot be vectorized on all targets
+            int bit = hit;
+            bit = (index & 1) ? bit << 1 : bit;
+            bit = (index & 2) ? bit << 2 : bit;
+            bit = (index & 4) ? bit << 4 : bit;
+            bit = (index & 8) ? bit << 8 : bit;
+
+            m_rows[player][r][lane] |= bit;
+            m_next_index[player][r][lane] = hit ? index + 1 : m_next_index[player][r][lane];
+            m_num_marked[player][r][lane] += hit;
+            new_locks[lane] |= (hit & (index == static_cast<int>(GameConstants::LOCK_INDEX))) << r;
+        }
+    }
+}
+
+/**
+ * @brief Removes the dice of newly locked rows and checks whether the games have ended.
+ * @details Equivalent to the lock handling of Game::run(): each newly locked row counts as one lock, even if several
+ * players marked its lock during the same action, and a game ends once two locks have been marked.
+ * @param active A read-only reference to flags indicating the lanes to update.
+ * @param new_locks A read-only reference to the bitmask of rows whose lock was marked during the action, for each lane.
+ */
+void BatchGame::lock_kernel(const LaneArray<int>& active, const LaneArray<int>& new_locks) {
+    for (size_t lane = 0; lane < NUM_LANES; ++lane) {
+        const int locks = new_locks[lane] & -active[lane];
+        m_locked_rows[lane] |= locks;
+        m_num_locks[lane] += (locks & 1) + ((locks >> 1) & 1) + ((locks >> 2) & 1) + ((locks >> 3) & 1);
+        m_is_terminal[lane] |= active[lane] & (m_num_locks[lane] >= 2);
+    }
+}
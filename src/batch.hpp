@@ -0,0 +1,119 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#include "evaluation.hpp"
+#include "game.hpp"
+#include "globals.hpp"
+
+/**
+ * @class BatchGame batch.hpp "src/batch.hpp"
+ * @brief Runs many games of Qwixx between greedy agents in lockstep.
+ * @details A BatchGame holds NUM_LANES games at once. The state of these games (scorepads, locks, turn counters,
+ * current players, and dice) is stored in structure-of-arrays form, with one array element per game, so each step
+ * of a turn (rolling the dice, generating the legal moves, choosing the moves of the agents, marking them, and
+ * handling locks and penalties) is a loop over all games without branches, which the compiler can vectorize.
+ * Every game advances by one turn per step. When a game ends, its results are reported through a callback, and
+ * its lane is refilled with the next game to run, until no games are left.
+ * Only the Greedy and GreedyImproved agents are supported, since their policies can be written as such loops (see
+ * supports()). Their decisions are reproduced exactly, and game i uses the dice and the starting player of stream i
+ * of the seed, just like Game::run() after seed_rng(seed, i), so a game played here has the same result as when
+ * it is played by a Game object. In 2-player games, the evaluation function can be used as well: at the start of
+ * each turn, the positions of all lanes are evaluated as one batch (see Evaluator2p), which gives the same
+ * evaluation histories as Game::run().
+ */
+class BatchGame {
+public:
+    /// @brief Number of games advanced in lockstep.
+    static constexpr size_t NUM_LANES = 128;
+
+    BatchGame(const std::vector<int>& agent_ids, std::uint64_t seed, bool use_evaluation);
+
+    static bool supports(const std::vector<int>& agent_ids);
+
+    void run(const std::function<int()>& next_game, const std::function<void(int, const GameData&)>& game_done);
+
+protected:
+    /// @brief An array holding one value for each game of the batch.
+    template <typename T>
+    using LaneArray = std::array<T, NUM_LANES>;
+
+    /// @brief An array holding one LaneArray for each row of the scorepad.
+    using RowArrays = std::array<LaneArray<int>, GameConstants::NUM_ROWS>;
+
+    /**
+     * @struct Choices
+     * @brief Holds the moves chosen by an agent in each game of the batch.
+     */
+    struct Choices {
+        LaneArray<int> row;         //< The row of the chosen move, or -1 when passing.
+        LaneArray<int> index;       //< The index of the chosen move. Only meaningful if row is not -1.
+        LaneArray<int> num_legal;   //< The number of legal moves the agent could choose from.
+    };
+
+    /// @brief A size_t representing the number of players in each game.
+    size_t m_num_players;
+
+    /// @brief The seed of the trial. Game i uses stream i of this seed.
+    std::uint64_t m_seed;
+
+    /// @brief The maximum number of skips of each player's agent.
+    std::array<int, GameConstants::MAX_PLAYERS> m_max_skips;
+
+    /// @brief Whether each player's agent is a GreedyImproved agent (true) or a Greedy agent (false).
+    std::array<bool, GameConstants::MAX_PLAYERS> m_improved;
+
+    // Evaluation. The positions and evaluations hold one element per lane, and the histories are kept for each lane
+    // until its game ends.
+    bool m_use_evaluation;                                              //< Whether the evaluation function is used.
+    Evaluator2p m_evaluator;                                            //< The evaluation function.
+    Positions2p m_positions;                                            //< The positions of the current turn.
+    std::vector<double> m_evaluations;                                  //< The evaluations of the current turn.
+    std::array<std::vector<double>, NUM_LANES> m_evaluation_histories;  //< The evaluation history of each game so far.
+
+    // Scorepads. For each player and row, the bitmask of marked spaces (as in Scorepad), the index after the rightmost
+    // mark (the bit width of the bitmask), and the number of marked spaces (the population count of the bitmask).
+    std::array<RowArrays, GameConstants::MAX_PLAYERS> m_rows;
+    std::array<RowArrays, GameConstants::MAX_PLAYERS> m_next_index;
+    std::array<RowArrays, GameConstants::MAX_PLAYERS> m_num_marked;
+    std::array<LaneArray<int>, GameConstants::MAX_PLAYERS> m_penalties;
+
+    /// @brief Whether each GreedyImproved agent made a move during the first action (see GreedyImproved::make_move()).
+    std::array<LaneArray<int>, GameConstants::MAX_PLAYERS> m_made_first_action_move;
+
+    // Game state that is not part of the scorepads
+    LaneArray<int> m_game_index;        //< Index of the game being played, or -1 if the lane is idle.
+    LaneArray<int> m_locked_rows;       //< Bitmask of the rows that have been locked, i.e. whose die has been removed.
+    LaneArray<int> m_num_locks;         //< Number of locks marked so far.
+    LaneArray<int> m_curr_player;       //< Currently active player.
+    LaneArray<int> m_turn_count;        //< Turn count.
+    LaneArray<int> m_is_terminal;       //< Whether the game has ended.
+
+    /// @brief The dice rolls of the current turn: two white dice, then one die per row in the order of the Color enum.
+    std::array<LaneArray<int>, GameConstants::NUM_DICE> m_rolls;
+
+    template <size_t N>
+    void run_impl(const std::function<int()>& next_game, const std::function<void(int, const GameData&)>& game_done);
+
+    template <size_t N>
+    void play_turn();
+
+    void start_game(size_t lane, int game_index);
+
+    template <size_t N>
+    void finish_game(size_t lane, GameData& data) const;
+
+    void evaluate_kernel();
+
+    void roll_dice_kernel();
+
+    template <ActionType A>
+    void choose_moves_kernel(const RowArrays& next_index, const RowArrays& num_marked, const LaneArray<int>& max_skips, Choices& choices) const;
+
+    void mark_moves_kernel(size_t player, const LaneArray<int>& active, const Choices& choices, LaneArray<int>& new_locks);
+
+    void lock_kernel(const LaneArray<int>& active, const LaneArray<int>& new_locks);
+};
@@ -0,0 +1,407 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "endgame.hpp"
+#include "game.hpp"
+#include "pool.hpp"
+
+/**
+ * @struct EndgameFileHeader
+ * @brief Header at the start of an endgame table file.
+ */
+struct EndgameFileHeader {
+    char magic[8];                  //< Identifies the file format.
+    std::uint32_t version;          //< Version of the file format.
+    std::uint32_t max_score_diff;   //< Largest score difference stored (MAX_SCORE_DIFF).
+    std::uint64_t num_entries;      //< Number of values following the header.
+    std::uint64_t reserved;         //< Unused, keeps the values aligned.
+};
+
+static constexpr char ENDGAME_FILE_MAGIC[8] = {'Q', 'W', 'X', 'E', 'N', 'D', 'G', '\0'};
+static constexpr std::uint32_t ENDGAME_FILE_VERSION = 1;
+
+/// @brief Index of the last space before the lock. A row of a lock race has its rightmost mark here.
+static constexpr int LAST_SPACE_INDEX = static_cast<int>(GameConstants::LOCK_INDEX) - 1;
+
+/**
+ * @struct PlayerState
+ * @brief The state of a player in a lock race, decoded from its index.
+ */
+struct PlayerState {
+    int pair_first;     //< State of one row of the section with two open rows.
+    int pair_second;    //< State of the other row of that section.
+    int single;         //< State of the open row of the other section.
+    int penalties;      //< Number of penalties.
+};
+
+/**
+ * @brief Gets the index of a player state.
+ * @details The pair of rows is indexed as an unordered pair {a, b} with a <= b: b * (b + 1) / 2 + a.
+ * @return An int representing the index, between 0 and NUM_PLAYER_STATES - 1.
+ */
+static int encode_player(int pair_first, int pair_second, int single, int penalties) {
+    const int low = std::min(pair_first, pair_second);
+    const int high = std::max(pair_first, pair_second);
+    const int pair = high * (high + 1) / 2 + low;
+    return (pair * EndgameTable::NUM_ROW_STATES + single) * GameConstants::MAX_PENALTIES + penalties;
+}
+
+/**
+ * @brief Gets the player state of an index, with pair_first <= pair_second.
+ * @param index An int representing the index of the player state.
+ * @return A PlayerState holding the decoded state.
+ */
+static PlayerState decode_player(int index) {
+    PlayerState player{};
+    player.penalties = index % GameConstants::MAX_PENALTIES;
+    index /= GameConstants::MAX_PENALTIES;
+    player.single = index % EndgameTable::NUM_ROW_STATES;
+    int pair = index / EndgameTable::NUM_ROW_STATES;
+    player.pair_second = 0;
+    while (pair > player.pair_second) {
+        pair -= ++player.pair_second;
+    }
+    player.pair_first = pair;
+    return player;
+}
+
+/**
+ * @brief Gets the index of a position in the table.
+ * @param mover An int representing the index of the state of the player about to roll.
+ * @param other An int representing the index of the state of the other player.
+ * @param score_diff An int representing the score of the mover minus the score of the other player, in [-MAX_SCORE_DIFF, MAX_SCORE_DIFF].
+ * @return A size_t representing the index of the value of the position.
+ */
+static std::size_t entry_index(int mover, int other, int score_diff) {
+    return (static_cast<std::size_t>(mover) * EndgameTable::NUM_PLAYER_STATES + static_cast<std::size_t>(other)) * EndgameTable::NUM_SCORE_DIFFS
+           + static_cast<std::size_t>(score_diff + EndgameTable::MAX_SCORE_DIFF);
+}
+
+/**
+ * @brief Constructor taking ownership of a memory mapping of an endgame table file.
+ * @param map A pointer to the start of the mapping.
+ * @param map_size A size_t representing the size of the mapping, in bytes.
+ */
+EndgameTable::EndgameTable(void* map, std::size_t map_size)
+    : m_map(map),
+      m_map_size(map_size),
+      m_values(reinterpret_cast<const float*>(static_cast<const char*>(map) + sizeof(EndgameFileHeader))) {}
+
+/**
+ * @brief Destructor, unmaps the file.
+ */
+EndgameTable::~EndgameTable() {
+    munmap(m_map, m_map_size);
+}
+
+/**
+ * @brief Maps an endgame table file into memory.
+ * @details The file is mapped read-only and shared. Tables are cached by path as long as one of them is in use.
+ * @param path A read-only reference to the path of a file written by solve().
+ * @return A shared pointer to the table.
+ * @throws std::runtime_error if the file cannot be opened or mapped, or is not an endgame table.
+ */
+std::shared_ptr<const EndgameTable> EndgameTable::load(const std::string& path) {
+    static std::mutex cache_mutex;
+    static std::map<std::string, std::weak_ptr<const EndgameTable>> cache;
+
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    if (auto table = cache[path].lock()) {
+        return table;
+    }
+
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open the endgame table " + path + " (write it with --solve-endgame).");
+    }
+
+    struct stat file_stat;
+    const std::size_t expected_size = sizeof(EndgameFileHeader) + NUM_ENTRIES * sizeof(float);
+    if (fstat(fd, &file_stat) != 0 || static_cast<std::size_t>(file_stat.st_size) != expected_size) {
+        close(fd);
+        throw std::runtime_error("The endgame table " + path + " has the wrong size.");
+    }
+
+    void* map = mmap(nullptr, expected_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        throw std::runtime_error("Could not map the endgame table " + path + ".");
+    }
+
+    const auto* header = static_cast<const EndgameFileHeader*>(map);
+    if (std::memcmp(header->magic, ENDGAME_FILE_MAGIC, sizeof(ENDGAME_FILE_MAGIC)) != 0 || header->version != ENDGAME_FILE_VERSION
+        || header->max_score_diff != MAX_SCORE_DIFF || header->num_entries != NUM_ENTRIES) {
+        munmap(map, expected_size);
+        throw std::runtime_error("The file " + path + " is not an endgame table of this version.");
+    }
+
+    std::shared_ptr<const EndgameTable> table(new EndgameTable(map, expected_size));
+    cache[path] = table;
+    return table;
+}
+
+/**
+ * @brief Gets the endgame table configured for this process.
+ * @details The table is loaded once, from the path in the environment variable QWIXX_ENDGAME_TABLE, and kept until
+ * the program exits. Without this variable, no table is used, so the evaluation function and agents behave as if
+ * there were no table.
+ * @return A pointer to the table, or nullptr if QWIXX_ENDGAME_TABLE is not set.
+ * @throws std::runtime_error if the table cannot be loaded.
+ */
+const EndgameTable* EndgameTable::configured() {
+    static const std::shared_ptr<const EndgameTable> table = [] {
+        const char* path = std::getenv("QWIXX_ENDGAME_TABLE");
+        return (path != nullptr && path[0] != '\0') ? load(path) : nullptr;
+    }();
+    return table.get();
+}
+
+/**
+ * @brief Gets the points scored by marking the lock of a row.
+ * @param row_state An int representing the state of the row.
+ * @return An int representing the points, including the mark of the lock, or 0 if the row cannot be locked.
+ */
+int EndgameTable::lock_points(int row_state) {
+    // A row with n marks gains n + 1 and n + 2 points from the lock, which counts as two marks
+    const int marks = row_state + GameConstants::MIN_MARKS_FOR_LOCK - 1;
+    return row_state == 0 ? 0 : 2 * marks + 3;
+}
+
+/**
+ * @brief Gets the result of a finished game for a player.
+ * @param score_diff An int representing the final score of the player minus that of the other player.
+ * @return A double which is 1 for a win, 0.5 for a tie, and 0 for a loss.
+ */
+double EndgameTable::result(int score_diff) {
+    return score_diff > 0 ? 1.0 : (score_diff == 0 ? 0.5 : 0.0);
+}
+
+/**
+ * @brief Gets the locked row of a 2-player position, if it can be a lock race.
+ * @param state A read-only reference to the game state.
+ * @return A size_t option holding the index of the locked row if the game has 2 players, is not over, and has exactly one locked row.
+ */
+std::optional<std::size_t> EndgameTable::closed_row(const State& state) {
+    if (state.scorepads.size() != 2 || state.is_terminal || std::count(state.locked_rows.begin(), state.locked_rows.end(), true) != 1) {
+        return std::nullopt;
+    }
+    return static_cast<std::size_t>(std::find(state.locked_rows.begin(), state.locked_rows.end(), true) - state.locked_rows.begin());
+}
+
+/**
+ * @brief Gets the index of the state of a player in a lock race.
+ * @param scorepad A read-only reference to the scorepad of the player.
+ * @param closed_row A size_t representing the index of the locked row.
+ * @return An int option holding the index of the player state, or the null option if a row of the player can still take an
+ * ordinary mark or the player has MAX_PENALTIES penalties.
+ */
+std::optional<int> EndgameTable::player_index(const Scorepad& scorepad, std::size_t closed_row) {
+    const int penalties = scorepad.get_num_penalties();
+    if (penalties >= GameConstants::MAX_PENALTIES) {
+        return std::nullopt;
+    }
+
+    // The section without the locked row holds the pair, and the other open row is the single row
+    const bool top_closed = closed_row < 2;
+    const std::array<std::size_t, 3> open_rows = top_closed ? std::array<std::size_t, 3>{2, 3, 1 - closed_row}
+                                                            : std::array<std::size_t, 3>{0, 1, 5 - closed_row};
+    std::array<int, 3> row_states{};
+    for (size_t k = 0; k < open_rows.size(); ++k) {
+        const std::uint16_t row = scorepad.get_row_mask(static_cast<Color>(open_rows[k]));
+        if (std::bit_width(row) != LAST_SPACE_INDEX + 1) {
+            return std::nullopt;
+        }
+        const int marks = std::popcount(row);
+        row_states[k] = (marks >= GameConstants::MIN_MARKS_FOR_LOCK) ? marks - (GameConstants::MIN_MARKS_FOR_LOCK - 1) : 0;
+    }
+
+    return encode_player(row_states[0], row_states[1], row_states[2], penalties);
+}
+
+/**
+ * @brief Gets the probability that the mover wins.
+ * @param mover An int representing the index of the state of the player about to roll.
+ * @param other An int representing the index of the state of the other player.
+ * @param score_diff An int representing the score of the mover minus the score of the other player. Any value is accepted.
+ * @return A double representing the probability that the mover wins, counting a tie as half a win.
+ */
+double EndgameTable::value(int mover, int other, int score_diff) const {
+    if (score_diff > MAX_SCORE_DIFF) {
+        return 1.0;
+    }
+    if (score_diff < -MAX_SCORE_DIFF) {
+        return 0.0;
+    }
+    return static_cast<double>(m_values[entry_index(mover, other, score_diff)]);
+}
+
+/**
+ * @brief Gets the probability that a player wins from a position at the start of a turn.
+ * @param state A read-only reference to the state of a 2-player game, before the dice of the turn are rolled.
+ * @param player A size_t representing the player (0 or 1).
+ * @return A double option holding the probability that the player wins (a tie counts as half a win), or the null
+ * option if the position is not a lock race.
+ */
+std::optional<double> EndgameTable::win_probability(const State& state, std::size_t player) const {
+    const std::optional<std::size_t> closed = closed_row(state);
+    if (!closed.has_value()) {
+        return std::nullopt;
+    }
+
+    const size_t mover = state.curr_player;
+    const size_t other = 1 - mover;
+    const std::optional<int> mover_index = player_index(state.scorepads[mover], closed.value());
+    const std::optional<int> other_index = player_index(state.scorepads[other], closed.value());
+    if (!mover_index.has_value() || !other_index.has_value()) {
+        return std::nullopt;
+    }
+
+    const double mover_value = value(mover_index.value(), other_index.value(),
+                                     state.scorepads[mover].get_score() - state.scorepads[other].get_score());
+    return (player == mover) ? mover_value : 1.0 - mover_value;
+}
+
+/**
+ * @brief Computes the values of a pair of player states, for every score difference, from the positions after the turn.
+ * @details The pair section locks with a white double six in the first action, or a white six and a six on the row's die
+ * in the second action (after swapping the sections if needed, see the class documentation), and the single row with
+ * ones. Only whether each die shows a one, a six, or something else matters, so the rolls are grouped by the white dice:
+ * a double six, a double one, a six and a one, a six and another value, a one and another value, or neither.
+ * @param mover An int representing the index of the state of the player about to roll.
+ * @param other An int representing the index of the state of the other player.
+ * @param values A reference to the table being computed, holding the values with more penalties. The values of the pair are written to it.
+ */
+static void solve_pair(int mover, int other, std::vector<float>& values) {
+    constexpr int MAX = EndgameTable::MAX_SCORE_DIFF;
+    const PlayerState m = decode_player(mover);
+    const PlayerState o = decode_player(other);
+
+    const std::array<int, 3> mover_points = {EndgameTable::lock_points(m.pair_first), EndgameTable::lock_points(m.pair_second),
+                                             EndgameTable::lock_points(m.single)};
+    const int mover_pair_points = std::max(mover_points[0], mover_points[1]);
+    const int other_pair_points = std::max(EndgameTable::lock_points(o.pair_first), EndgameTable::lock_points(o.pair_second));
+    const int other_single_points = EndgameTable::lock_points(o.single);
+    const bool last_penalty = (m.penalties + 1 == GameConstants::MAX_PENALTIES);
+    const int next_mover = last_penalty ? 0 : encode_player(m.pair_first, m.pair_second, m.single, m.penalties + 1);
+
+    for (int diff = -MAX; diff <= MAX; ++diff) {
+        // Value of not locking: a penalty, after which the other player rolls, or the game ends
+        const int diff_after_penalty = diff - GameConstants::PENALTY_VALUE;
+        double penalty_value;
+        if (last_penalty) {
+            penalty_value = EndgameTable::result(diff_after_penalty);
+        }
+        else if (-diff_after_penalty > MAX) {
+            penalty_value = 0.0;
+        }
+        else if (-diff_after_penalty < -MAX) {
+            penalty_value = 1.0;
+        }
+        else {
+            penalty_value = 1.0 - static_cast<double>(values[entry_index(other, next_mover, -diff_after_penalty)]);
+        }
+
+        // Expected value of the second action, over the rows' dice, when a white die shows a six or a one
+        auto second_action = [&](bool six, bool one) {
+            double expectation = 0.0;
+            for (unsigned int hits = 0; hits < 8; ++hits) {
+                double probability = 1.0;
+                int points = 0;
+                for (size_t k = 0; k < 3; ++k) {
+                    const bool hit = (hits >> k) & 1;
+                    probability *= hit ? 1.0 / 6.0 : 5.0 / 6.0;
+                    if (hit && (k < 2 ? six : one)) {
+                        points = std::max(points, mover_points[k]);
+                    }
+                }
+                expectation += probability * (points > 0 ? std::max(penalty_value, EndgameTable::result(diff + points)) : penalty_value);
+            }
+            return expectation;
+        };
+
+        // First action after a white double: locking is the best reply to a lock, so both lock if both can
+        auto first_action = [&](int points, int other_points, double continuation) {
+            if (points > 0 && other_points > 0) {
+                return EndgameTable::result(diff + points - other_points);
+            }
+            if (points > 0) {
+                return std::max(EndgameTable::result(diff + points), continuation);
+            }
+            if (other_points > 0) {
+                return std::min(EndgameTable::result(diff - other_points), continuation);
+            }
+            return continuation;
+        };
+
+        const double double_six = first_action(mover_pair_points, other_pair_points, second_action(true, false));
+        const double double_one = first_action(mover_points[2], other_single_points, second_action(false, true));
+        const double value = (double_six + double_one + 2.0 * second_action(true, true) + 8.0 * second_action(true, false)
+                              + 8.0 * second_action(false, true) + 16.0 * penalty_value) / 36.0;
+        values[entry_index(mover, other, diff)] = static_cast<float>(value);
+    }
+}
+
+/**
+ * @brief Solves the lock races and writes the endgame table to a file.
+ * @details Every turn of a lock race either ends the game or gives the mover a penalty, so the positions are solved
+ * by decreasing total number of penalties, each group spread over the workers of the pool.
+ * @param path A read-only reference to the path of the file to write.
+ * @param pool A reference to the WorkerPool used to solve the positions.
+ * @return A double representing the probability that the mover wins the lock race in which both players have two lockable
+ * rows with 5 marks in the pair section, no penalties, and equal scores.
+ * @throws std::runtime_error if the file cannot be written.
+ */
+double EndgameTable::solve(const std::string& path, WorkerPool& pool) {
+    std::vector<float> values(NUM_ENTRIES, 0.0f);
+
+    for (int total = 2 * (GameConstants::MAX_PENALTIES - 1); total >= 0; --total) {
+        std::vector<std::array<int, 2>> pairs;
+        for (int mover = 0; mover < NUM_PLAYER_STATES; ++mover) {
+            for (int other = 0; other < NUM_PLAYER_STATES; ++other) {
+                if (mover % GameConstants::MAX_PENALTIES + other % GameConstants::MAX_PENALTIES == total) {
+                    pairs.push_back({mover, other});
+                }
+            }
+        }
+
+        const std::int64_t chunk_size = 256;
+        std::atomic<std::int64_t> next_pair = 0;
+        pool.run(pool.size(), [&](unsigned int) {
+            for (std::int64_t begin = next_pair.fetch_add(chunk_size); begin < static_cast<std::int64_t>(pairs.size()); begin = next_pair.fetch_add(chunk_size)) {
+                const std::int64_t end = std::min<std::int64_t>(static_cast<std::int64_t>(pairs.size()), begin + chunk_size);
+                for (std::int64_t i = begin; i < end; ++i) {
+                    solve_pair(pairs[i][0], pairs[i][1], values);
+                }
+            }
+        });
+    }
+
+    EndgameFileHeader header{};
+    std::memcpy(header.magic, ENDGAME_FILE_MAGIC, sizeof(ENDGAME_FILE_MAGIC));
+    header.version = ENDGAME_FILE_VERSION;
+    header.max_score_diff = MAX_SCORE_DIFF;
+    header.num_entries = NUM_ENTRIES;
+
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(float)));
+    if (!file) {
+        throw std::runtime_error("Could not write the endgame table " + path + ".");
+    }
+
+    const int player = encode_player(1, 1, 0, 0);
+    return static_cast<double>(values[entry_index(player, player, 0)]);
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+
+#include "globals.hpp"
+
+class Scorepad;
+struct State;
+class WorkerPool;
+
+/**
+ * @class EndgameTable endgame.hpp "src/endgame.hpp"
+ * @brief Exact win probabilities of 2-player lock races, read from a memory-mapped file.
+ * @details A lock race is a 2-player position in which one row has been locked, and every other row of both players
+ * either has its second-to-last space marked (so only the lock is left) or cannot be marked anymore. The only moves
+ * left are locks, and the next lock ends the game, so each turn ends the game or gives the active player a penalty.
+ * These are the only endgames solved, for two reasons. Once rows can still take ordinary marks, the number of
+ * positions (with the score difference) is far beyond what fits in a table. And in the first action both players
+ * choose their moves at the same time, which in general requires mixed strategies. In a lock race, locking is the
+ * best reply to the other player's lock (the game ends either way, with more points), so both players locking is a
+ * saddle point whenever both can lock, and the value is exact with pure strategies.
+ *
+ * The position is stored from the point of view of the player about to roll (the mover): the state of each player
+ * (see player_index()) and the score difference, mover minus other, from -MAX_SCORE_DIFF to MAX_SCORE_DIFF. Beyond
+ * this range the outcome is already decided. The three open rows of a player are the two rows of the section (red and
+ * yellow, or green and blue) without a locked row, stored as an unordered pair, and the single row left in the other
+ * section. Swapping the sections and replacing each die value v with 7 - v leaves the game unchanged, so the table
+ * does not depend on which row was locked. Each entry is the probability that the mover wins, counting a tie as half a win.
+ *
+ * The table is built by solve(), from the positions with the most penalties to those with the fewest: a turn without
+ * a lock always adds a penalty. It is used by Evaluator2p and the Solitaire agent when the environment variable
+ * QWIXX_ENDGAME_TABLE holds its path (see configured()).
+ */
+class EndgameTable {
+public:
+    static constexpr int NUM_ROW_STATES = 7;                //< States of an open row: dead (0), or lockable with 4 + state marks.
+    static constexpr int NUM_PAIR_STATES = NUM_ROW_STATES * (NUM_ROW_STATES + 1) / 2;                   //< Unordered pairs of row states.
+    static constexpr int NUM_PLAYER_STATES = NUM_PAIR_STATES * NUM_ROW_STATES * GameConstants::MAX_PENALTIES;   //< States of a player.
+    static constexpr int MAX_SCORE_DIFF = 43;               //< Largest score difference that a lock and the penalties left can still change.
+    static constexpr int NUM_SCORE_DIFFS = 2 * MAX_SCORE_DIFF + 1;
+    static constexpr std::size_t NUM_ENTRIES = static_cast<std::size_t>(NUM_PLAYER_STATES) * NUM_PLAYER_STATES * NUM_SCORE_DIFFS;   //< Number of values in the table.
+
+    ~EndgameTable();
+
+    EndgameTable(const EndgameTable&) = delete;
+    EndgameTable& operator=(const EndgameTable&) = delete;
+
+    static std::shared_ptr<const EndgameTable> load(const std::string& path);
+    static const EndgameTable* configured();
+    static double solve(const std::string& path, WorkerPool& pool);
+
+    double value(int mover, int other, int score_diff) const;
+    std::optional<double> win_probability(const State& state, std::size_t player) const;
+
+    static std::optional<int> player_index(const Scorepad& scorepad, std::size_t closed_row);
+    static std::optional<std::size_t> closed_row(const State& state);
+    static int lock_points(int row_state);
+    static double result(int score_diff);
+
+protected:
+    EndgameTable(void* map, std::size_t map_size);
+
+    void* m_map;                //< Start of the memory mapping of the file.
+    std::size_t m_map_size;     //< Size of the memory mapping, in bytes.
+    const float* m_values;      //< Values of the table, inside the mapping.
+};
@@ -0,0 +1,293 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
+#include <tuple>
+
+#include "endgame.hpp"
+#include "evaluation.hpp"
+#include "game.hpp"
+
+/**
+ * @brief Constructor setting the default parameters.
+ * @details Sets the scale factors and bias, and computes the weights for each turn. The weights start at 0.25
+ * (score difference), 0.40 (frequency count difference), and 0.35 (lock progress difference), and from turn
+ * RAMP_START to turn RAMP_END, move in equal steps towards 0.75, 0.15, and 0.10 respectively. The values of 7 and 22
+ * are somewhat arbitrary. An average Qwixx game between the stronger agents lasts for about 23 turns, so we consider
+ * turn 8 to be the end of the early game and turn 23 to be the end of the late game. The steps are accumulated one
+ * turn at a time, so each weight is exactly the value it would have if it were updated once per turn.
+ */
+Evaluator2p::Parameters::Parameters() {
+    const double range = static_cast<double>(RAMP_END - RAMP_START + 1);
+    double score_diff = 0.25;
+    double freq_count_diff = 0.40;
+    double lock_progress_diff = 0.35;
+
+    for (int turn = 0; turn <= RAMP_END; ++turn) {
+        if (turn >= RAMP_START) {
+            score_diff += (0.75 - 0.25) / range;
+            freq_count_diff -= (0.40 - 0.15) / range;
+            lock_progress_diff -= (0.35 - 0.10) / range;
+        }
+        score_diff_weight[turn] = score_diff;
+        freq_count_diff_weight[turn] = freq_count_diff;
+        lock_progress_diff_weight[turn] = lock_progress_diff;
+    }
+}
+
+/**
+ * @brief Reads parameters from a text file.
+ * @details The file holds one line for each member, in any order, as written by save(): "link linear" or "link logistic",
+ * the name of each scale factor or of the bias followed by its value, and the name of each weight table followed by
+ * RAMP_END + 1 values. Blank lines and lines starting with # are ignored.
+ * @param path A read-only reference to a string holding the path of the file.
+ * @return The Parameters read from the file.
+ * @throws std::runtime_error if the file cannot be opened, or does not set every member exactly once.
+ */
+Evaluator2p::Parameters Evaluator2p::Parameters::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("Could not open the evaluation parameter file " + path + ".");
+    }
+
+    Parameters parameters;
+    const std::array<std::tuple<const char*, std::span<double>>, 7> fields = {
+        std::tuple("score_diff_weight", std::span<double>(parameters.score_diff_weight)),
+        std::tuple("freq_count_diff_weight", std::span<double>(parameters.freq_count_diff_weight)),
+        std::tuple("lock_progress_diff_weight", std::span<double>(parameters.lock_progress_diff_weight)),
+        std::tuple("score_diff_scale_factor", std::span<double>(&parameters.score_diff_scale_factor, 1)),
+        std::tuple("freq_count_diff_scale_factor", std::span<double>(&parameters.freq_count_diff_scale_factor, 1)),
+        std::tuple("lock_progress_diff_scale_factor", std::span<double>(&parameters.lock_progress_diff_scale_factor, 1)),
+        std::tuple("lock_progress_diff_bias", std::span<double>(&parameters.lock_progress_diff_bias, 1))
+    };
+    std::array<bool, fields.size() + 1> found{};
+
+    std::string line;
+    while (std::getline(file, line)) {
+        std::istringstream iss(line);
+        std::string name;
+        if (!(iss >> name) || name[0] == '#') {
+            continue;
+        }
+
+        bool valid = true;
+        if (name == "link") {
+            std::string link;
+            valid = !found[fields.size()] && (iss >> link) && (link == "linear" || link == "logistic");
+            parameters.logistic = link == "logistic";
+            found[fields.size()] = true;
+        }
+        else {
+            size_t f = 0;
+            while (f < fields.size() && name != std::get<0>(fields[f])) {
+                ++f;
+            }
+            valid = f < fields.size() && !found[f];
+            for (size_t i = 0; valid && i < std::get<1>(fields[f]).size(); ++i) {
+                valid = static_cast<bool>(iss >> std::get<1>(fields[f])[i]);
+            }
+            if (valid) {
+                found[f] = true;
+            }
+        }
+
+        if (!valid || !(iss >> std::ws).eof()) {
+            throw std::runtime_error("Invalid line in the evaluation parameter file " + path + ": " + line);
+        }
+    }
+
+    if (std::find(found.begin(), found.end(), false) != found.end()) {
+        throw std::runtime_error("The evaluation parameter file " + path + " does not set every parameter.");
+    }
+    return parameters;
+}
+
+/**
+ * @brief Writes the parameters to a text file that load() can read back exactly.
+ * @param path A read-only reference to a string holding the path of the file.
+ * @throws std::runtime_error if the file cannot be written.
+ */
+void Evaluator2p::Parameters::save(const std::string& path) const {
+    std::ofstream file(path);
+    file << std::setprecision(std::numeric_limits<double>::max_digits10) << "link " << (logistic ? "logistic" : "linear")
+         << "\nscore_diff_scale_factor " << score_diff_scale_factor << "\nfreq_count_diff_scale_factor " << freq_count_diff_scale_factor
+         << "\nlock_progress_diff_scale_factor " << lock_progress_diff_scale_factor << "\nlock_progress_diff_bias " << lock_progress_diff_bias;
+    for (const auto& [name, weights] : {std::tuple("score_diff_weight", &score_diff_weight), std::tuple("freq_count_diff_weight", &freq_count_diff_weight),
+                                        std::tuple("lock_progress_diff_weight", &lock_progress_diff_weight)}) {
+        file << '\n' << name;
+        for (const double weight : *weights) {
+            file << ' ' << weight;
+        }
+    }
+    file << '\n';
+    file.close();
+    if (!file) {
+        throw std::runtime_error("Could not write the evaluation parameter file " + path + ".");
+    }
+}
+
+/**
+ * @brief Gets the parameters used by default-constructed evaluators.
+ * @details The parameters are read once, from the file whose path is in the environment variable
+ * QWIXX_EVALUATION_PARAMETERS (e.g. the parameters written by --fit-evaluation). Without this variable, the defaults
+ * are used.
+ * @return A read-only reference to the parameters.
+ * @throws std::runtime_error if the file cannot be read.
+ */
+const Evaluator2p::Parameters& Evaluator2p::Parameters::configured() {
+    static const Parameters parameters = [] {
+        const char* path = std::getenv("QWIXX_EVALUATION_PARAMETERS");
+        return (path != nullptr && path[0] != '\0') ? load(path) : Parameters{};
+    }();
+    return parameters;
+}
+
+/**
+ * @brief Default constructor.
+ * @details Uses the configured parameters (see Parameters::configured()).
+ */
+Evaluator2p::Evaluator2p() : Evaluator2p(Parameters::configured()) {}
+
+/**
+ * @brief Constructor with the given parameters.
+ * @details Also looks up the configured endgame table, if any.
+ * @param parameters A read-only reference to the parameters of the evaluation function.
+ */
+Evaluator2p::Evaluator2p(const Parameters& parameters)
+    : m_score_diff_weight(parameters.score_diff_weight),
+      m_freq_count_diff_weight(parameters.freq_count_diff_weight),
+      m_lock_progress_diff_weight(parameters.lock_progress_diff_weight),
+      m_score_diff_scale_factor(parameters.score_diff_scale_factor),
+      m_freq_count_diff_scale_factor(parameters.freq_count_diff_scale_factor),
+      m_lock_progress_diff_scale_factor(parameters.lock_progress_diff_scale_factor),
+      m_lock_progress_diff_bias(parameters.lock_progress_diff_bias),
+      m_logistic(parameters.logistic),
+      m_endgame_table(EndgameTable::configured()) {}
+
+/**
+ * @brief Computes the weighted sum of the terms of the position given by the features of both players and the turn count.
+ * @details A player's lock progress is the best progress in the top section plus the best progress in the bottom
+ * section, shifted by the bias and divided by the scale factor, then clamped between -1 and 1. Every term is computed
+ * without branches, so that this function can be vectorized across a batch of positions.
+ * @return A double representing the weighted sum with respect to player 0, which is the evaluation itself unless the
+ * link is logistic.
+ */
+inline double Evaluator2p::weighted_sum(const std::array<int, 2>& score, const std::array<int, 2>& freq_count_left,
+                                        const std::array<double, 2>& top_progress, const std::array<double, 2>& bottom_progress,
+                                        int turn_count) const {
+    const int turn = std::min(turn_count, RAMP_END);
+
+    std::array<double, 2> lock_progress;
+    for (size_t i = 0; i < 2; ++i) {
+        lock_progress[i] = std::max(-1.0, std::min(1.0, (top_progress[i] + bottom_progress[i] - m_lock_progress_diff_bias) / m_lock_progress_diff_scale_factor));
+    }
+
+    const int score_diff = score[0] - score[1];
+    const double score_diff_term = m_score_diff_weight[turn] * std::max(-1.0, std::min(1.0, static_cast<double>(score_diff) / m_score_diff_scale_factor));
+
+    const int freq_count_diff = freq_count_left[0] - freq_count_left[1];
+    const double freq_count_diff_term = m_freq_count_diff_weight[turn] * std::max(-1.0, std::min(1.0, (static_cast<double>(freq_count_diff) / m_freq_count_diff_scale_factor)));
+
+    const double lock_progress_diff = lock_progress[0] - lock_progress[1];
+    const double lock_progress_diff_term = m_lock_progress_diff_weight[turn] * std::max(-1.0, std::min(1.0, lock_progress_diff));
+
+    // The starting evaluation is 0, with either link
+    return turn_count == 0 ? 0.0 : score_diff_term + freq_count_diff_term + lock_progress_diff_term;
+}
+
+/**
+ * @brief Evaluates a batch of positions.
+ * @details Each evaluation is in [-1, 1] and taken with respect to player 0. Positions are independent of
+ * each other, so the loop over them has no dependencies between iterations. With the logistic link, the weighted sums
+ * are mapped to evaluations in a second loop, so that the first one is the same for both links.
+ * @param positions A read-only reference to the batch of positions.
+ * @param evaluations A span of doubles with at least positions.size() elements, to which the evaluations are written.
+ */
+void Evaluator2p::evaluate(const Positions2p& positions, std::span<double> evaluations) const {
+    // Work on a local copy of the weights and scale factors, since the compiler can only vectorize the lookups in the
+    // weight tables if they can't alias the evaluations being written
+    const Evaluator2p evaluator = *this;
+    for (size_t k = 0; k < positions.size(); ++k) {
+        evaluations[k] = evaluator.weighted_sum({positions.score[0][k], positions.score[1][k]},
+                                                {positions.freq_count_left[0][k], positions.freq_count_left[1][k]},
+                                                {positions.top_progress[0][k], positions.top_progress[1][k]},
+                                                {positions.bottom_progress[0][k], positions.bottom_progress[1][k]},
+                                                positions.turn_count[k]);
+    }
+
+    // 2p - 1 = tanh(z / 2), where p = 1 / (1 + exp(-z)) is the win probability given by the log-odds z
+    if (m_logistic) {
+        for (size_t k = 0; k < positions.size(); ++k) {
+            evaluations[k] = std::tanh(0.5 * evaluations[k]);
+        }
+    }
+}
+
+/**
+ * @brief Evaluates a single position.
+ * @details Reads the running totals of both scorepads, so this takes constant time. If the position is a lock race
+ * covered by the configured endgame table, the exact expected result is returned instead: 2p - 1, where p is the
+ * probability that player 0 wins (counting a tie as half a win).
+ * @param state A read-only reference to the state of a 2-player game, at the start of a turn.
+ * @return A double in [-1, 1] representing the evaluation with respect to player 0.
+ */
+double Evaluator2p::evaluate(const State& state) const {
+    if (m_endgame_table != nullptr) {
+        if (const std::optional<double> probability = m_endgame_table->win_probability(state, 0)) {
+            return 2.0 * probability.value() - 1.0;
+        }
+    }
+
+    const Scorepad& p0 = state.scorepads[0];
+    const Scorepad& p1 = state.scorepads[1];
+    const double sum = weighted_sum({p0.get_score(), p1.get_score()}, {p0.get_freq_count_left(), p1.get_freq_count_left()},
+                                    {p0.get_top_progress(), p1.get_top_progress()}, {p0.get_bottom_progress(), p1.get_bottom_progress()},
+                                    state.turn_count);
+    return m_logistic ? std::tanh(0.5 * sum) : sum;
+}
+
+/**
+ * @brief Appends a position to the batch.
+ * @param state A read-only reference to the state of a 2-player game.
+ */
+void Positions2p::push_back(const State& state) {
+    for (size_t i = 0; i < 2; ++i) {
+        const Scorepad& scorepad = state.scorepads[i];
+        score[i].push_back(scorepad.get_score());
+        freq_count_left[i].push_back(scorepad.get_freq_count_left());
+        top_progress[i].push_back(scorepad.get_top_progress());
+        bottom_progress[i].push_back(scorepad.get_bottom_progress());
+    }
+    turn_count.push_back(state.turn_count);
+}
+
+/// @brief Removes all positions from the batch, keeping the capacity of its members.
+void Positions2p::clear() {
+    for (size_t i = 0; i < 2; ++i) {
+        score[i].clear();
+        freq_count_left[i].clear();
+        top_progress[i].clear();
+        bottom_progress[i].clear();
+    }
+    turn_count.clear();
+}
+
+/**
+ * @brief Resizes the batch to hold the given number of positions.
+ * @details New positions have all features set to 0. Used to write positions in place, one element per member.
+ * @param size A size_t representing the new number of positions.
+ */
+void Positions2p::resize(size_t size) {
+    for (size_t i = 0; i < 2; ++i) {
+        score[i].resize(size);
+        freq_count_left[i].resize(size);
+        top_progress[i].resize(size);
+        bottom_progress[i].resize(size);
+    }
+    turn_count.resize(size);
+}
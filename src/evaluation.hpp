@@ -0,0 +1,190 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+#include "globals.hpp"
+
+class EndgameTable;
+struct State;
+
+/**
+ * @struct RowTerms evaluation.hpp "src/evaluation.hpp"
+ * @brief Contributions of a row to the terms of the evaluation function, for each bitmask of marked spaces.
+ * @details Stored as one array per term, so that a batch of rows can load each term with vector instructions.
+ */
+struct RowTerms {
+    /// @brief Number of possible bitmasks of marked spaces in a row.
+    static constexpr size_t NUM_ROW_MASKS = 1u << GameConstants::NUM_CELLS_PER_ROW;
+
+    std::array<int, NUM_ROW_MASKS> score;                   //< Contribution to the score.
+    std::array<int, NUM_ROW_MASKS> freq_count_left;         //< Frequency counts left, from the rightmost mark to the lock. Only counted for unlocked rows.
+    std::array<double, NUM_ROW_MASKS> lock_progress;        //< Number of marks plus the average frequency counts left per mark needed for the lock.
+    std::array<double, NUM_ROW_MASKS> blue_lock_progress;   //< Lock progress as used for the blue row, which counts the average frequency counts twice instead.
+};
+
+/**
+ * @brief Lookup table mapping the bitmask of marked spaces in a row to its contributions to the evaluation function.
+ * @details Since marks are always placed to the right of all other marks, the bitmask determines the number of marks
+ * and the rightmost mark, which is all the evaluation function uses. Note the following details, which the table keeps
+ * as the evaluation function has always computed them: the frequency counts left include the space of the rightmost
+ * mark (and the first space of an empty row), the frequency counts available for the lock exclude the first space of
+ * an empty row, and rows with more than five marks get the worst lock progress, since the number of marks needed is
+ * an unsigned number that wraps around. Used by Scorepad to keep its running totals up to date. Generated at compile time.
+ */
+inline constexpr RowTerms row_terms_table = [] {
+    // The relative frequency for rolling the number in each space (2 to 12, or the reverse)
+    constexpr std::array<int, GameConstants::NUM_CELLS_PER_ROW> frequency_counts = {1, 2, 3, 4, 5, 6, 5, 4, 3, 2, 1};
+
+    RowTerms table{};
+    for (unsigned int row = 0; row < RowTerms::NUM_ROW_MASKS; ++row) {
+        const int num_marks = std::popcount(row) + static_cast<int>((row >> GameConstants::LOCK_INDEX) & 1);
+        const size_t rightmost_index = row == 0 ? 0 : static_cast<size_t>(std::bit_width(row)) - 1;
+
+        table.score[row] = (num_marks * (num_marks + 1)) / 2;
+
+        for (size_t k = rightmost_index; k <= GameConstants::LOCK_INDEX; ++k) {
+            table.freq_count_left[row] += frequency_counts[k];
+        }
+
+        // The lock progress is made of the number of marks in this row, and the average number of frequency
+        // counts left per mark needed in order to gain access to the lock
+        int progress_marks = 0;
+        double progress_value = 0.0;
+        const size_t spaces_left = GameConstants::LOCK_INDEX - rightmost_index + 1;
+        const size_t marks_needed = GameConstants::MIN_MARKS_FOR_LOCK - static_cast<size_t>(num_marks);
+        if (spaces_left < marks_needed) {
+            // It isn't possible to mark the lock in this row, so use the worst values possible for progress
+            progress_value = -3.0;
+        }
+        else if (num_marks >= 5) {
+            // It's already possible to mark the lock in this row, so use the best values possible for progress
+            progress_marks = 5;
+            progress_value = 3.0;
+        }
+        else {
+            int freq_count_left = 0;
+            for (size_t k = rightmost_index + 1; k < GameConstants::LOCK_INDEX; ++k) {
+                freq_count_left += frequency_counts[k];
+            }
+
+            // Subtract 7, since this is the average for an empty row, and clamp the value between -3 and 3
+            const double freq_count_per_marks_needed = static_cast<double>(freq_count_left) / static_cast<double>(marks_needed);
+            progress_marks = num_marks;
+            progress_value = std::max(-3.0, std::min(3.0, freq_count_per_marks_needed - 7.0));
+        }
+
+        table.lock_progress[row] = static_cast<double>(progress_marks) + progress_value;
+        table.blue_lock_progress[row] = progress_value + progress_value;
+    }
+    return table;
+}();
+
+/**
+ * @struct Positions2p evaluation.hpp "src/evaluation.hpp"
+ * @brief A batch of 2-player positions in structure-of-arrays form.
+ * @details Holds exactly the features of a State that the evaluation function depends on: the score, frequency counts
+ * left, and lock progress of both players, and the turn count. These are read from the running totals kept by each
+ * Scorepad, so adding a position takes constant time. Each member holds one element per position, so that
+ * Evaluator2p::evaluate() can process the batch with one loop per term. The capacity of the members is kept
+ * by clear(), so a reused batch does not allocate memory once it has held as many positions as it needs to.
+ */
+struct Positions2p {
+    /// @brief The score of each player, for each position.
+    std::array<std::vector<int>, 2> score;
+
+    /// @brief The frequency counts left in the unlocked rows of each player, for each position.
+    std::array<std::vector<int>, 2> freq_count_left;
+
+    /// @brief The best lock progress in the top section (red and yellow rows) of each player, for each position.
+    std::array<std::vector<double>, 2> top_progress;
+
+    /// @brief The best lock progress in the bottom section (green and blue rows) of each player, for each position.
+    std::array<std::vector<double>, 2> bottom_progress;
+
+    /// @brief The turn count, for each position.
+    std::vector<int> turn_count;
+
+    void push_back(const State& state);
+    void clear();
+    void resize(size_t size);
+
+    /// @brief Gets the number of positions in the batch.
+    size_t size() const { return turn_count.size(); }
+};
+
+/**
+ * @class Evaluator2p evaluation.hpp "src/evaluation.hpp"
+ * @brief Implements the evaluation function for 2-player games.
+ * @details The evaluation is a weighted sum of three terms, each clamped between -1 and 1 and taken with respect to
+ * player 0: the score difference, the difference in frequency counts left (a measure of how many likely dice sums
+ * each player can still use), and the difference in lock progress. With the default parameters, the weights of the
+ * terms change linearly from turn 7 to turn 22, shifting from the frequency count and lock progress terms to the score
+ * difference term, since the score matters more towards the end of the game. Fitted parameters (see Parameters) have
+ * their own weights for each turn, and a logistic link: the weighted sum is the log-odds that player 0 wins, and the
+ * evaluation is 2p - 1, where p is that probability. The evaluation at turn 0 is always 0.
+ * The features of each player are kept up to date by its Scorepad (see row_terms_table), and the weights are looked
+ * up in tables indexed by the turn count. This leaves a short sequence of arithmetic operations per position without
+ * branches, which the compiler can vectorize across a batch.
+ * If an endgame table is configured (see EndgameTable::configured()), the evaluation of a single position covered by the
+ * table is the exact expected result instead. Batches are always evaluated with the weighted sum, so that the statistics
+ * computed from evaluation histories do not depend on whether a table is present.
+ */
+class Evaluator2p {
+public:
+    /// @brief Turn from which the default weights start to change.
+    static constexpr int RAMP_START = 7;
+
+    /// @brief Last turn with its own weights. Later turns use the weights of this turn.
+    static constexpr int RAMP_END = 22;
+
+    /**
+     * @struct Parameters
+     * @brief The parameters of the evaluation function.
+     * @details The defaults are the hand-tuned values the evaluation function has always used. Fitted values (see
+     * EvaluationFitter and run_fit_evaluation()) are read and written as text files with one "name value..." line
+     * per member.
+     */
+    struct Parameters {
+        std::array<double, RAMP_END + 1> score_diff_weight;         //< Score difference weight, indexed by the turn count (capped at RAMP_END).
+        std::array<double, RAMP_END + 1> freq_count_diff_weight;    //< Frequency count difference weight, indexed by the turn count (capped at RAMP_END).
+        std::array<double, RAMP_END + 1> lock_progress_diff_weight; //< Lock progress difference weight, indexed by the turn count (capped at RAMP_END).
+        double score_diff_scale_factor = 20.0;          //< Score difference scale factor.
+        double freq_count_diff_scale_factor = 36.0;     //< Frequency count difference scale factor.
+        double lock_progress_diff_scale_factor = 2.75;  //< Lock progress difference scale factor.
+        double lock_progress_diff_bias = 2.5;           //< Lock progress difference bias.
+        bool logistic = false;                          //< Whether the weighted sum is the log-odds that player 0 wins, rather than the evaluation itself.
+
+        Parameters();
+
+        static Parameters load(const std::string& path);
+        void save(const std::string& path) const;
+        static const Parameters& configured();
+    };
+
+    Evaluator2p();
+    explicit Evaluator2p(const Parameters& parameters);
+
+    void evaluate(const Positions2p& positions, std::span<double> evaluations) const;
+    double evaluate(const State& state) const;
+
+protected:
+    std::array<double, RAMP_END + 1> m_score_diff_weight;           //< Score difference weight, indexed by the turn count (capped at RAMP_END).
+    std::array<double, RAMP_END + 1> m_freq_count_diff_weight;      //< Frequency count difference weight, indexed by the turn count (capped at RAMP_END).
+    std::array<double, RAMP_END + 1> m_lock_progress_diff_weight;   //< Lock progress difference weight, indexed by the turn count (capped at RAMP_END).
+
+    double m_score_diff_scale_factor;           //< Score difference scale factor.
+    double m_freq_count_diff_scale_factor;      //< Frequency count difference scale factor.
+    double m_lock_progress_diff_scale_factor;   //< Lock progress difference scale factor.
+    double m_lock_progress_diff_bias;           //< Lock progress difference bias.
+    bool m_logistic;                            //< See Parameters::logistic.
+    const EndgameTable* m_endgame_table;        //< Table of exact endgame values, or nullptr if none is configured.
+
+    double weighted_sum(const std::array<int, 2>& score, const std::array<int, 2>& freq_count_left,
+                        const std::array<double, 2>& top_progress, const std::array<double, 2>& bottom_progress, int turn_count) const;
+};
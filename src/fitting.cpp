@@ -0,0 +1,256 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <exception>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <tuple>
+
+#include "fitting.hpp"
+#include "game.hpp"
+#include "trial.hpp"
+
+/// @brief Agents whose games are used for the fit.
+static constexpr std::array<int, 3> FIT_AGENT_IDS = {12, 21, 22};
+
+/**
+ * @brief Gets pointers to the fitted values of a Parameters object, in the order of the gradient.
+ * @param parameters A reference to the Parameters object.
+ * @return A vector of pointers to the weights of the score difference, frequency count difference, and lock progress
+ * difference terms for each turn, then to the three scale factors and the bias.
+ */
+static std::vector<double*> fitted_values(Evaluator2p::Parameters& parameters) {
+    std::vector<double*> values;
+    for (auto* weights : {&parameters.score_diff_weight, &parameters.freq_count_diff_weight, &parameters.lock_progress_diff_weight}) {
+        for (double& weight : *weights) {
+            values.push_back(&weight);
+        }
+    }
+    for (double* value : {&parameters.score_diff_scale_factor, &parameters.freq_count_diff_scale_factor,
+                          &parameters.lock_progress_diff_scale_factor, &parameters.lock_progress_diff_bias}) {
+        values.push_back(value);
+    }
+    return values;
+}
+
+/**
+ * @brief Appends the positions of a batch, starting from a given one, to another batch.
+ * @param positions A reference to the batch to append to.
+ * @param other A read-only reference to the batch to append from.
+ * @param first A size_t representing the index in other of the first position to append.
+ */
+static void append_positions(Positions2p& positions, const Positions2p& other, size_t first) {
+    const auto from = static_cast<std::ptrdiff_t>(first);
+    for (size_t i = 0; i < 2; ++i) {
+        positions.score[i].insert(positions.score[i].end(), other.score[i].begin() + from, other.score[i].end());
+        positions.freq_count_left[i].insert(positions.freq_count_left[i].end(), other.freq_count_left[i].begin() + from, other.freq_count_left[i].end());
+        positions.top_progress[i].insert(positions.top_progress[i].end(), other.top_progress[i].begin() + from, other.top_progress[i].end());
+        positions.bottom_progress[i].insert(positions.bottom_progress[i].end(), other.bottom_progress[i].begin() + from, other.bottom_progress[i].end());
+    }
+    positions.turn_count.insert(positions.turn_count.end(), other.turn_count.begin() + from, other.turn_count.end());
+}
+
+/**
+ * @brief Computes the log-odds given by the parameters for a position, and adds the gradient of the log loss.
+ * @details The log-odds is the weighted sum of Evaluator2p::weighted_sum(), term for term. The derivative of each clamp
+ * is taken as 0 where it is active and 1 elsewhere.
+ * @param parameters A read-only reference to the parameters.
+ * @param positions A read-only reference to a batch of positions.
+ * @param k A size_t representing the index of the position in the batch. Its turn count must be positive.
+ * @param result A double representing the result of the game for player 0.
+ * @param gradient A span of doubles, in the order of fitted_values(), to which the gradient of the log loss is added.
+ * @return A double representing the log-odds that player 0 wins.
+ */
+static double add_gradient(const Evaluator2p::Parameters& parameters, const Positions2p& positions, size_t k, double result,
+                           std::span<double> gradient) {
+    const size_t turn = static_cast<size_t>(std::min(positions.turn_count[k], Evaluator2p::RAMP_END));
+    const size_t num_turns = Evaluator2p::RAMP_END + 1;
+
+    // Lambda to clamp a ratio between -1 and 1, returning the clamped value and whether the clamp is inactive
+    auto clamp = [](double value) { return std::tuple(std::max(-1.0, std::min(1.0, value)), std::abs(value) < 1.0 ? 1.0 : 0.0); };
+
+    const double score_scale = parameters.score_diff_scale_factor;
+    const double score_ratio = static_cast<double>(positions.score[0][k] - positions.score[1][k]) / score_scale;
+    const auto [score_term, score_slope] = clamp(score_ratio);
+
+    const double freq_count_scale = parameters.freq_count_diff_scale_factor;
+    const double freq_count_ratio = static_cast<double>(positions.freq_count_left[0][k] - positions.freq_count_left[1][k]) / freq_count_scale;
+    const auto [freq_count_term, freq_count_slope] = clamp(freq_count_ratio);
+
+    const double lock_scale = parameters.lock_progress_diff_scale_factor;
+    std::array<double, 2> lock_ratio;
+    std::array<double, 2> lock_progress;
+    std::array<double, 2> lock_slope;
+    for (size_t i = 0; i < 2; ++i) {
+        lock_ratio[i] = (positions.top_progress[i][k] + positions.bottom_progress[i][k] - parameters.lock_progress_diff_bias) / lock_scale;
+        std::tie(lock_progress[i], lock_slope[i]) = clamp(lock_ratio[i]);
+    }
+    const auto [lock_term, lock_diff_slope] = clamp(lock_progress[0] - lock_progress[1]);
+
+    const double score_weight = parameters.score_diff_weight[turn];
+    const double freq_count_weight = parameters.freq_count_diff_weight[turn];
+    const double lock_weight = parameters.lock_progress_diff_weight[turn];
+    const double log_odds = score_weight * score_term + freq_count_weight * freq_count_term + lock_weight * lock_term;
+
+    // The derivative of the log loss with respect to the log-odds is the predicted probability minus the result
+    const double error = 1.0 / (1.0 + std::exp(-log_odds)) - result;
+    gradient[turn] += error * score_term;
+    gradient[num_turns + turn] += error * freq_count_term;
+    gradient[2 * num_turns + turn] += error * lock_term;
+    gradient[3 * num_turns] += error * score_weight * score_slope * (-score_ratio / score_scale);
+    gradient[3 * num_turns + 1] += error * freq_count_weight * freq_count_slope * (-freq_count_ratio / freq_count_scale);
+    const double lock_error = error * lock_weight * lock_diff_slope;
+    gradient[3 * num_turns + 2] += lock_error * (lock_slope[0] * (-lock_ratio[0] / lock_scale) - lock_slope[1] * (-lock_ratio[1] / lock_scale));
+    gradient[3 * num_turns + 3] += lock_error * (lock_slope[0] * (-1.0 / lock_scale) - lock_slope[1] * (-1.0 / lock_scale));
+
+    return log_odds;
+}
+
+/**
+ * @brief Constructor starting a fit from the default parameters, with the logistic link.
+ * @param seed A 64-bit integer representing the seed of the games and of the order of the positions.
+ */
+EvaluationFitter::EvaluationFitter(std::uint64_t seed)
+    : m_seed(seed),
+      m_num_games(0),
+      m_num_positions(0),
+      m_num_steps(0),
+      m_parameters(),
+      m_first_moments{},
+      m_second_moments{},
+      m_shuffle_rng(seed, DRIVER_STREAM) {
+    m_parameters.logistic = true;
+}
+
+/**
+ * @brief Runs one round of the fit: simulates GAMES_PER_ROUND games, and takes one pass of gradient steps over their positions.
+ * @details The games of a round are split into NUM_SHARDS groups of consecutive games, which the workers of the pool
+ * claim one at a time. Positions at turn 0, whose evaluation is always 0, are left out.
+ * @param pool A reference to the WorkerPool running the games.
+ * @return The Round holding the statistics of the round.
+ */
+EvaluationFitter::Round EvaluationFitter::run_round(WorkerPool& pool) {
+    const int games_per_shard = GAMES_PER_ROUND / NUM_SHARDS;
+    const size_t num_agents = FIT_AGENT_IDS.size();
+    const unsigned int num_threads = std::max(1u, std::min(pool.size(), static_cast<unsigned int>(NUM_SHARDS)));
+    std::vector<std::exception_ptr> worker_errors(num_threads, nullptr);
+    std::atomic<int> next_shard = 0;
+
+    auto worker = [&](unsigned int worker_index) {
+        try {
+            // One Game object for each ordered pair of agents
+            std::vector<std::vector<std::tuple<std::unique_ptr<Agent>, std::string>>> players;
+            std::vector<Game> games;
+            for (size_t a = 0; a < num_agents; ++a) {
+                for (size_t b = 0; b < num_agents; ++b) {
+                    players.push_back(get_players({1, 1, FIT_AGENT_IDS[a], FIT_AGENT_IDS[b]}));
+                    games.push_back(Game({std::get<0>(players.back()[0]).get(), std::get<0>(players.back()[1]).get()}, false, true));
+                }
+            }
+
+            GameData stats;
+            for (int shard = next_shard.fetch_add(1); shard < NUM_SHARDS; shard = next_shard.fetch_add(1)) {
+                Positions2p& positions = m_shard_positions[shard];
+                std::vector<double>& results = m_shard_results[shard];
+                positions.clear();
+                results.clear();
+
+                for (int i = 0; i < games_per_shard; ++i) {
+                    const long long g = m_num_games + shard * games_per_shard + i;
+                    Game& game = games[static_cast<size_t>(g % static_cast<long long>(games.size()))];
+                    seed_rng(m_seed, static_cast<std::uint64_t>(g));
+                    game.reset();
+                    game.run(stats);
+
+                    const bool won = std::find(stats.winners.begin(), stats.winners.end(), 0) != stats.winners.end();
+                    const double result = won ? 1.0 / static_cast<double>(stats.winners.size()) : 0.0;
+                    append_positions(positions, game.get_positions(), 1);
+                    results.resize(positions.size(), result);
+                }
+            }
+        }
+        catch (...) {
+            worker_errors[worker_index] = std::current_exception();
+        }
+    };
+
+    pool.run(num_threads, worker);
+
+    for (const auto& error : worker_errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    // Put the shards together in order, and evaluate the positions with the default parameters for comparison
+    m_positions.clear();
+    m_results.clear();
+    for (int shard = 0; shard < NUM_SHARDS; ++shard) {
+        append_positions(m_positions, m_shard_positions[shard], 0);
+        m_results.insert(m_results.end(), m_shard_results[shard].begin(), m_shard_results[shard].end());
+    }
+    m_default_evaluations.resize(m_positions.size());
+    Evaluator2p(Evaluator2p::Parameters{}).evaluate(m_positions, m_default_evaluations);
+
+    std::vector<size_t> order(m_positions.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::shuffle(order.begin(), order.end(), m_shuffle_rng);
+
+    Round round{static_cast<long long>(order.size()), 0.0, 0.0, 0.0};
+    for (size_t begin = 0; begin < order.size(); begin += BATCH_SIZE) {
+        step(std::span<const size_t>(order).subspan(begin, std::min(BATCH_SIZE, order.size() - begin)), round);
+    }
+
+    const double n = static_cast<double>(std::max(1ll, round.num_positions));
+    round.log_loss /= n;
+    round.brier_score /= n;
+    round.default_brier_score /= n;
+
+    m_num_games += GAMES_PER_ROUND;
+    m_num_positions += round.num_positions;
+    return round;
+}
+
+/**
+ * @brief Takes one Adam step on the mean log loss of a batch of positions of the current round.
+ * @details Adds the losses of the positions, computed before the step, to the statistics of the round. Scale factors
+ * are kept at MIN_SCALE_FACTOR or above.
+ * @param batch A span of indices of positions of the current round.
+ * @param round A reference to the Round receiving the sums of the losses.
+ */
+void EvaluationFitter::step(std::span<const size_t> batch, Round& round) {
+    const double beta_1 = 0.9;
+    const double beta_2 = 0.999;
+    const double epsilon = 1e-8;
+
+    std::array<double, NUM_PARAMETERS> gradient{};
+    for (size_t k : batch) {
+        const double result = m_results[k];
+        const double log_odds = add_gradient(m_parameters, m_positions, k, result, gradient);
+
+        // log(p) = -softplus(-z) and log(1 - p) = -softplus(z), computed without overflow
+        auto softplus = [](double x) { return std::max(x, 0.0) + std::log1p(std::exp(-std::abs(x))); };
+        const double probability = 1.0 / (1.0 + std::exp(-log_odds));
+        const double default_probability = 0.5 * (1.0 + m_default_evaluations[k]);
+        round.log_loss += result * softplus(-log_odds) + (1.0 - result) * softplus(log_odds);
+        round.brier_score += (probability - result) * (probability - result);
+        round.default_brier_score += (default_probability - result) * (default_probability - result);
+    }
+
+    ++m_num_steps;
+    const double steps = static_cast<double>(m_num_steps);
+    const double first_correction = 1.0 - std::pow(beta_1, steps);
+    const double second_correction = 1.0 - std::pow(beta_2, steps);
+    const std::vector<double*> values = fitted_values(m_parameters);
+    for (size_t j = 0; j < NUM_PARAMETERS; ++j) {
+        const double g = gradient[j] / static_cast<double>(batch.size());
+        m_first_moments[j] = beta_1 * m_first_moments[j] + (1.0 - beta_1) * g;
+        m_second_moments[j] = beta_2 * m_second_moments[j] + (1.0 - beta_2) * g * g;
+        *values[j] -= LEARNING_RATE * (m_first_moments[j] / first_correction) / (std::sqrt(m_second_moments[j] / second_correction) + epsilon);
+    }
+
+    for (double* scale_factor : {&m_parameters.score_diff_scale_factor, &m_parameters.freq_count_diff_scale_factor, &m_parameters.lock_progress_diff_scale_factor}) {
+        *scale_factor = std::max(MIN_SCALE_FACTOR, *scale_factor);
+    }
+}
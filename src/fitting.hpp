@@ -0,0 +1,88 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "evaluation.hpp"
+#include "pool.hpp"
+#include "rng.hpp"
+
+/**
+ * @class EvaluationFitter fitting.hpp "src/fitting.hpp"
+ * @brief Fits the parameters of the 2-player evaluation function to the results of simulated games.
+ * @details The fitted model is the evaluation function with the logistic link (see Evaluator2p::Parameters): the
+ * weighted sum of the terms of a position, with its own weights for each turn, is taken as the log-odds that player 0
+ * wins the game. All weights, scale factors, and the bias are fitted together by streaming logistic regression: each
+ * round simulates GAMES_PER_ROUND games, labels the position at the start of every turn with the result of its game
+ * for player 0 (1 for a win, 1/2 for a tie, 0 for a loss), and takes one pass of minibatch gradient steps (with Adam)
+ * over these positions in a random order, after which they are discarded. The fit starts from the default parameters,
+ * so memory use does not depend on the number of positions.
+ *
+ * The games are played on the worker pool between the agents Greedy2SkipImproved, RushLocks, and Computational, with
+ * every ordered pair of them taking turns. Game g of the fit uses stream g of the seed, and the positions are put
+ * together in the order of the games, so the fit does not depend on the number of threads.
+ */
+class EvaluationFitter {
+public:
+    /**
+     * @struct Round
+     * @brief Statistics of one round of the fit.
+     * @details Each position is scored with the parameters in use just before the step that includes it, so these are
+     * out-of-sample estimates, as in progressive validation.
+     */
+    struct Round {
+        long long num_positions;        //< Number of labelled positions used in the round.
+        double log_loss;                //< Mean log loss of the fitted model.
+        double brier_score;             //< Mean squared error of the win probability given by the fitted model.
+        double default_brier_score;     //< Mean squared error of the win probability (1 + e) / 2 given by the default evaluation e.
+    };
+
+    /// @brief Number of games simulated in each round.
+    static constexpr int GAMES_PER_ROUND = 8192;
+
+    explicit EvaluationFitter(std::uint64_t seed);
+
+    Round run_round(WorkerPool& pool);
+
+    /// @brief Gets the current parameters of the fit.
+    const Evaluator2p::Parameters& parameters() const { return m_parameters; }
+
+    /// @brief Gets the number of labelled positions used so far.
+    long long num_positions() const { return m_num_positions; }
+
+protected:
+    /// @brief Number of fitted values: a weight for each term and turn, the three scale factors, and the bias.
+    static constexpr size_t NUM_PARAMETERS = 3 * (Evaluator2p::RAMP_END + 1) + 4;
+
+    /// @brief Number of groups of consecutive games of a round, each simulated by one worker at a time.
+    static constexpr int NUM_SHARDS = 64;
+
+    /// @brief Number of positions per gradient step.
+    static constexpr size_t BATCH_SIZE = 256;
+
+    /// @brief Step size of Adam.
+    static constexpr double LEARNING_RATE = 0.005;
+
+    /// @brief Smallest value of a scale factor, which keeps the terms defined.
+    static constexpr double MIN_SCALE_FACTOR = 0.25;
+
+    std::uint64_t m_seed;                                   //< Seed of the games of the fit.
+    long long m_num_games;                                  //< Number of games simulated so far.
+    long long m_num_positions;                              //< Number of labelled positions used so far.
+    long long m_num_steps;                                  //< Number of gradient steps taken so far.
+    Evaluator2p::Parameters m_parameters;                   //< Current parameters.
+    std::array<double, NUM_PARAMETERS> m_first_moments;     //< Moving average of the gradient of each fitted value.
+    std::array<double, NUM_PARAMETERS> m_second_moments;    //< Moving average of the squared gradient of each fitted value.
+    Philox m_shuffle_rng;                                   //< Generator of the order in which the positions of each round are used.
+
+    // Positions of the current round, kept between rounds to reuse their memory
+    std::array<Positions2p, NUM_SHARDS> m_shard_positions;              //< Positions of each shard.
+    std::array<std::vector<double>, NUM_SHARDS> m_shard_results;        //< Result for player 0 of the game of each position of each shard.
+    Positions2p m_positions;                                            //< Positions of all shards, in order.
+    std::vector<double> m_results;                                      //< Result for player 0 of the game of each position.
+    std::vector<double> m_default_evaluations;                          //< Default evaluation of each position.
+
+    void step(std::span<const size_t> batch, Round& round);
+};
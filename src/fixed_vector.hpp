@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+/**
+ * @class FixedVector fixed_vector.hpp "src/fixed_vector.hpp"
+ * @brief A vector-like container with a fixed capacity and inline storage.
+ * @details Stores up to Capacity elements in a std::array, together with the current number of elements.
+ * Unlike std::vector, it never allocates memory on the heap, so objects holding a FixedVector can be
+ * created, copied, and reset without any allocations. Only the operations needed in this project are
+ * provided. Elements beyond the current size are kept in a default-constructed or stale state, and are
+ * not destroyed when the size shrinks, so T should be a cheap, trivially copyable type.
+ * @attention No bounds-checking is performed. The caller must ensure that the capacity is not exceeded.
+ */
+template <typename T, size_t Capacity>
+class FixedVector {
+public:
+    /// @brief Default constructor, creates an empty FixedVector.
+    constexpr FixedVector() : m_data{}, m_size(0) {};
+
+    /**
+     * @brief Constructor creating a FixedVector with the given number of copies of a value.
+     * @param count A size_t representing the number of elements. Must not exceed Capacity.
+     * @param value A read-only reference to the value to copy into each element.
+     */
+    constexpr FixedVector(size_t count, const T& value) : m_data{}, m_size(count) {
+        for (size_t i = 0; i < count; ++i) {
+            m_data[i] = value;
+        }
+    }
+
+    constexpr T& operator[](size_t index) { return m_data[index]; }
+    constexpr const T& operator[](size_t index) const { return m_data[index]; }
+
+    constexpr T* data() { return m_data.data(); }
+    constexpr const T* data() const { return m_data.data(); }
+
+    constexpr T* begin() { return m_data.data(); }
+    constexpr const T* begin() const { return m_data.data(); }
+    constexpr T* end() { return m_data.data() + m_size; }
+    constexpr const T* end() const { return m_data.data() + m_size; }
+
+    constexpr size_t size() const { return m_size; }
+    constexpr bool empty() const { return m_size == 0; }
+    static constexpr size_t capacity() { return Capacity; }
+
+    /// @brief Removes all elements.
+    constexpr void clear() { m_size = 0; }
+
+    /**
+     * @brief Appends an element.
+     * @param value A read-only reference to the value to append.
+     */
+    constexpr void push_back(const T& value) { m_data[m_size++] = value; }
+
+    /**
+     * @brief Removes the element at the given index, shifting the following elements to the left.
+     * @param index A size_t representing the index of the element to remove.
+     */
+    constexpr void erase(size_t index) {
+        for (size_t i = index + 1; i < m_size; ++i) {
+            m_data[i - 1] = m_data[i];
+        }
+        --m_size;
+    }
+
+protected:
+    std::array<T, Capacity> m_data;     //< Storage for the elements.
+    size_t m_size;                      //< The number of elements currently stored.
+};
@@ -1,7 +1,9 @@
 #pragma once
 
 #include <array>
+#include <bit>
 #include <bitset>
+#include <cstdint>
 #include <functional>
 #include <iostream>
 #include <limits>
@@ -10,10 +12,15 @@
 #include <numeric>
 #include <optional>
 #include <span>
+#include <utility>
 #include <vector>
 
 #include "agent.hpp"
+#include "evaluation.hpp"
+#include "fixed_vector.hpp"
 #include "globals.hpp"
+#include "rng.hpp"
+#include "zobrist.hpp"
 
 /**
  * @enum ActionType game.hpp "src/game.hpp"
@@ -76,37 +83,133 @@ struct MoveContext {
  * The final space (12 for red and yellow, 2 for green and blue) is the lock space. It can only be marked
  * if at least five other spaces to the left of this space have been marked. The final component of the
  * scorepad is the penalty counter. This starts at 0 for each player, and increases by 1 each time a player
- * must mark a penalty.
+ * must mark a penalty. Each row is stored as a bitmask in which bit j is set if the space at index j has been marked.
+ * Since marks can only be placed to the right of all other marks in a row, the rightmost mark is the
+ * highest set bit, and the number of marks is the number of set bits (plus one for the lock, which counts
+ * as two marks). The scorepad also keeps running totals of the features used for scoring and by the evaluation
+ * function (see row_terms_table): the score, the frequency counts left in the rows that are still in the game, and
+ * the lock progress of each of these rows. They are updated by mark_move(), mark_penalty(), and close_row(), so
+ * reading them takes constant time. The same goes for the scorepad's Zobrist hash (see zobrist_keys), which covers the
+ * marks and the penalty count. A complete scorepad is stored inline and takes up 64 bytes.
  */
 class Scorepad {
 public:
-    Scorepad();
-    void mark_move(const Move& move);
+    /**
+     * @brief Default constructor.
+     * @details Initializes a blank scorepad, with no spaces marked, no penalties, and all rows in the game.
+     */
+    Scorepad() : Scorepad({}, 0) {};
+
+    /**
+     * @brief Constructor creating a scorepad with the given marks, penalties, and closed rows.
+     * @details Computes the running totals and the hash from scratch.
+     * @param rows A read-only reference to an array holding the bitmask of marked spaces of each row, in the order of the Color enum.
+     * @param penalties An int representing the number of penalties.
+     * @param closed_rows A bitmask of the rows that have been locked (bit j for the row of color j). Defaults to none.
+     */
+    Scorepad(const std::array<std::uint16_t, GameConstants::NUM_ROWS>& rows, int penalties, unsigned int closed_rows = 0)
+        : m_rows(rows),
+          m_penalties(penalties),
+          m_score(-GameConstants::PENALTY_VALUE * penalties),
+          m_freq_count_left(0),
+          m_closed_rows(0),
+          m_lock_progress{},
+          m_hash(zobrist_keys.penalties[penalties]) {
+
+        for (size_t j = 0; j < GameConstants::NUM_ROWS; ++j) {
+            m_score += row_terms_table.score[m_rows[j]];
+            m_freq_count_left += row_terms_table.freq_count_left[m_rows[j]];
+            m_lock_progress[j] = row_lock_progress(j, m_rows[j]);
+            for (size_t k = 0; k < GameConstants::NUM_CELLS_PER_ROW; ++k) {
+                if ((m_rows[j] >> k) & 1) {
+                    m_hash ^= zobrist_keys.marks[j][k];
+                }
+            }
+        }
+        for (size_t j = 0; j < GameConstants::NUM_ROWS; ++j) {
+            if ((closed_rows >> j) & 1) {
+                close_row(static_cast<Color>(j));
+            }
+        }
+    };
+
+    /**
+     * @brief Function used to mark a move on the scorepad.
+     * @details Sets the bit for the move's index in the row of the move's color, updates the running totals
+     * by the difference between the terms of the row before and after the mark, and adds the space's key to the hash.
+     * @attention This function does not check the move passed in to ensure that it
+     * is legal and valid. The caller must instead ensure this. In particular, rows that
+     * have been closed with close_row() can no longer be marked.
+     */
+    void mark_move(const Move& move) {
+        const size_t color_index = static_cast<size_t>(move.color);
+        const std::uint16_t old_row = m_rows[color_index];
+        const std::uint16_t new_row = static_cast<std::uint16_t>(old_row | (1u << move.index));
+        m_rows[color_index] = new_row;
+
+        m_score += row_terms_table.score[new_row] - row_terms_table.score[old_row];
+        m_freq_count_left += row_terms_table.freq_count_left[new_row] - row_terms_table.freq_count_left[old_row];
+        m_lock_progress[color_index] = row_lock_progress(color_index, new_row);
+        m_hash ^= zobrist_keys.marks[color_index][move.index];
+    }
 
     /**
      * @brief Increments the internal penalty counter.
+     * @details Replaces the key of the old penalty count in the hash with the key of the new one.
+     * @attention The game ends with the last penalty, so this must not be called once the maximum has been reached.
      * @return A bool which is true if the penalty counter has reached the
      * maximum number of penalties needed for the game to end, or false otherwise.
      */
     bool mark_penalty() {
+        m_score -= GameConstants::PENALTY_VALUE;
+        m_hash ^= zobrist_keys.penalties[m_penalties] ^ zobrist_keys.penalties[m_penalties + 1];
         return (++m_penalties >= GameConstants::MAX_PENALTIES);
     };
 
+    /**
+     * @brief Takes the given row out of the game, after its lock has been marked by any player.
+     * @details The row's frequency counts left are removed from the running total, and its lock progress is set to 0.
+     * Closing a row that is already closed has no effect.
+     */
+    void close_row(Color color) {
+        const size_t color_index = static_cast<size_t>(color);
+        if ((m_closed_rows >> color_index) & 1) {
+            return;
+        }
+        m_closed_rows = static_cast<std::uint8_t>(m_closed_rows | (1u << color_index));
+        m_freq_count_left -= row_terms_table.freq_count_left[m_rows[color_index]];
+        m_lock_progress[color_index] = 0.0;
+    }
+
     /**
      * @brief Gets the index of the rightmost space that has been marked in the given row.
      * @return A size_t option that equals the null option if no spaces have been marked
      * in this row, or otherwise the index of the rightmost space that has been marked.
      */
     std::optional<size_t> get_rightmost_mark_index(Color color) const {
-        return m_rightmost_mark_indices[static_cast<size_t>(color)];
+        const std::uint16_t row = m_rows[static_cast<size_t>(color)];
+        if (row == 0) {
+            return std::nullopt;
+        }
+        return static_cast<size_t>(std::bit_width(row)) - 1;
     }
 
     /**
      * @brief Gets the number of marks in the given row.
      * @return An int corresponding to the number of marks that have been placed in the row.
+     * A marked lock counts as two marks.
      */
     int get_num_marks(Color color) const {
-        return m_num_marks[static_cast<size_t>(color)];
+        const std::uint16_t row = m_rows[static_cast<size_t>(color)];
+        return std::popcount(row) + ((row >> GameConstants::LOCK_INDEX) & 1);
+    }
+
+    /**
+     * @brief Gets the bitmask of marked spaces in the given row.
+     * @return A uint16_t in which bit j is set if the space at index j has been marked.
+     */
+    std::uint16_t get_row_mask(Color color) const {
+        return m_rows[static_cast<size_t>(color)];
     }
 
     /**
@@ -117,20 +220,86 @@ public:
         return m_penalties;
     }
 
-    friend std::ostream& operator<< (std::ostream& stream, const Scorepad& scorepad);
+    /**
+     * @brief Gets the current score.
+     * @return An int equal to the sum from 1 to the number of marks of each row, minus the penalty value for each penalty.
+     */
+    int get_score() const {
+        return m_score;
+    }
 
-protected:
-    /// @brief 2D array of cells. Each cell stores a bool indicating whether it has been marked.
-    std::array<std::array<bool, GameConstants::NUM_CELLS_PER_ROW>, GameConstants::NUM_ROWS> m_rows;
+    /**
+     * @brief Gets the frequency counts left in the rows that are still in the game.
+     * @return An int equal to the sum of row_terms_table.freq_count_left over the rows that have not been closed.
+     */
+    int get_freq_count_left() const {
+        return m_freq_count_left;
+    }
+
+    /**
+     * @brief Gets the lock progress of the given row.
+     * @return A double holding the row's entry of row_terms_table (the blue row uses its own measure), or 0 if the row has been closed.
+     */
+    double get_lock_progress(Color color) const {
+        return m_lock_progress[static_cast<size_t>(color)];
+    }
+
+    /**
+     * @brief Gets the best lock progress in the top section of the scorepad (red and yellow rows).
+     * @return A double holding the larger lock progress of the two rows.
+     */
+    double get_top_progress() const {
+        return std::max(m_lock_progress[static_cast<size_t>(Color::red)], m_lock_progress[static_cast<size_t>(Color::yellow)]);
+    }
 
-    /// @brief Array storing a size_t option for each row indicating the index of the rightmost space that has been marked.
-    std::array<std::optional<size_t>, GameConstants::NUM_ROWS> m_rightmost_mark_indices;
+    /**
+     * @brief Gets the best lock progress in the bottom section of the scorepad (green and blue rows).
+     * @return A double holding the larger lock progress of the two rows.
+     */
+    double get_bottom_progress() const {
+        return std::max(m_lock_progress[static_cast<size_t>(Color::green)], m_lock_progress[static_cast<size_t>(Color::blue)]);
+    }
 
-    /// @brief Array storing an int for each row indicating the number of marks that have been placed in that row.
-    std::array<int, GameConstants::NUM_ROWS> m_num_marks;
+    /**
+     * @brief Gets the Zobrist hash of the scorepad.
+     * @return A 64-bit integer equal to the XOR of the keys of the marked spaces and of the penalty count. Closed rows are
+     * not part of it, since they are the same for every scorepad of a game (see State::key()).
+     */
+    std::uint64_t get_hash() const {
+        return m_hash;
+    }
+
+    friend std::ostream& operator<< (std::ostream& stream, const Scorepad& scorepad);
+
+protected:
+    /// @brief Array storing a bitmask for each row. Bit j is set if the space at index j has been marked.
+    std::array<std::uint16_t, GameConstants::NUM_ROWS> m_rows;
 
     /// @brief The number of penalties that have been marked so far.
     int m_penalties;
+
+    /// @brief The current score, including penalties.
+    int m_score;
+
+    /// @brief The frequency counts left, summed over the rows that have not been closed.
+    int m_freq_count_left;
+
+    /// @brief Bitmask of the rows that have been closed (bit j for the row of color j).
+    std::uint8_t m_closed_rows;
+
+    /// @brief The lock progress of each row, or 0 for rows that have been closed.
+    std::array<double, GameConstants::NUM_ROWS> m_lock_progress;
+
+    /// @brief The Zobrist hash of the marks and the penalty count.
+    std::uint64_t m_hash;
+
+    /**
+     * @brief Looks up the lock progress of a row with the given marks.
+     * @return A double holding the row's entry of row_terms_table, which uses a different measure for the blue row.
+     */
+    static double row_lock_progress(size_t color_index, std::uint16_t row) {
+        return color_index == static_cast<size_t>(Color::blue) ? row_terms_table.blue_lock_progress[row] : row_terms_table.lock_progress[row];
+    }
 };
 
 /**
@@ -139,11 +308,12 @@ protected:
  * @details The complete state is characterized by the set of scorepads
  * and the currently active player. In order to make accessing certain 
  * information easier, other data members also exist. See the description
- * of each data member below.
+ * of each data member below. All members are stored inline, so a State can be
+ * created and copied without allocating memory.
  */
 struct State {
-    /// @brief Vector containing one scorepad for each player in the game.
-    std::vector<Scorepad> scorepads;
+    /// @brief Container holding one scorepad for each player in the game.
+    FixedVector<Scorepad, GameConstants::MAX_PLAYERS> scorepads;
 
     /// @brief Bitset indicating which rows have been locked. Cleared after each action.
     std::bitset<GameConstants::NUM_ROWS> locks;
@@ -163,18 +333,60 @@ struct State {
     /// @brief bool indicating whether we are in a terminal state.
     bool is_terminal;
 
-    /// @brief Default comstructor.
+    /// @brief Zobrist hash of the current player and the locked rows. Kept up to date by set_curr_player() and lock_row().
+    std::uint64_t hash;
+
+    /// @brief Default constructor.
     /// @param num_players A size_t representing the number of players in this game.
     /// @param starting_player A size_t representing the starting player.
-    State(size_t num_players, size_t starting_player) :
+    State(size_t num_players = 0, size_t starting_player = 0) :
         scorepads(num_players, Scorepad()),
         locks(false),
         locked_rows{false, false, false, false},
         curr_player(starting_player),
         turn_count(0),
         num_locks(0),
-        is_terminal(false)
+        is_terminal(false),
+        hash(zobrist_keys.curr_player[starting_player])
         {};
+
+    /**
+     * @brief Makes the given player the current player, updating the hash.
+     * @param player A size_t representing the new current player.
+     */
+    void set_curr_player(size_t player) {
+        hash ^= zobrist_keys.curr_player[curr_player] ^ zobrist_keys.curr_player[player];
+        curr_player = player;
+    }
+
+    /**
+     * @brief Marks the given row as locked, updating the hash.
+     * @details Only records the lock: closing the row on each scorepad and counting the lock is left to the caller.
+     * Locking a row that is already locked has no effect.
+     * @param row A size_t representing the index of the row, in the order of the Color enum.
+     */
+    void lock_row(size_t row) {
+        if (!locked_rows[row]) {
+            locked_rows[row] = true;
+            hash ^= zobrist_keys.locked_rows[row];
+        }
+    }
+
+    /**
+     * @brief Computes the Zobrist hash of the position.
+     * @details Combines the hash of the current player and the locked rows with the hash of each scorepad. The hash of
+     * scorepad i is rotated left by 11 * i bits, which gives each player its own set of keys, so positions that only
+     * differ in which player has which scorepad get different hashes. The turn count and the number of locks (which
+     * follows from the locked rows) are not part of the hash. Takes one rotation and XOR per player.
+     * @return A 64-bit integer representing the hash.
+     */
+    std::uint64_t key() const {
+        std::uint64_t result = hash;
+        for (size_t i = 0; i < scorepads.size(); ++i) {
+            result ^= std::rotl(scorepads[i].get_hash(), static_cast<int>(11 * i));
+        }
+        return result;
+    }
 };
 
 /**
@@ -182,12 +394,15 @@ struct State {
  * @brief Holds data about the game that may be useful for collecting statistics.
  * @details Keeps track of which player(s) won, what the final score was, what the
  * final state was, the evaluation history with respect to player 0 (only valid for
- * 2-player games), and the number of turns.
+ * 2-player games), and the number of turns. A GameData object is owned by the
+ * caller of Game::run() and can be reused for any number of games. Except for the
+ * evaluation history, whose capacity is kept between games, all members are stored
+ * inline, so reusing a GameData object does not allocate memory.
  */
 struct GameData {
-    std::vector<size_t> winners;
-    std::vector<int> final_score;
-    std::unique_ptr<State> final_state;
+    FixedVector<size_t, GameConstants::MAX_PLAYERS> winners;
+    FixedVector<int, GameConstants::MAX_PLAYERS> final_score;
+    State final_state;
     std::vector<double> p0_evaluation_history;
     int num_turns;
 };
@@ -200,25 +415,40 @@ struct GameData {
  * object being constructed for each player in the game. The Game object
  * can then be run using the run() method, which will process the game
  * turn by turn until a terminal state is reached, at which point the
- * game will end and a pointer to a GameData object will be returned to
- * the caller.
+ * game will end and its results will be written to a GameData object
+ * owned by the caller. A Game object can be reused for another game
+ * between the same agents by calling reset() before the next call to run().
+ * Neither reset() nor run() allocates memory, except to grow the evaluation
+ * history of a GameData object that has not yet been used for a game as long.
  */
 class Game {
 public:
     Game(std::vector<Agent*> players, bool human_active, bool use_evaluation);
-    std::unique_ptr<GameData> run();
-    std::vector<int> compute_score() const;
-    double evaluate_2p();
+    void reset();
+    void set_agent_substreams(std::span<const std::uint64_t> substreams);
+    void run(GameData& data);
+    FixedVector<int, GameConstants::MAX_PLAYERS> compute_score() const;
+    double evaluate_2p() const;
+
+    /// @brief Gets the position at the start of each turn of the last game run. Only recorded with the evaluation function.
+    const Positions2p& get_positions() const { return m_positions; }
 
 protected:
     /// @brief A size_t representing the number of players for this Qwixx game.
     size_t m_num_players;
 
-    /// @brief A unique_ptr to the game state.
-    std::unique_ptr<State> m_state;
+    /// @brief The game state.
+    State m_state;
+
+    /// @brief A container of pointers to the agents for this Qwixx game, tagged with their concrete types.
+    FixedVector<AgentRef, GameConstants::MAX_PLAYERS> m_players;
 
-    /// @brief A vector of pointers to the agents for this Qwixx game.
-    std::vector<Agent*> m_players;
+    /// @brief The sub-stream of the game's stream that the agent of each seat draws from, or empty if all agents
+    /// draw from the game's stream itself (see set_agent_substreams()).
+    FixedVector<std::uint64_t, GameConstants::MAX_PLAYERS> m_agent_substreams;
+
+    /// @brief The generator of the agent of each seat, positioned by reset(). Only used with m_agent_substreams.
+    std::array<Philox, GameConstants::MAX_PLAYERS> m_agent_rngs;
 
     /// @brief A bool indicating whether a human player is active in this game.
     bool m_human_active;
@@ -226,25 +456,35 @@ protected:
     /// @brief A bool indicating whether the evaluation function should be used.
     bool m_use_evaluation;
 
-    /// @brief An array of ints representing the relative frequency for rolling the number in each space.
-    /// @details This variable is used by the evaluation function.
-    //                                                         2  3  4  5  6  7  8  9  10 11 12 (or reverse)
-    static constexpr std::array<int, 11> m_frequency_counts = {1, 2, 3, 4, 5, 6, 5, 4, 3, 2, 1};
-
-    /// @brief An int representing the maximum number of frequency counts left in a row at the start of the game.
-    /// @details This variable is used by the evaluation function.
-    static constexpr int m_max_frequency_count_left = GameConstants::NUM_ROWS * std::accumulate(m_frequency_counts.begin(), m_frequency_counts.end(), 0);
-    
-    double m_score_diff_weight;                 //< Score difference weight. Used by the evaluation function.
-    double m_freq_count_diff_weight;            //< Frequency count difference weight. Used by the evaluation function.
-    double m_lock_progress_diff_weight;         //< Lock progress difference weight. Used by the evaluation function.
-
-    double m_score_diff_scale_factor;           //< Score difference scale factor. Used by the evaluation function. 
-    double m_freq_count_diff_scale_factor;      //< Frequency count difference scale factor. Used by the evaluation function.
-    double m_lock_progress_diff_scale_factor;   //< Lock progress difference scale factor. Used by the evaluation function.
-    double m_lock_progress_diff_bias;           //< Lock progress difference bias. Used by the evaluation function.
-
-    template <ActionType A, typename F>
+    /// @brief The number of turns of dice rolls generated at a time.
+    static constexpr size_t m_roll_buffer_turns = 32;
+
+    /// @brief Buffer of dice rolls for the upcoming turns, NUM_DICE rolls per turn. The first two rolls of
+    /// each turn are for the white dice, followed by one roll per color in the order of the Color enum.
+    std::array<int, m_roll_buffer_turns * GameConstants::NUM_DICE> m_roll_buffer;
+
+    /// @brief A size_t representing the index in m_roll_buffer of the first roll of the next turn.
+    size_t m_roll_index;
+
+    /// @brief The number of dice of this game's dice sequence that have been written to m_roll_buffer so far.
+    std::uint64_t m_num_dice_drawn;
+
+    /// @brief The evaluation function.
+    Evaluator2p m_evaluator;
+
+    /// @brief The positions of the current game, evaluated in one batch when the game ends. Only used with the evaluation function.
+    Positions2p m_positions;
+
+    template <size_t N>
+    void run_impl(GameData& data);
+
+    std::optional<size_t> ask_agent(size_t player, bool first_action, std::span<const Move> current_action_legal_moves,
+                                    std::span<const Move> action_two_possible_moves);
+
+    template <size_t N>
+    FixedVector<int, GameConstants::MAX_PLAYERS> compute_score_impl() const;
+
+    template <ActionType A, size_t N, typename F>
     bool resolve_action(MoveContext& ctxt, F lock_added);
 };
 
@@ -278,11 +518,74 @@ constexpr size_t value_to_index(Color color, int value) {
     }
 };
 
-void roll_dice(std::span<int> rolls);
+/**
+ * @brief Lookup table mapping the bitmask of marked spaces in an unlocked row to the bitmask of spaces that can legally be marked.
+ * @details A space can be marked if it lies to the right of every marked space in the row, and, if it is the
+ * lock space, if at least MIN_MARKS_FOR_LOCK spaces have already been marked. Rows whose lock has been marked
+ * have no legal moves. The table has one 16-bit entry per possible row bitmask (4 KB in total), so the legal
+ * moves of a row are found with a single load. Generated at compile time.
+ */
+inline constexpr std::array<std::uint16_t, (1u << GameConstants::NUM_CELLS_PER_ROW)> legal_mask_table = [] {
+    std::array<std::uint16_t, (1u << GameConstants::NUM_CELLS_PER_ROW)> table{};
+    for (unsigned int row = 0; row < table.size(); ++row) {
+        if ((row >> GameConstants::LOCK_INDEX) & 1) {
+            continue;
+        }
+        const unsigned int first_legal_index = static_cast<unsigned int>(std::bit_width(row));
+        unsigned int mask = ((1u << GameConstants::NUM_CELLS_PER_ROW) - 1) & ~((1u << first_legal_index) - 1);
+        if (std::popcount(row) < GameConstants::MIN_MARKS_FOR_LOCK) {
+            mask &= ~(1u << GameConstants::LOCK_INDEX);
+        }
+        table[row] = static_cast<std::uint16_t>(mask);
+    }
+    return table;
+}();
+
+/**
+ * @brief Lookup table mapping a color and the sum of two dice to the index of the space with that value.
+ * @details Indexed as sum_to_index_table[color][sum] for sums between 2 and 12. Equivalent to value_to_index(),
+ * but without branching on the color. Generated at compile time.
+ */
+inline constexpr std::array<std::array<std::uint8_t, 13>, GameConstants::NUM_ROWS> sum_to_index_table = [] {
+    std::array<std::array<std::uint8_t, 13>, GameConstants::NUM_ROWS> table{};
+    for (size_t color = 0; color < GameConstants::NUM_ROWS; ++color) {
+        for (int sum = 2; sum <= 12; ++sum) {
+            table[color][sum] = static_cast<std::uint8_t>(value_to_index(static_cast<Color>(color), sum));
+        }
+    }
+    return table;
+}();
+
+void roll_dice(std::span<int> rolls, std::uint64_t first_die);
+
+template <ActionType A>
+std::array<std::uint16_t, GameConstants::NUM_ROWS> generate_legal_move_masks(const std::span<Color>& dice, const std::span<int>& rolls, const Scorepad& scorepad);
 
 template <ActionType A>
 size_t generate_legal_moves(std::span<Move>& legal_moves, const std::span<Color>& dice, const std::span<int>& rolls, const Scorepad& scorepad);
 
+/**
+ * @brief Asks the agent of a seat for its move.
+ * @details If the agents draw from sub-streams (see Game::set_agent_substreams()), the agent's generator is swapped
+ * into the calling thread's generator for the duration of the call, so the agent's random draws come from its own
+ * sub-stream. Otherwise, the agent draws from the game's stream.
+ * @attention Defined in the header file so that it can be inlined into resolve_action().
+ * @param player A size_t representing the seat of the agent.
+ * @return A size_t option which is expected to equal an index into current_action_legal_moves or the null option.
+ */
+inline std::optional<size_t> Game::ask_agent(size_t player, bool first_action, std::span<const Move> current_action_legal_moves,
+                                             std::span<const Move> action_two_possible_moves) {
+    if (m_agent_substreams.empty()) {
+        return call_make_move(m_players[player], first_action, current_action_legal_moves, action_two_possible_moves, m_state);
+    }
+
+    std::swap(rng(), m_agent_rngs[player]);
+    const std::optional<size_t> move_index_opt = call_make_move(m_players[player], first_action, current_action_legal_moves,
+                                                                action_two_possible_moves, m_state);
+    std::swap(rng(), m_agent_rngs[player]);
+    return move_index_opt;
+}
+
 /**
  * @brief Function to resolve the current game action.
  * @details This template function is instantiated for both action types (first and second).
@@ -291,13 +594,15 @@ size_t generate_legal_moves(std::span<Move>& legal_moves, const std::span<Color>
  * Mark each agent's scorepad as needed, including penalties. Then check if any new locks
  * have been marked. If so, invoke the corresponding callback function. Return whether the active
  * player made a move or not.
+ * The template parameter N is the number of players, so the loops over the players have a
+ * compile-time trip count.
  * @attention This template function needs to be defined in the header file so as to avoid
  * needing to instantiate a specific callable type.
  * @param ctxt A reference to the current MoveContext. The legal moves stored here need to be filled in by generate_legal_moves().
  * @param lock_added A callback that should be invoked if any locks were added during this action.
  * @return A bool indicating whether the active player made a move during this action.
  */
-template <ActionType A, typename F>
+template <ActionType A, size_t N, typename F>
 bool Game::resolve_action(MoveContext& ctxt, F lock_added) {
     bool active_player_made_move = false;
 
@@ -305,21 +610,21 @@ bool Game::resolve_action(MoveContext& ctxt, F lock_added) {
         // Generate the currently possible action two moves.
         // This allows an agent to make its action one move on the
         // basis of its possible action one and action two moves.
-        const int num_action_two_moves = generate_legal_moves<ActionType::Second>(ctxt.action_two_possible_moves, ctxt.dice, ctxt.rolls, m_state.get()->scorepads[m_state->curr_player]);
+        const int num_action_two_moves = generate_legal_moves<ActionType::Second>(ctxt.action_two_possible_moves, ctxt.dice, ctxt.rolls, m_state.scorepads[m_state.curr_player]);
         
         // Register first action moves
-        for (size_t i = 0; i < m_num_players; ++i) {            
-            const int num_action_one_moves = generate_legal_moves<ActionType::First>(ctxt.current_action_legal_moves, ctxt.dice, ctxt.rolls, m_state.get()->scorepads[i]);
+        for (size_t i = 0; i < N; ++i) {            
+            const int num_action_one_moves = generate_legal_moves<ActionType::First>(ctxt.current_action_legal_moves, ctxt.dice, ctxt.rolls, m_state.scorepads[i]);
 
             std::optional<size_t> move_index_opt = std::nullopt;
             if (num_action_one_moves > 0) {
-                move_index_opt = m_players[i]->make_move(true, ctxt.current_action_legal_moves.subspan(0, num_action_one_moves), 
-                                                         ctxt.action_two_possible_moves.subspan(0, num_action_two_moves), *m_state.get());
+                move_index_opt = ask_agent(i, true, ctxt.current_action_legal_moves.subspan(0, num_action_one_moves),
+                                           ctxt.action_two_possible_moves.subspan(0, num_action_two_moves));
             }
 
             if (move_index_opt.has_value()) {
                 ctxt.action_one_registered_moves[i] = ctxt.current_action_legal_moves[move_index_opt.value()];
-                if (i == m_state->curr_player) {
+                if (i == m_state.curr_player) {
                     active_player_made_move = true;
                 }
             }
@@ -332,12 +637,12 @@ bool Game::resolve_action(MoveContext& ctxt, F lock_added) {
         }
 
         // Make first action moves
-        for (size_t i = 0; i < m_num_players; ++i) {
+        for (size_t i = 0; i < N; ++i) {
             const std::optional<Move> move_opt = ctxt.action_one_registered_moves[i];
             if (move_opt.has_value()) {
-                m_state.get()->scorepads[i].mark_move(move_opt.value());
+                m_state.scorepads[i].mark_move(move_opt.value());
                 if (move_opt.value().index == GameConstants::LOCK_INDEX) {
-                    m_state->locks[static_cast<size_t>(move_opt.value().color)] = true;
+                    m_state.locks[static_cast<size_t>(move_opt.value().color)] = true;
                 }
             }
         }
@@ -345,25 +650,25 @@ bool Game::resolve_action(MoveContext& ctxt, F lock_added) {
     else if constexpr (A == ActionType::Second) {        
         // We do need to regenerate these moves, since some possible moves from before 
         // may no longer be possible after action one resolves
-        const int num_moves = generate_legal_moves<ActionType::Second>(ctxt.current_action_legal_moves, ctxt.dice, ctxt.rolls, m_state.get()->scorepads[m_state->curr_player]);
+        const int num_moves = generate_legal_moves<ActionType::Second>(ctxt.current_action_legal_moves, ctxt.dice, ctxt.rolls, m_state.scorepads[m_state.curr_player]);
 
         std::optional<size_t> move_index_opt = std::nullopt;
         if (num_moves > 0) {
-            move_index_opt = m_players[m_state->curr_player]->make_move(false, ctxt.current_action_legal_moves.subspan(0, num_moves),
-                                                                        ctxt.current_action_legal_moves.subspan(0, num_moves), *m_state.get());
+            move_index_opt = ask_agent(m_state.curr_player, false, ctxt.current_action_legal_moves.subspan(0, num_moves),
+                                       ctxt.current_action_legal_moves.subspan(0, num_moves));
         }
         if (move_index_opt.has_value()) {
-            m_state.get()->scorepads[m_state->curr_player].mark_move(ctxt.current_action_legal_moves[move_index_opt.value()]);
+            m_state.scorepads[m_state.curr_player].mark_move(ctxt.current_action_legal_moves[move_index_opt.value()]);
             
             if (ctxt.current_action_legal_moves[move_index_opt.value()].index == GameConstants::LOCK_INDEX) {
-                m_state->locks[static_cast<size_t>(ctxt.current_action_legal_moves[move_index_opt.value()].color)] = true;
+                m_state.locks[static_cast<size_t>(ctxt.current_action_legal_moves[move_index_opt.value()].color)] = true;
             }
             active_player_made_move = true;
         }
     }
 
     // Invoke callback if any new locks were marked
-    if (m_state->locks.any()) {
+    if (m_state.locks.any()) {
         lock_added();
     }
 
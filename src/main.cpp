@@ -1,19 +1,65 @@
+#include <algorithm>
+#include <array>
 #include <chrono>
 #include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
 #include <iostream>
+#include <limits>
+#include <numeric>
+#include <optional>
 #include <sstream>
+#include <thread>
 #include <tuple>
 
 #include "agent.hpp"
+#include "endgame.hpp"
+#include "fitting.hpp"
 #include "game.hpp"
+#include "pool.hpp"
 #include "rng.hpp"
+#include "solitaire.hpp"
+#include "tournament.hpp"
+#include "trial.hpp"
+#include "tuning.hpp"
 
-double compute_duration(std::vector<std::vector<double>>& evaluation_histories);
-double compute_lead_change(std::vector<std::vector<double>>& evaluation_histories);
-double compute_late_uncertainty(std::vector<std::vector<double>>& evaluation_histories);
 std::vector<int> get_inputs();
-std::vector<std::tuple<std::unique_ptr<Agent>, std::string>> get_players(const std::vector<int>& inputs);
-bool is_human_active(const std::vector<int>& inputs, int human_id);
+bool parse_inputs(const std::string& line, std::vector<int>& inputs, std::string& error);
+
+/**
+ * @struct Options
+ * @brief Holds the values of the command line options.
+ */
+struct Options {
+    unsigned int num_threads;   //< Number of worker threads used to run the simulations.
+    Engine engine;              //< Engine used to run the simulations.
+    std::uint64_t seed;         //< Seed of the trial's random number generators.
+    bool seed_given;            //< Whether the seed was given with --seed, rather than drawn at random.
+    std::string jobs_file;      //< Path of the job file to run non-interactively ("-" for stdin), or empty for the interactive mode.
+    int table_size;             //< Number of players at each table of a tournament, or 0 if no tournament is run.
+    int games_per_table;        //< Number of games played at each table of a tournament, or per opponent in a tuning run.
+    bool games_given;           //< Whether the number of games was given with --games, rather than left at its default.
+    SequentialTest test;        //< Sequential test used to stop 2-player trials early, if enabled.
+    bool rotate_seats;          //< Whether each simulation is played in every seating of the agents, with the same dice.
+    std::string solitaire_file; //< Path of the solitaire value table to write, or empty if it is not solved.
+    std::string endgame_file;   //< Path of the endgame table to write, or empty if it is not solved.
+    std::string tuning_file;    //< Path of the checkpoint of a tuning run of the Computational agent, or empty if no tuning is run.
+    int num_generations;        //< Number of generations of a tuning run, including those of the checkpoint it resumes from.
+    std::string evaluation_file;    //< Path of the fitted evaluation parameters to write, or empty if the evaluation function is not fitted.
+    long long num_positions;        //< Minimum number of labelled positions used to fit the evaluation function.
+};
+
+bool parse_options(int argc, char* argv[], Options& options);
+int run_jobs(const Options& options);
+int run_tournament_mode(const Options& options);
+int run_solve_solitaire(const Options& options);
+int run_solve_endgame(const Options& options);
+int run_tune_computational(const Options& options);
+int run_fit_evaluation(const Options& options);
+void print_json_number(double value);
+void print_paired_stats(const PairedStats& paired, const std::vector<std::tuple<std::unique_ptr<Agent>, std::string>>& players);
 
 /**
  * @brief Program entry point.
@@ -21,90 +67,183 @@ bool is_human_active(const std::vector<int>& inputs, int human_id);
  * evaluation function should be used, and which agents to use. Each simulation is then run and data are
  * collected for the complete trial, including the minimum, maximum, and average number of moves, the
  * average duration, lead change, and uncertainty (late), and a random evaluation history from the trial.
- * These data are printed to stdout, and then the program terminates.
+ * These data are printed to stdout, and then the program terminates. The simulations are spread over several
+ * worker threads; the number of threads can be set with the command line option --threads N, and defaults to
+ * the number of hardware threads. The trial can be repeated exactly, with any number of threads, by passing
+ * the same --seed S; without this option, a non-deterministic seed is used. By default, games between greedy agents
+ * are run in lockstep batches (see BatchGame); --engine scalar runs every game on its own instead, with the same results.
+ * With --jobs FILE, the inputs are read from a job file instead of the prompt, and the program runs non-interactively (see run_jobs()).
+ * With --confidence C, 2-player trials stop as soon as a sequential test declares an agent stronger or finds no
+ * significant difference, each with error probability at most 1 - C (see SequentialTest), and the number of
+ * simulations becomes the maximum number of games.
+ * With --rotate-seats, each simulation is played once in every seating of the agents, with the same dice, and paired
+ * statistics of the agents are printed (see run_rotated_trial()).
+ * With --tournament N, a round-robin tournament between agents 0 through 22 is run instead (see run_tournament_mode()).
+ * With --solve-solitaire FILE, the solitaire value table used by the Solitaire agent is computed and written instead
+ * (see run_solve_solitaire()). With --solve-endgame FILE, the 2-player endgame table is computed and written instead
+ * (see run_solve_endgame()). With --tune FILE, the parameters of the Computational agent are tuned instead (see
+ * run_tune_computational()), and with --fit-evaluation FILE, the parameters of the evaluation function are fitted
+ * instead (see run_fit_evaluation()).
+ * @param argc An int representing the number of command line arguments.
+ * @param argv An array of C strings holding the command line arguments.
  * @return An integer representing the exit status.
  */
-int main() {
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        const std::string program = argv[0];
+        std::cerr << "Usage: " << program << " [--threads N] [--seed S] [--engine batch|scalar] [--confidence C [--margin D] | --rotate-seats] [--jobs FILE]\n"
+                  << "       " << program << " [--threads N] [--seed S] [--engine batch|scalar] --tournament N [--games G]\n"
+                  << "       " << program << " [--threads N] --solve-solitaire FILE\n"
+                  << "       " << program << " [--threads N] --solve-endgame FILE\n"
+                  << "       " << program << " [--threads N] [--seed S] --tune FILE [--generations N] [--games G]\n"
+                  << "       " << program << " [--threads N] [--seed S] --fit-evaluation FILE [--positions N]\n";
+        return 1;
+    }
+
+    if (!options.jobs_file.empty()) {
+        return run_jobs(options);
+    }
+
+    if (options.table_size != 0) {
+        return run_tournament_mode(options);
+    }
+
+    if (!options.solitaire_file.empty()) {
+        return run_solve_solitaire(options);
+    }
+
+    if (!options.endgame_file.empty()) {
+        return run_solve_endgame(options);
+    }
+
+    if (!options.tuning_file.empty()) {
+        return run_tune_computational(options);
+    }
+
+    if (!options.evaluation_file.empty()) {
+        return run_fit_evaluation(options);
+    }
+
+    seed_rng(options.seed, DRIVER_STREAM);
+
     const std::vector<int> inputs = get_inputs();
 
     const int num_simulations = inputs[0];
     const int use_evaluation = inputs[1];
     
     const std::vector<std::tuple<std::unique_ptr<Agent>, std::string>> players = get_players(inputs);
-    const bool human_active = is_human_active(inputs, 23);
 
-    // Start timer after collecting inputs
-    auto start = std::chrono::high_resolution_clock::now();
+    // The sequential test compares two agents, and the games of a human player cannot be replayed to print a history
+    SequentialTest test = options.test;
+    if (test.enabled() && (players.size() != 2 || is_human_active(inputs, 23))) {
+        std::cout << "The sequential test requires exactly 2 players, neither of them human. It will be disabled for this trial.\n";
+        test.confidence = 0.0;
+    }
 
-    // Extract the pointers to the agents from the players vector, as these are
-    // expected by the Game class
-    std::vector<Agent*> player_ptrs;
-    for (const auto& player : players) {
-        player_ptrs.push_back(std::get<0>(player).get());
+    // A human player cannot be reseated and play the same dice again
+    const bool rotate_seats = options.rotate_seats && !is_human_active(inputs, 23);
+    if (options.rotate_seats && !rotate_seats) {
+        std::cout << "Seat rotation cannot be used with a human player. It will be disabled for this trial.\n";
     }
 
-    // Containers for statistics
-    std::vector<double> num_wins_accum(players.size());
-    std::vector<int> score_accum(players.size());
-    int num_turns_accum = 0;
-    int min_turns = std::numeric_limits<int>::max();
-    int max_turns = std::numeric_limits<int>::min();
+    // Start timer after collecting inputs
+    auto start = std::chrono::high_resolution_clock::now();
 
-    // Container for evaluation histories, used by compute_duration(), compute_lead_change(), and compute_late_uncertainty().
-    // It would be ideal to rewrite those functions so that the relevant statistic can be computed for each simulation and then
-    // taking the average at the end, so that we don't have to hold all these vectors in memory.
-    std::vector<std::vector<double>> evaluation_histories(num_simulations);
+    // Determine the randomly-chosen simulation number whose evaluation history we will output at the end.
+    // With the sequential test, the number of simulations is only known at the end, so only a fraction of it is drawn
+    // now (the simulations may reseed the random number generator of this thread).
+    int random_sim = -1;
+    double random_fraction = 0.0;
+    if (!test.enabled()) {
+        std::uniform_int_distribution<int> dist(0, num_simulations - 1);
+        random_sim = dist(rng());
+    }
+    else {
+        std::uniform_real_distribution<double> dist(0.0, 1.0);
+        random_fraction = dist(rng());
+    }
 
-    // Determine the randomly-chosen simulation number whose evaluation history we will output at the end
-    std::uniform_int_distribution<int> dist(0, num_simulations - 1);
-    int random_sim = dist(rng());
+    // Run all simulations. Each worker thread constructs its own agents and accumulates its own statistics,
+    // including the quality criteria, which are merged once all simulations have completed. Only the evaluation
+    // history of the randomly-chosen simulation is kept.
+    // With seat rotation, each simulation is a deal played in every seating, and the statistics of each agent are
+    // paired over the deals.
     std::vector<double> saved_history;
-
-    // Main program loop
-    for (int i = 0; i < num_simulations; ++i) {
-        // Construct and run a new game
-        Game game = Game(player_ptrs, human_active, (static_cast<bool>(use_evaluation) && players.size() == 2));
-        std::unique_ptr<GameData> stats = game.run();
-
-        // If we are at the randomly-chosen simulation number, save this game history
-        if (i == random_sim && static_cast<bool>(use_evaluation)) {
-            saved_history = stats.get()->p0_evaluation_history;
+    WorkerPool pool(options.num_threads);
+    PairedStats paired(players.size(), 1);
+    const TrialData data = rotate_seats
+        ? run_rotated_trial(inputs, num_simulations, (static_cast<bool>(use_evaluation) && players.size() == 2), pool, options.seed, paired)
+        : run_trial(inputs, num_simulations, (static_cast<bool>(use_evaluation) && players.size() == 2),
+                    pool, options.engine, options.seed, test, random_sim, saved_history);
+    const std::vector<long long>& score_accum = data.score_accum;
+    const long long num_games = data.num_games;
+    const long long num_turns_accum = data.num_turns_accum;
+    const int min_turns = data.min_turns;
+    const int max_turns = data.max_turns;
+
+    if (test.enabled()) {
+        // Print the outcome of the test
+        const SequentialTest::Outcome decision = test.decision(data);
+        const double error = 1.0 - test.confidence;
+        std::cout << "Sequential test stopped after " << num_games << " of at most " << num_simulations << " simulations: ";
+        if (decision == SequentialTest::PLAYER_0_STRONGER || decision == SequentialTest::PLAYER_1_STRONGER) {
+            const size_t stronger = (decision == SequentialTest::PLAYER_0_STRONGER) ? 0 : 1;
+            std::cout << "Player " << stronger << " (" << std::get<1>(players[stronger]) << ") is stronger"
+                      << " (equally strong players are declared different with probability at most " << error << ')';
         }
-
-        // Add wins and scores for each player to the relevant accumulators
-        for (size_t j = 0; j < players.size(); ++j) {
-            if (std::find(stats.get()->winners.begin(), stats.get()->winners.end(), j) != stats.get()->winners.end()) {
-                num_wins_accum[j] += 1.0 / static_cast<double>(stats.get()->winners.size());
-            }
-
-            score_accum[j] += stats.get()->final_score[j];
+        else if (decision == SequentialTest::NO_DIFFERENCE) {
+            std::cout << "no significant difference (a player winning at least " << 0.5 + test.margin
+                      << " of the games is missed with probability at most " << error << ')';
+        }
+        else {
+            std::cout << "no decision";
+        }
+        const std::array<double, 2> ratios = test.log_likelihood_ratios(data);
+        std::cout << "\nLog-likelihood ratios " << ratios[0] << " (player 0 stronger) and " << ratios[1] << " (player 1 stronger), bounds "
+                  << test.lower_threshold() << " and " << test.upper_threshold() << '\n';
+
+        // Replay the randomly-chosen simulation to get its evaluation history
+        if (static_cast<bool>(use_evaluation)) {
+            random_sim = std::min(static_cast<int>(random_fraction * static_cast<double>(num_games)), static_cast<int>(num_games) - 1);
+            GameData stats;
+            replay_game(inputs, true, options.seed, random_sim, {}, stats);
+            saved_history = stats.p0_evaluation_history;
         }
-
-        // Move this game's evaluation history into the vector of all evaluation histories
-        evaluation_histories[i] = std::move(stats.get()->p0_evaluation_history);
-
-        // Update the accumulator for the number of turns, as well as the minimum and maximum numbers of turns, if applicable
-        num_turns_accum += stats.get()->num_turns;
-        min_turns = std::min(min_turns, stats.get()->num_turns);
-        max_turns = std::max(max_turns, stats.get()->num_turns);
     }
 
-    // Print win rates and average scores for each player
-    for (size_t i = 0; i < players.size(); ++i) {
-        std::cout << "Player " << i << " (" << std::get<1>(players[i]) << ") win rate: " << num_wins_accum[i] / static_cast<double>(num_simulations) << '\n';
-        std::cout << "Player " << i << " (" << std::get<1>(players[i]) << ") average score: " << static_cast<double>(score_accum[i]) / static_cast<double>(num_simulations) << '\n';
+    if (rotate_seats) {
+        std::cout << "Seat rotation: " << paired.num_deals << " deals of " << paired.games_per_deal << " seatings each, "
+                  << num_games << " games in total\n";
+        print_paired_stats(paired, players);
+
+        // The saved history is that of the deal's game in the original seating, replayed on its own
+        if (static_cast<bool>(use_evaluation)) {
+            std::vector<size_t> seating(players.size());
+            std::iota(seating.begin(), seating.end(), size_t(0));
+            GameData stats;
+            replay_game(inputs, true, options.seed, random_sim, seating, stats);
+            saved_history = stats.p0_evaluation_history;
+        }
+    }
+    else {
+        // Print win rates and average scores for each player
+        for (size_t i = 0; i < players.size(); ++i) {
+            std::cout << "Player " << i << " (" << std::get<1>(players[i]) << ") win rate: " << data.get_num_wins(i) / static_cast<double>(num_games) << '\n';
+            std::cout << "Player " << i << " (" << std::get<1>(players[i]) << ") average score: " << static_cast<double>(score_accum[i]) / static_cast<double>(num_games) << '\n';
+        }
     }
 
     // Print average, max, and min number of turns
-    std::cout << "Average number of turns: " << static_cast<double>(num_turns_accum) / static_cast<double>(num_simulations) << '\n';
+    std::cout << "Average number of turns: " << static_cast<double>(num_turns_accum) / static_cast<double>(num_games) << '\n';
     std::cout << "Maximum number of turns: " << max_turns << '\n';
     std::cout << "Minimum number of turns: " << min_turns << '\n';
 
     if (static_cast<bool>(use_evaluation)) {
         // Compute duration, lead change, and uncertainty (late) statistics
-        const double duration_stat = compute_duration(evaluation_histories);
-        const double lead_change_stat = compute_lead_change(evaluation_histories);
-        const double late_uncertainty_stat = compute_late_uncertainty(evaluation_histories);
+        const double duration_stat = data.quality.duration();
+        const double lead_change_stat = data.quality.lead_change();
+        const double late_uncertainty_stat = data.quality.late_uncertainty();
 
         // Print the statistics
         std::cout << "Duration statistic: " << duration_stat << '\n';
@@ -118,6 +257,11 @@ int main() {
         }
     }
 
+    // Print the search speed of the Monte Carlo tree search agents, if any played
+    if (const std::optional<double> rollouts_per_second = Mcts::rollouts_per_core_second()) {
+        std::cout << "MCTS rollouts per second per core: " << rollouts_per_second.value() << '\n';
+    }
+
     // Stop timer and print execution time
     auto end = std::chrono::high_resolution_clock::now();
     std::chrono::duration<double> duration = end - start;
@@ -126,120 +270,11 @@ int main() {
     return 0;
 }
 
-/**
- * @brief Function to compute the duration quality criterion.
- * @details Calculates the average duration, measured as the deviation in the number of moves (M_g)
- * from the preferred number of moves (M_pref). M_pref is assumed to be equal to the average number
- * of moves over all games in the trial for simplicity.
- * @param evaluation_histories A vector of vectors of doubles containing evaluations with respect to player 0 for all games.
- * @return A double in the interval [0, 1] representing the average duration. 0 indicates no deviation from
- * the preferred number of turns, while 1 indicates maximum deviation from the preferred number of turns. The maximum is
- * reached for games with 0 or 2M_g moves.
- */
-double compute_duration(std::vector<std::vector<double>>& evaluation_histories) {
-    const double G = static_cast<double>(evaluation_histories.size());
-    
-    // Get the total number of moves across all games
-    double acc = 0.0;
-    for (auto history : evaluation_histories) {
-        const double M_g = history.size() - 1;
-        acc += M_g;
-    }
-
-    // Set M_pref to the average number of moves
-    const double M_pref = acc / G;
-
-    // Sum up duration values for all games
-    acc = 0.0;
-    for (auto history : evaluation_histories) {
-        const double M_g = history.size() - 1;
-        acc += std::abs(M_pref - M_g) / M_pref;
-    }
-
-    // Return the average, or 1 if this value is greater than 1
-    return std::min(1.0, acc / G);
-}
-
-/**
- * @brief Function to compute the lead change quality criterion.
- * @details Calculates the average lead change, measured as the number of times the evaluation
- * (taken with respect to player 0) changes sign.
- * @param evaluation_histories A vector of vectors of doubles containing evaluations with respect to player 0 for all games.
- * @return A double in the interval [0, 1] representing the average lead change. 0 indicates no lead changes, while 1 indicates
- * a lead change on every turn.
- */
-double compute_lead_change(std::vector<std::vector<double>>& evaluation_histories) {
-    const double G = static_cast<double>(evaluation_histories.size());
-    
-    // Calculate the total number of lead changes across all games
-    double acc = 0.0;
-    for (auto history : evaluation_histories) {
-        int num_lead_changes = 0;
-
-        // Start from the second move, since there will always be a new leader after the first move
-        for (auto it = history.begin() + 2; it != history.end(); ++it) {
-            num_lead_changes += (std::signbit(*it) != std::signbit(*(it-1))) ? 1 : 0;
-        }
-        const double M_g = history.size() - 1; 
-        acc += static_cast<double>(num_lead_changes) / (M_g - 1);
-    }
-    
-    // Return the average
-    return acc / G;
-}
-
-/**
- * @brief Function to compute the uncertainty (late) quality criterion.
- * @details Calculates the late uncertainty, measured as an approximation of the area between the curve of the absolute value of
- * the evaluations and the curve (line) extending from (0, 0) to (M_g - 1, 1). Intuitively, this captures the size of the lead
- * difference with respect to either player (since the evaluation is zero-sum, taking the absolute value gives us this lead
- * difference) over time. A game where one player has a large lead for most of the game would result in a large area below
- * the lead curve and above the line from (0, 0) to (M_g - 1, 1), corresponding to a negative uncertainty (i.e., high certainty),
- * while a game where no player has a lead lead for most of the game would result in a large area below the line from (0, 0) to
- * (M_g - 1, 1) and above the lead curve, corresponding to a positive uncertainty (i.e., high uncertainty). 0.5 is added to the
- * final result so that it falls between 0 and 1, like the other statistics. This version of the uncertainty formula weighs the
- * late game more heavily.
- * @param evaluation_histories A vector of vectors of doubles containing evaluations with respect to player 0 for all games.
- * @return A double in the interval [0, 1] representing the average late uncertainty. 0 indicates no uncertainty, as in a game
- * where the absolute difference in evaluation is 1 after every move, while 1 indicates maximum uncertainty, as in a game where 
- * the difference in evaluation is 0 after every move.
- */
-double compute_late_uncertainty(std::vector<std::vector<double>>& evaluation_histories) {
-    // Number of samples (rectangles) used to approximate the area
-    const int S = 100;
-    const double G = static_cast<double>(evaluation_histories.size());
-
-    // Calculate the sum of the samples across all games
-    double samples_acc = 0.0;
-    for (int s = 0; s < S; ++s) {
-        // t represents a time point in the game and falls in the interval [0, 1]
-        const double t = static_cast<double>(s) / static_cast<double>(S-1);
-
-        // Sum up the evaluation difference at each time point
-        double games_acc = 0.0;
-        for (auto history : evaluation_histories) {
-            const double M_g = static_cast<double>(history.size());     // no minus one here, as we want to include the final evaluation of 1.0 or -1.0
-            const double tM_g = t * M_g;    // corresponds to a fractional move
-            const int floor_index = static_cast<int>(tM_g);
-            const int ceil_index = floor_index + 1;
-            const double move_fraction = tM_g - static_cast<double>(floor_index);   // fractional part of the move
-            const double floor_eval = std::abs(history[floor_index]);
-            const double ceil_eval = std::abs(history[ceil_index]);
-            const double fractional_eval = floor_eval + (ceil_eval - floor_eval) * move_fraction;   // evaluation of the fractional move
-            games_acc += fractional_eval;
-        }
-        samples_acc += std::min(1.0, t - (games_acc / G));
-    }
-
-    // Return 0.5 plus the average to get result in the interval [0, 1]
-    return 0.5 + (samples_acc / S);
-}
-
 /**
  * @brief Gets inputs from the user needed to run the trial.
  * @details Gets the number of simulations to run, whether to use the evaluation function, and which agents to use.
  * The user is re-prompted for a new line of input if any errors are present in the original input.
- * @return A vector of ints containing the user inputs satisfying: inputs.size() in [4, 7], inputs[0] in [1, 100,000], inputs[2 .. inputs.size()-1] each in [0, 23]. 
+ * @return A vector of ints containing the user inputs satisfying: inputs.size() in [4, 7], inputs[0] in [1, 2,147,483,647], inputs[2 .. inputs.size()-1] each in [0, 34]. 
  */
 std::vector<int> get_inputs() {
     // Prompt the user
@@ -250,64 +285,25 @@ std::vector<int> get_inputs() {
               << "21: RushLocks\n"
               << "22: Computational\n"
               << "23: Human\n"
+              << "24: Solitaire (needs the value table written by --solve-solitaire)\n"
+              << "25-29: ExpectimaxN (1 <= N <= 5), searching up to 2000 * 5^(N-1) nodes per move\n"
+              << "30-34: MctsN (1 <= N <= 5), playing 250 * 4^(N-1) rollouts per move\n"
               << "\nPlease input the number of simulations, followed by a 1 if you would like to use the evaluation function (0 otherwise),\n\tfollowed by a sequence of 2 to 5 numbers corresponding to the above numbers for each agent.\n"
               << "Example: 10000 1 0 3 for 10000 simulations of Random vs. Greedy3Skip, where Random is evaluated.\n"
               << "Note that the evaluation function is only meaningful for 2 players, and will be disabled at higher player counts.\n\n";
     
     std::string line;
     std::vector<int> inputs;
-    const size_t min_inputs = 4;
-    const size_t max_inputs = 7;
-    const int max_simulations = 100'000;
-    const int agent_range_start = 0;
-    const int agent_range_end = 23;
-    
-    // We will break out of this loop if there are no errors with the input
+    std::string error;
+
+    // Re-prompt until a line without errors is entered
     while (true) {
         std::getline(std::cin, line);
-        std::istringstream iss(line);
-        inputs = {};
-        int next = 0;
-        while (!iss.eof()) {
-            iss >> next;
-
-            // Unspecified error -- probably a non-numeric value
-            if (iss.fail()) {
-                std::cout << "Error parsing input. All inputs should be numeric and not too large. Please retry.\n";
-                goto retry;
-            }
-
-            inputs.push_back(next);
-        }
-
-        if (inputs.size() < min_inputs) {
-            std::cout << "Too few inputs. Need at least 4: number of simulations, use of evaluation function, and at least two agents. Please retry.\n";
-            goto retry;
-        }
-
-        if (inputs.size() > max_inputs) {
-            std::cout << "Too many inputs. There can be at most 7: number of simulations, use of evaluation function, and at most five agents. Please retry.\n";
-            goto retry;
-        }
-        
-        if (inputs[0] < 1 || inputs[0] > max_simulations) {
-            std::cout << "Invalid number of simulations: should be a number between 1 and 100,000. Please retry.\n";
-            goto retry;
+        if (parse_inputs(line, inputs, error)) {
+            break;
         }
 
-        for (auto it = inputs.begin() + 2; it != inputs.end(); ++it) {
-            if (*it < agent_range_start || *it > agent_range_end) {
-                std::cout << "At least one agent number is invalid: valid agent numbers are " << agent_range_start << " through " << agent_range_end << ". Please retry.\n";
-                goto retry;
-            }
-        }
-        
-        // All checks passed -- break out of loop
-        break;
-
-        // Some error encountered -- restart loop
-        retry:
-            continue;
+        std::cout << error << " Please retry.\n";
     }
 
     // This is not classified as a user input error, so it is handled separately
@@ -321,53 +317,628 @@ std::vector<int> get_inputs() {
 }
 
 /**
- * @brief Gets the players of the game from the user inputs.
- * @details For each integer in the vector of inputs starting after the first two (which are for
- * the number of simulations and whether to use the evaluation function), create a tuple consisting
- * of a unique pointer to a newly-constructed agent corresponding to that integer, plus a string
- * representing the name of the agent.
- * @param inputs A read-only vector of ints containing the user inputs as collected by the get_inputs() function.
- * @return A vector of tuples of unique pointers to agents and strings representing the agent names.
+ * @brief Parses and checks one line of inputs, in the format described by get_inputs().
+ * @details The checks are shared by the interactive prompt and the job files read by run_jobs(). Disabling the
+ * evaluation function for more than 2 players is not an error, so it is left to the caller.
+ * @param line A read-only string holding the line to parse.
+ * @param inputs A reference to the vector receiving the inputs. Only meaningful if the line is valid.
+ * @param error A reference to a string receiving a description of the first error found, if any.
+ * @return A bool which is true if the line is valid, else false.
+ */
+bool parse_inputs(const std::string& line, std::vector<int>& inputs, std::string& error) {
+    const size_t min_inputs = 4;
+    const size_t max_inputs = 7;
+    // Memory use does not depend on the number of simulations (see TrialData), so any count that fits in an int is accepted
+    const int max_simulations = std::numeric_limits<int>::max();
+    const int agent_range_start = 0;
+    const int agent_range_end = 34;
+
+    std::istringstream iss(line);
+    inputs = {};
+    int next = 0;
+    while (!iss.eof()) {
+        iss >> next;
+
+        // Unspecified error -- probably a non-numeric value
+        if (iss.fail()) {
+            error = "Error parsing input. All inputs should be numeric and not too large.";
+            return false;
+        }
+
+        inputs.push_back(next);
+    }
+
+    if (inputs.size() < min_inputs) {
+        error = "Too few inputs. Need at least 4: number of simulations, use of evaluation function, and at least two agents.";
+        return false;
+    }
+
+    if (inputs.size() > max_inputs) {
+        error = "Too many inputs. There can be at most 7: number of simulations, use of evaluation function, and at most five agents.";
+        return false;
+    }
+
+    if (inputs[0] < 1 || inputs[0] > max_simulations) {
+        error = "Invalid number of simulations: should be a number between 1 and 2,147,483,647.";
+        return false;
+    }
+
+    for (auto it = inputs.begin() + 2; it != inputs.end(); ++it) {
+        if (*it < agent_range_start || *it > agent_range_end) {
+            error = "At least one agent number is invalid: valid agent numbers are " + std::to_string(agent_range_start)
+                    + " through " + std::to_string(agent_range_end) + ".";
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Parses the command line options.
+ * @details The accepted options are --threads N, where N is a positive integer, and --seed S, where S is a
+ * non-negative integer, --engine E, where E is batch or scalar, and --jobs FILE, where FILE is the path of a job file
+ * or - for stdin, --tournament N, where N is a table size between 2 and 5, and --games G, where G is a positive number
+ * of games per table. If --threads is absent, the number of hardware threads is used (or 1, if this number cannot be determined).
+ * If --seed is absent, a non-deterministic seed is used. If --engine is absent, the batch engine is used. If --jobs and
+ * --tournament are both absent, the inputs are read from the interactive prompt; they cannot both be present. If --games
+ * is absent, 1000 games are played at each table. --confidence C, where C is in (0.5, 1), enables the sequential test
+ * (see SequentialTest) with confidence C, and --margin D, where D is in (0, 0.5), sets its win rate margin, 0.05 by
+ * default. --rotate-seats, which takes no value, enables seat rotation. The sequential test and seat rotation cannot be
+ * combined with each other or with --tournament. --solve-solitaire FILE and --solve-endgame FILE, where FILE is the path
+ * of the table to write, cannot be combined with each other, --jobs, --tournament, the sequential test, or seat rotation.
+ * Neither can --tune FILE, where FILE is the path of the checkpoint of a tuning run, which also accepts --generations N,
+ * where N is a positive number of generations (100 by default), and --games G, the number of games per opponent, nor
+ * --fit-evaluation FILE, where FILE is the path of the parameters to write, which also accepts --positions N, where N
+ * is a positive number of labelled positions (5,000,000 by default). The options that only apply to one mode are
+ * rejected without it: --games requires --tournament or --tune, --generations requires --tune, --positions requires
+ * --fit-evaluation, and --margin requires --confidence.
+ * @param argc An int representing the number of command line arguments.
+ * @param argv An array of C strings holding the command line arguments.
+ * @param options A reference to the Options object to fill in.
+ * @return A bool which is true if all arguments were valid, else false.
  */
-std::vector<std::tuple<std::unique_ptr<Agent>, std::string>> get_players(const std::vector<int>& inputs) {
-    std::vector<std::tuple<std::unique_ptr<Agent>, std::string>> players;
-    for (auto it = inputs.begin() + 2; it != inputs.end(); ++it) {    
-        // It would be preferable to directly map these values to the desired constructor, but I
-        // don't know how to do that. This is fine for a small number of agents, though.
-        if (*it == 0) {
-            players.push_back(std::tuple(std::make_unique<Random>(), "Random"));
+bool parse_options(int argc, char* argv[], Options& options) {
+    options.num_threads = std::max(1u, std::thread::hardware_concurrency());
+    options.seed = random_seed();
+    options.seed_given = false;
+    options.engine = Engine::Batch;
+    options.jobs_file = "";
+    options.table_size = 0;
+    options.games_per_table = 1000;
+    options.games_given = false;
+    options.test.confidence = 0.0;
+    options.test.margin = 0.05;
+    options.rotate_seats = false;
+    options.solitaire_file = "";
+    options.endgame_file = "";
+    options.tuning_file = "";
+    options.num_generations = 100;
+    options.evaluation_file = "";
+    options.num_positions = 5'000'000;
+
+    // Whether the options that only apply to one mode were given
+    bool generations_given = false;
+    bool positions_given = false;
+    bool margin_given = false;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+
+        // Options without a value
+        if (arg == "--rotate-seats") {
+            options.rotate_seats = true;
+            continue;
         }
-        else if (*it >= 1 && *it <= 10) {
-            std::string name = "Greedy" + std::to_string(*it) + "Skip";
-            players.push_back(std::tuple(std::make_unique<Greedy>(*it), name));
+
+        if (i + 1 >= argc) {
+            return false;
         }
-        else if (*it >= 11 && *it <= 20) {
-            std::string name = "Greedy" + std::to_string((*it - 10)) + "SkipImproved";
-            players.push_back(std::tuple(std::make_unique<GreedyImproved>(*it - 10), name));
+
+        std::istringstream iss(argv[++i]);
+        if (arg == "--threads") {
+            int value = 0;
+            iss >> value;
+            if (iss.fail() || !iss.eof() || value < 1) {
+                return false;
+            }
+            options.num_threads = static_cast<unsigned int>(value);
         }
-        else if (*it == 21) {
-            players.push_back(std::tuple(std::make_unique<RushLocks>(), "RushLocks"));
+        else if (arg == "--seed") {
+            options.seed_given = true;
+            iss >> options.seed;
+            if (iss.fail() || !iss.eof() || argv[i][0] == '-') {
+                return false;
+            }
         }
-        else if (*it == 22) {
-            players.push_back(std::tuple(std::make_unique<Computational>(), "Computational"));
+        else if (arg == "--engine") {
+            if (iss.str() == "batch") {
+                options.engine = Engine::Batch;
+            }
+            else if (iss.str() == "scalar") {
+                options.engine = Engine::Scalar;
+            }
+            else {
+                return false;
+            }
         }
-        else if (*it == 23) {
-            players.push_back(std::tuple(std::make_unique<Human>(), "Human"));
+        else if (arg == "--jobs") {
+            options.jobs_file = iss.str();
+            if (options.jobs_file.empty()) {
+                return false;
+            }
+        }
+        else if (arg == "--solve-solitaire") {
+            options.solitaire_file = iss.str();
+            if (options.solitaire_file.empty()) {
+                return false;
+            }
+        }
+        else if (arg == "--solve-endgame") {
+            options.endgame_file = iss.str();
+            if (options.endgame_file.empty()) {
+                return false;
+            }
+        }
+        else if (arg == "--tune") {
+            options.tuning_file = iss.str();
+            if (options.tuning_file.empty()) {
+                return false;
+            }
+        }
+        else if (arg == "--generations") {
+            generations_given = true;
+            iss >> options.num_generations;
+            if (iss.fail() || !iss.eof() || options.num_generations < 1) {
+                return false;
+            }
+        }
+        else if (arg == "--fit-evaluation") {
+            options.evaluation_file = iss.str();
+            if (options.evaluation_file.empty()) {
+                return false;
+            }
+        }
+        else if (arg == "--positions") {
+            positions_given = true;
+            iss >> options.num_positions;
+            if (iss.fail() || !iss.eof() || options.num_positions < 1) {
+                return false;
+            }
+        }
+        else if (arg == "--tournament") {
+            iss >> options.table_size;
+            if (iss.fail() || !iss.eof() || options.table_size < 2 || options.table_size > 5) {
+                return false;
+            }
+        }
+        else if (arg == "--confidence") {
+            iss >> options.test.confidence;
+            if (iss.fail() || !iss.eof() || !(options.test.confidence > 0.5 && options.test.confidence < 1.0)) {
+                return false;
+            }
+        }
+        else if (arg == "--margin") {
+            margin_given = true;
+            iss >> options.test.margin;
+            if (iss.fail() || !iss.eof() || !(options.test.margin > 0.0 && options.test.margin < 0.5)) {
+                return false;
+            }
+        }
+        else if (arg == "--games") {
+            options.games_given = true;
+            iss >> options.games_per_table;
+            if (iss.fail() || !iss.eof() || options.games_per_table < 1) {
+                return false;
+            }
         }
         else {
-            players.push_back(std::tuple(std::make_unique<Random>(), "Random"));
+            return false;
+        }
+    }
+
+    return (options.jobs_file.empty() || options.table_size == 0)
+           && (options.solitaire_file.empty() || (options.jobs_file.empty() && options.table_size == 0 && !options.test.enabled() && !options.rotate_seats))
+           && (options.endgame_file.empty() || (options.jobs_file.empty() && options.table_size == 0 && !options.test.enabled() && !options.rotate_seats
+                                                && options.solitaire_file.empty()))
+           && (options.tuning_file.empty() || (options.jobs_file.empty() && options.table_size == 0 && !options.test.enabled() && !options.rotate_seats
+                                               && options.solitaire_file.empty() && options.endgame_file.empty()))
+           && (options.evaluation_file.empty() || (options.jobs_file.empty() && options.table_size == 0 && !options.test.enabled() && !options.rotate_seats
+                                                   && options.solitaire_file.empty() && options.endgame_file.empty() && options.tuning_file.empty()))
+           && (options.table_size == 0 || (!options.test.enabled() && !options.rotate_seats))
+           && !(options.test.enabled() && options.rotate_seats)
+           && (!options.games_given || options.table_size != 0 || !options.tuning_file.empty())
+           && (!generations_given || !options.tuning_file.empty())
+           && (!positions_given || !options.evaluation_file.empty())
+           && (!margin_given || options.test.enabled());
+}
+
+/**
+ * @brief Runs every matchup of a job file back to back, and prints the results of each as one line of JSON.
+ * @details A job file holds one matchup per line, in the same format as the interactive input (see get_inputs()).
+ * Blank lines and lines starting with # are ignored. The whole file is checked before any job is run, and
+ * any error is reported on stderr with its line number. Human players are not accepted, since nobody is at the
+ * prompt, and as in the interactive mode the evaluation function is disabled for more than 2 players. All jobs
+ * share one WorkerPool, so the worker threads are only started once for the whole file, and each job uses the
+ * seed given by --seed: a job's results are the same as those of the interactive mode with the same seed.
+ * For each job, an object is printed to stdout with the fields job, line, num_simulations, use_evaluation, seed,
+ * players (id, name, win_rate, and average_score of each player), num_games, average_turns, max_turns, min_turns, seconds,
+ * and, if the evaluation function is used, duration, lead_change, and late_uncertainty. With --confidence, every job
+ * must have 2 players and is stopped early by the sequential test; num_games is then the number of games played, and
+ * the fields test_outcome (player_0_stronger, player_1_stronger, no_difference, or undecided), stronger_player (0, 1, or
+ * null), test_error_bound (the bound 1 - C on the error probability of the outcome, see SequentialTest), and
+ * log_likelihood_ratios (of the alternatives that player 0 and player 1 are stronger) are added. With
+ * --rotate-seats, num_simulations is the number of deals, the win rates and average scores of the players are those of
+ * the agents over all seatings (see PairedStats), with their paired and independent standard errors, and the fields deals
+ * and differences (the paired differences of the win rates and average scores of each pair of players, with their
+ * standard errors) are added. Doubles are printed with
+ * enough digits to be read back exactly.
+ * @param options A read-only reference to the Options object holding the command line options.
+ * @return An integer representing the exit status.
+ */
+int run_jobs(const Options& options) {
+    std::ifstream file;
+    if (options.jobs_file != "-") {
+        file.open(options.jobs_file);
+        if (!file) {
+            std::cerr << "Could not open job file " << options.jobs_file << '\n';
+            return 1;
+        }
+    }
+    std::istream& in = (options.jobs_file == "-") ? std::cin : file;
+
+    // Parse and check the whole file first, so that an error on a late line does not waste the earlier jobs
+    std::vector<std::tuple<int, std::vector<int>>> jobs;
+    std::string line;
+    std::string error;
+    for (int line_number = 1; std::getline(in, line); ++line_number) {
+        const size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#') {
+            continue;
+        }
+        line = line.substr(first, line.find_last_not_of(" \t\r") + 1 - first);
+
+        std::vector<int> inputs;
+        if (!parse_inputs(line, inputs, error)) {
+            std::cerr << "Line " << line_number << ": " << error << '\n';
+            return 1;
+        }
+        if (is_human_active(inputs, 23)) {
+            std::cerr << "Line " << line_number << ": The Human agent cannot be used in a job file.\n";
+            return 1;
+        }
+        if (inputs.size() > 4) {
+            inputs[1] = 0;
+        }
+        if (options.test.enabled() && inputs.size() != 4) {
+            std::cerr << "Line " << line_number << ": The sequential test requires exactly 2 players.\n";
+            return 1;
+        }
+
+        jobs.push_back(std::tuple(line_number, inputs));
+    }
+
+    WorkerPool pool(options.num_threads);
+    std::cout << std::setprecision(std::numeric_limits<double>::max_digits10);
+
+    for (size_t j = 0; j < jobs.size(); ++j) {
+        const auto& [line_number, inputs] = jobs[j];
+        const int num_simulations = inputs[0];
+        const bool use_evaluation = static_cast<bool>(inputs[1]);
+        const std::vector<std::tuple<std::unique_ptr<Agent>, std::string>> players = get_players(inputs);
+
+        auto start = std::chrono::high_resolution_clock::now();
+
+        // No evaluation history is printed, so none is saved
+        std::vector<double> saved_history;
+        PairedStats paired(inputs.size() - 2, 1);
+        const TrialData data = options.rotate_seats
+            ? run_rotated_trial(inputs, num_simulations, use_evaluation, pool, options.seed, paired)
+            : run_trial(inputs, num_simulations, use_evaluation, pool, options.engine, options.seed, options.test, -1, saved_history);
+        const double num_games = static_cast<double>(data.num_games);
+
+        auto end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> duration = end - start;
+
+        std::cout << "{\"job\": " << j << ", \"line\": " << line_number << ", \"num_simulations\": " << num_simulations
+                  << ", \"use_evaluation\": " << (use_evaluation ? "true" : "false") << ", \"seed\": " << options.seed << ", \"players\": [";
+        for (size_t i = 0; i < players.size(); ++i) {
+            std::cout << (i == 0 ? "" : ", ") << "{\"id\": " << inputs[i + 2] << ", \"name\": \"" << std::get<1>(players[i]) << '"';
+            if (options.rotate_seats) {
+                std::cout << ", \"win_rate\": " << paired.mean(PairedStats::WIN_RATE, i) << ", \"win_rate_error\": ";
+                print_json_number(paired.paired_error(PairedStats::WIN_RATE, i));
+                std::cout << ", \"independent_win_rate_error\": ";
+                print_json_number(paired.independent_error(PairedStats::WIN_RATE, i));
+                std::cout << ", \"average_score\": " << paired.mean(PairedStats::SCORE, i) << ", \"average_score_error\": ";
+                print_json_number(paired.paired_error(PairedStats::SCORE, i));
+                std::cout << ", \"independent_average_score_error\": ";
+                print_json_number(paired.independent_error(PairedStats::SCORE, i));
+            }
+            else {
+                std::cout << ", \"win_rate\": " << data.get_num_wins(i) / num_games
+                          << ", \"average_score\": " << static_cast<double>(data.score_accum[i]) / num_games;
+            }
+            std::cout << '}';
+        }
+        std::cout << ']';
+        if (options.rotate_seats) {
+            // Paired differences between each pair of players
+            std::cout << ", \"deals\": " << paired.num_deals << ", \"differences\": [";
+            for (size_t a = 0; a < players.size(); ++a) {
+                for (size_t b = a + 1; b < players.size(); ++b) {
+                    std::cout << ((a == 0 && b == 1) ? "" : ", ") << "{\"players\": [" << a << ", " << b << "], \"win_rate\": "
+                              << paired.mean(PairedStats::WIN_RATE, a) - paired.mean(PairedStats::WIN_RATE, b) << ", \"win_rate_error\": ";
+                    print_json_number(paired.difference_error(PairedStats::WIN_RATE, a, b));
+                    std::cout << ", \"average_score\": " << paired.mean(PairedStats::SCORE, a) - paired.mean(PairedStats::SCORE, b)
+                              << ", \"average_score_error\": ";
+                    print_json_number(paired.difference_error(PairedStats::SCORE, a, b));
+                    std::cout << '}';
+                }
+            }
+            std::cout << ']';
         }
+        std::cout << ", \"num_games\": " << data.num_games;
+        if (options.test.enabled()) {
+            const SequentialTest::Outcome decision = options.test.decision(data);
+            const std::array<double, 2> ratios = options.test.log_likelihood_ratios(data);
+            std::cout << ", \"test_outcome\": \"" << (decision == SequentialTest::PLAYER_0_STRONGER ? "player_0_stronger"
+                                                  : decision == SequentialTest::PLAYER_1_STRONGER ? "player_1_stronger"
+                                                  : decision == SequentialTest::NO_DIFFERENCE ? "no_difference" : "undecided")
+                      << "\", \"stronger_player\": " << (decision == SequentialTest::PLAYER_0_STRONGER ? "0" : (decision == SequentialTest::PLAYER_1_STRONGER ? "1" : "null"))
+                      << ", \"test_error_bound\": " << 1.0 - options.test.confidence
+                      << ", \"log_likelihood_ratios\": [" << ratios[0] << ", " << ratios[1] << ']';
+        }
+        std::cout << ", \"average_turns\": " << static_cast<double>(data.num_turns_accum) / num_games
+                  << ", \"max_turns\": " << data.max_turns << ", \"min_turns\": " << data.min_turns;
+        if (use_evaluation) {
+            std::cout << ", \"duration\": " << data.quality.duration() << ", \"lead_change\": " << data.quality.lead_change()
+                      << ", \"late_uncertainty\": " << data.quality.late_uncertainty();
+        }
+        std::cout << ", \"seconds\": " << duration.count() << "}\n";
+
+        // Flush so that the results of long job files can be followed as they come in
+        std::cout.flush();
     }
 
-    return players;
+    return 0;
 }
 
 /**
- * @brief Checks if a human player is present in the game.
- * @param inputs A read-only vector of ints containing the user inputs as collected by the get_inputs() function.
- * @param human_id An int corresponding to the human agent.
- * @return A bool which is true if a human player was found, else false.
+ * @brief Runs a round-robin tournament between agents 0 through 22, and prints its results as one JSON object.
+ * @details Every table of --tournament N distinct agents plays --games G games (see run_tournament()), all seeded
+ * with --seed. The object printed to stdout has the fields table_size, games_per_table, seed, num_tables, agents (id,
+ * name, rating, win_rate, and average_score of each agent, sorted by decreasing rating), win_rate and average_score
+ * (matrices indexed by agent number, see TournamentData, with null on the diagonal), and seconds. The Human agent
+ * does not take part.
+ * @param options A read-only reference to the Options object holding the command line options.
+ * @return An integer representing the exit status.
  */
-bool is_human_active(const std::vector<int>& inputs, int human_id) {
-    return std::find(inputs.begin() + 2, inputs.end(), human_id) != inputs.end();
-}
\ No newline at end of file
+int run_tournament_mode(const Options& options) {
+    std::vector<int> agent_ids;
+    for (int id = 0; id <= 22; ++id) {
+        agent_ids.push_back(id);
+    }
+
+    WorkerPool pool(options.num_threads);
+    auto start = std::chrono::high_resolution_clock::now();
+    const TournamentData data = run_tournament(agent_ids, static_cast<size_t>(options.table_size), options.games_per_table,
+                                               pool, options.engine, options.seed);
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> duration = end - start;
+
+    const std::vector<double> ratings = data.ratings();
+    const std::vector<double> win_rates = data.win_rates();
+    const std::vector<double> average_scores = data.average_scores();
+
+    std::vector<size_t> order(agent_ids.size());
+    for (size_t i = 0; i < order.size(); ++i) {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return ratings[a] > ratings[b]; });
+
+    std::cout << std::setprecision(std::numeric_limits<double>::max_digits10);
+    std::cout << "{\"table_size\": " << options.table_size << ", \"games_per_table\": " << options.games_per_table
+              << ", \"seed\": " << options.seed << ", \"num_tables\": " << data.tables.size() << ", \"agents\": [";
+    for (size_t k = 0; k < order.size(); ++k) {
+        const size_t i = order[k];
+        std::cout << (k == 0 ? "\n  " : ",\n  ") << "{\"id\": " << agent_ids[i] << ", \"name\": \"" << data.agent_names[i]
+                  << "\", \"rating\": " << ratings[i] << ", \"win_rate\": " << win_rates[i] << ", \"average_score\": " << average_scores[i] << '}';
+    }
+
+    const std::vector<std::vector<double>> win_rate_matrix = data.win_rate_matrix();
+    const std::vector<std::vector<double>> average_score_matrix = data.average_score_matrix();
+    for (const auto& [name, matrix] : {std::tuple("win_rate", &win_rate_matrix), std::tuple("average_score", &average_score_matrix)}) {
+        std::cout << "],\n\"" << name << "\": [";
+        for (size_t i = 0; i < matrix->size(); ++i) {
+            std::cout << (i == 0 ? "\n  [" : ",\n  [");
+            for (size_t j = 0; j < (*matrix)[i].size(); ++j) {
+                std::cout << (j == 0 ? "" : ", ");
+                print_json_number((*matrix)[i][j]);
+            }
+            std::cout << ']';
+        }
+    }
+    std::cout << "],\n\"seconds\": " << duration.count() << "}\n";
+
+    return 0;
+}
+
+/**
+ * @brief Solves solitaire Qwixx and writes the value table used by the Solitaire agent.
+ * @details The table is written to the path given by --solve-solitaire (see SolitaireTable::solve()), using --threads
+ * worker threads. The Solitaire agent reads it from the path in the environment variable QWIXX_SOLITAIRE_TABLE, or from
+ * solitaire_table.bin in the working directory. The optimal expected score of a solitaire game is printed to stdout.
+ * @param options A read-only reference to the Options object holding the command line options.
+ * @return An integer representing the exit status.
+ */
+int run_solve_solitaire(const Options& options) {
+    WorkerPool pool(options.num_threads);
+    auto start = std::chrono::high_resolution_clock::now();
+    const double value = SolitaireTable::solve(options.solitaire_file, pool);
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> duration = end - start;
+
+    std::cout << "Wrote " << SolitaireTable::NUM_ENTRIES << " values to " << options.solitaire_file << '\n'
+              << "Optimal expected score of a solitaire game: " << value << '\n'
+              << "Completed in " << duration.count() << " seconds\n";
+
+    return 0;
+}
+
+/**
+ * @brief Solves the 2-player lock races and writes the endgame table.
+ * @details The table is written to the path given by --solve-endgame (see EndgameTable::solve()), using --threads worker
+ * threads. The evaluation function and the Solitaire agent use it when the environment variable QWIXX_ENDGAME_TABLE holds
+ * its path. The win probability of a sample position is printed to stdout.
+ * @param options A read-only reference to the Options object holding the command line options.
+ * @return An integer representing the exit status.
+ */
+int run_solve_endgame(const Options& options) {
+    WorkerPool pool(options.num_threads);
+    auto start = std::chrono::high_resolution_clock::now();
+    const double value = EndgameTable::solve(options.endgame_file, pool);
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> duration = end - start;
+
+    std::cout << "Wrote " << EndgameTable::NUM_ENTRIES << " values to " << options.endgame_file << '\n'
+              << "Win probability of the player to roll, both with two lockable rows of 5 marks and equal scores: " << value << '\n'
+              << "Completed in " << duration.count() << " seconds\n";
+
+    return 0;
+}
+
+/**
+ * @brief Tunes the parameters of the Computational agent against a fixed pool of opponents.
+ * @details Runs generations of SPSA (see run_tuning_generation()) until --generations generations are completed, using
+ * --threads worker threads. If the checkpoint file given by --tune exists, the run resumes from it, with the seed and
+ * number of games per opponent of the checkpoint, and is rejected if --seed or --games give different values;
+ * otherwise, a new run starts from the default parameters, with --seed and --games. After each generation, the
+ * checkpoint is saved, and the best parameters so far, which had to beat the previous best parameters on fresh deals,
+ * are written to the same path with ".best" appended, in the format read from QWIXX_COMPUTATIONAL_PARAMETERS by the
+ * Computational agent. The win rates of the candidates of each generation are printed to stdout as they come in,
+ * marking the generations that found new best parameters.
+ * @param options A read-only reference to the Options object holding the command line options.
+ * @return An integer representing the exit status.
+ */
+int run_tune_computational(const Options& options) {
+    TuningState state = std::filesystem::exists(options.tuning_file) ? TuningState::load(options.tuning_file)
+                                                                     : TuningState(options.seed, options.games_per_table);
+    const std::string best_file = options.tuning_file + ".best";
+
+    // A run resumed from a checkpoint keeps its own seed and number of games, so other values must not be given
+    if ((options.seed_given && options.seed != state.seed) || (options.games_given && options.games_per_table != state.games_per_opponent)) {
+        std::cerr << "The checkpoint " << options.tuning_file << " resumes a run with seed " << state.seed << " and "
+                  << state.games_per_opponent << " deals per opponent, which differ from --seed or --games. Remove the"
+                  << " checkpoint to start a new run, or leave out these options to resume it.\n";
+        return 1;
+    }
+
+    // Lambda to print parameters on one line
+    auto print_parameters = [](const Computational::Parameters& parameters) {
+        std::cout << "alpha " << parameters.alpha << ", mu " << parameters.mu << ", delta " << parameters.delta
+                  << ", sigma " << parameters.sigma << ", epsilon " << parameters.epsilon;
+    };
+
+    std::cout << (state.generation == 0 ? "Starting" : "Resuming") << " at generation " << state.generation << " with seed " << state.seed
+              << " and " << state.games_per_opponent << " deals per opponent\n";
+
+    WorkerPool pool(options.num_threads);
+    auto start = std::chrono::high_resolution_clock::now();
+    while (state.generation < options.num_generations) {
+        const TuningGeneration generation = run_tuning_generation(state, pool);
+        state.save(options.tuning_file);
+        state.best.save(best_file);
+
+        std::cout << "Generation " << state.generation << ": win rates " << generation.win_rates[0] << " and "
+                  << generation.win_rates[1] << ", now at ";
+        print_parameters(state.current);
+        if (generation.new_best) {
+            std::cout << " (new best, validated win rate " << state.best_win_rate << ')';
+        }
+        std::cout << std::endl;
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> duration = end - start;
+
+    std::cout << "Best parameters (validated win rate " << state.best_win_rate << "): ";
+    print_parameters(state.best);
+    std::cout << "\nWrote the best parameters to " << best_file << '\n'
+              << "Completed in " << duration.count() << " seconds\n";
+
+    return 0;
+}
+
+/**
+ * @brief Fits the parameters of the 2-player evaluation function to the results of simulated games.
+ * @details Runs rounds of the fit (see EvaluationFitter) with --seed and --threads worker threads, until at least
+ * --positions labelled positions have been used. After each round, its statistics are printed to stdout, and the
+ * parameters are written to the path given by --fit-evaluation, in the format read from QWIXX_EVALUATION_PARAMETERS
+ * by the evaluation function.
+ * @param options A read-only reference to the Options object holding the command line options.
+ * @return An integer representing the exit status.
+ */
+int run_fit_evaluation(const Options& options) {
+    EvaluationFitter fitter(options.seed);
+
+    WorkerPool pool(options.num_threads);
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int r = 1; fitter.num_positions() < options.num_positions; ++r) {
+        const EvaluationFitter::Round round = fitter.run_round(pool);
+        fitter.parameters().save(options.evaluation_file);
+
+        std::cout << "Round " << r << ": " << round.num_positions << " positions, log loss " << round.log_loss << ", Brier score "
+                  << round.brier_score << " (default evaluation: " << round.default_brier_score << ')' << std::endl;
+    }
+    auto end = std::chrono::high_resolution_clock::now();
+    std::chrono::duration<double> duration = end - start;
+
+    std::cout << "Wrote the parameters fitted to " << fitter.num_positions() << " positions to " << options.evaluation_file << '\n'
+              << "Completed in " << duration.count() << " seconds\n";
+
+    return 0;
+}
+
+/**
+ * @brief Prints a double to stdout as a JSON number, or as null if it is not finite.
+ * @param value A double representing the value to print.
+ */
+void print_json_number(double value) {
+    if (std::isfinite(value)) {
+        std::cout << value;
+    }
+    else {
+        std::cout << "null";
+    }
+}
+
+/**
+ * @brief Prints the paired statistics of the agents of a trial with seat rotation.
+ * @details For each agent, prints its win rate and average score over all seatings, with the paired standard error
+ * (over deals) and the standard error that as many independent games would give. Then prints the difference of the win
+ * rates and average scores of each pair of agents, with its paired standard error.
+ * @param paired A read-only reference to the PairedStats object of the trial.
+ * @param players A read-only reference to the players of the trial, in the order of the inputs.
+ */
+void print_paired_stats(const PairedStats& paired, const std::vector<std::tuple<std::unique_ptr<Agent>, std::string>>& players) {
+    const std::array<std::string, PairedStats::NUM_MEASURES> labels = {"win rate", "average score"};
+
+    for (size_t i = 0; i < players.size(); ++i) {
+        for (size_t m = 0; m < PairedStats::NUM_MEASURES; ++m) {
+            const auto measure = static_cast<PairedStats::Measure>(m);
+            std::cout << "Agent " << i << " (" << std::get<1>(players[i]) << ") " << labels[m] << ": " << paired.mean(measure, i)
+                      << " (paired standard error " << paired.paired_error(measure, i)
+                      << ", independent games " << paired.independent_error(measure, i) << ")\n";
+        }
+    }
+
+    for (size_t a = 0; a < players.size(); ++a) {
+        for (size_t b = a + 1; b < players.size(); ++b) {
+            for (size_t m = 0; m < PairedStats::NUM_MEASURES; ++m) {
+                const auto measure = static_cast<PairedStats::Measure>(m);
+                std::cout << "Agent " << a << " - Agent " << b << " " << labels[m] << " difference: "
+                          << paired.mean(measure, a) - paired.mean(measure, b)
+                          << " (paired standard error " << paired.difference_error(measure, a, b) << ")\n";
+            }
+        }
+    }
+}
@@ -0,0 +1,179 @@
+#include <algorithm>
+
+#include "pool.hpp"
+
+/**
+ * @brief Number of workers running the task that the calling thread is running, or 0 outside of any task.
+ */
+static thread_local unsigned int thread_num_workers = 0;
+
+/**
+ * @brief Default constructor.
+ * @details Starts num_threads - 1 worker threads, which wait for the first task.
+ * @param num_threads An unsigned int representing the number of workers, including the calling thread. Values of 0 are treated as 1.
+ */
+WorkerPool::WorkerPool(unsigned int num_threads)
+    : m_task(nullptr),
+      m_num_workers(0),
+      m_num_running(0),
+      m_generation(0),
+      m_stop(false) {
+
+    for (unsigned int t = 1; t < std::max(1u, num_threads); ++t) {
+        m_threads.emplace_back(&WorkerPool::thread_loop, this, t);
+    }
+}
+
+/**
+ * @brief Destructor.
+ * @details Stops the worker threads and waits for them to exit.
+ */
+WorkerPool::~WorkerPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stop = true;
+    }
+    m_task_ready.notify_all();
+
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+}
+
+/**
+ * @brief Runs a task on the first num_workers workers and waits until all of them have finished.
+ * @details Worker i calls task(i). Worker 0 is the calling thread.
+ * @attention The task must not throw, since exceptions cannot leave a worker thread. Callers that can fail
+ * should catch exceptions inside the task and rethrow them after run() has returned.
+ * @param num_workers An unsigned int representing the number of workers to use, between 1 and size().
+ * @param task A callable receiving the index of the worker running it.
+ */
+void WorkerPool::run(unsigned int num_workers, const std::function<void(unsigned int)>& task) {
+    num_workers = std::max(1u, std::min(num_workers, size()));
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_task = &task;
+        m_num_workers = num_workers;
+        m_num_running = num_workers - 1;
+        ++m_generation;
+    }
+    m_task_ready.notify_all();
+
+    const unsigned int outer_num_workers = thread_num_workers;
+    thread_num_workers = num_workers;
+    task(0);
+    thread_num_workers = outer_num_workers;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_task_done.wait(lock, [this] { return m_num_running == 0; });
+    m_task = nullptr;
+}
+
+/**
+ * @brief Gets the number of workers running the task that the calling thread is running.
+ * @details Lets code that may run inside a task, e.g. an agent, avoid starting threads of its own when the task already
+ * runs on several threads. Nested tasks count for the innermost pool.
+ * @return An unsigned int representing the number of workers of the task, or 0 if the calling thread is not running
+ * a task of any pool.
+ */
+unsigned int WorkerPool::current_num_workers() {
+    return thread_num_workers;
+}
+
+/**
+ * @brief Loop run by each worker thread.
+ * @details Waits for a new task, runs it if this worker is among the workers requested for it, and
+ * reports back once it is done. Exits once the pool is stopped.
+ * @param worker_index An unsigned int representing the index of this worker, at least 1.
+ */
+void WorkerPool::thread_loop(unsigned int worker_index) {
+    std::uint64_t seen_generation = 0;
+    while (true) {
+        const std::function<void(unsigned int)>* task = nullptr;
+        unsigned int num_workers = 0;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_task_ready.wait(lock, [&] { return m_stop || m_generation != seen_generation; });
+            if (m_stop) {
+                return;
+            }
+            seen_generation = m_generation;
+            if (worker_index >= m_num_workers) {
+                continue;
+            }
+            task = m_task;
+            num_workers = m_num_workers;
+        }
+
+        thread_num_workers = num_workers;
+        (*task)(worker_index);
+        thread_num_workers = 0;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            --m_num_running;
+        }
+        m_task_done.notify_one();
+    }
+}
+
+/**
+ * @brief Default constructor.
+ * @details Splits the tasks into num_workers contiguous ranges of nearly equal sizes.
+ * @param num_workers An unsigned int representing the number of workers. Values of 0 are treated as 1.
+ * @param num_tasks A 64-bit integer representing the number of tasks.
+ */
+WorkStealingRanges::WorkStealingRanges(unsigned int num_workers, std::int64_t num_tasks)
+    : m_ranges(std::max(1u, num_workers)) {
+
+    const std::int64_t n = static_cast<std::int64_t>(m_ranges.size());
+    for (std::int64_t w = 0; w < n; ++w) {
+        m_ranges[w].begin = num_tasks * w / n;
+        m_ranges[w].end = num_tasks * (w + 1) / n;
+    }
+}
+
+/**
+ * @brief Gets the next task of a worker.
+ * @details Takes the first task of the worker's own range. If that range is empty, the other ranges are visited
+ * in order, starting after the worker's own, and the back half of the first non-empty one is moved into the worker's
+ * range. Since no tasks are added, all tasks have been handed out once this returns false.
+ * @param worker_index An unsigned int representing the index of the worker asking for a task.
+ * @param task A reference to a 64-bit integer receiving the task.
+ * @return A bool which is true if a task was found, else false.
+ */
+bool WorkStealingRanges::next(unsigned int worker_index, std::int64_t& task) {
+    Range& own = m_ranges[worker_index];
+    {
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (own.begin < own.end) {
+            task = own.begin++;
+            return true;
+        }
+    }
+
+    for (size_t k = 1; k < m_ranges.size(); ++k) {
+        Range& victim = m_ranges[(worker_index + k) % m_ranges.size()];
+        std::int64_t begin = 0;
+        std::int64_t end = 0;
+        {
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (victim.begin == victim.end) {
+                continue;
+            }
+            // Take the back half, rounded up, so that a single remaining task can be stolen too
+            begin = victim.begin + (victim.end - victim.begin) / 2;
+            end = victim.end;
+            victim.end = begin;
+        }
+
+        // Run the first stolen task now and keep the rest, where other workers can steal them in turn
+        task = begin;
+        std::lock_guard<std::mutex> lock(own.mutex);
+        own.begin = begin + 1;
+        own.end = end;
+        return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @class WorkerPool pool.hpp "src/pool.hpp"
+ * @brief A fixed set of worker threads that can be given any number of tasks, one after the other.
+ * @details The threads are started once by the constructor and wait for work until the pool is destroyed,
+ * so running many trials in one process does not pay for starting threads each time. run() hands a task to
+ * the first num_workers workers, and returns once all of them have finished it. The calling thread acts as
+ * worker 0, so a pool of size N starts N - 1 threads.
+ */
+class WorkerPool {
+public:
+    WorkerPool(unsigned int num_threads);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    /// @brief Gets the number of workers, including the calling thread.
+    unsigned int size() const { return static_cast<unsigned int>(m_threads.size()) + 1; }
+
+    void run(unsigned int num_workers, const std::function<void(unsigned int)>& task);
+
+    static unsigned int current_num_workers();
+
+protected:
+    std::vector<std::thread> m_threads;                 //< Worker threads 1 to size() - 1.
+    std::mutex m_mutex;                                 //< Protects all members below.
+    std::condition_variable m_task_ready;               //< Signalled when a task is handed out or the pool is stopped.
+    std::condition_variable m_task_done;                //< Signalled when a worker thread finishes its task.
+    const std::function<void(unsigned int)>* m_task;    //< The current task.
+    unsigned int m_num_workers;                         //< Number of workers running the current task.
+    unsigned int m_num_running;                         //< Number of worker threads that have not finished the current task.
+    std::uint64_t m_generation;                         //< Number of tasks handed out so far.
+    bool m_stop;                                        //< Whether the worker threads should exit.
+
+    void thread_loop(unsigned int worker_index);
+};
+
+/**
+ * @class WorkStealingRanges pool.hpp "src/pool.hpp"
+ * @brief Hands out the tasks 0 to num_tasks - 1 to the workers of a pool, with work stealing.
+ * @details The tasks are split into one contiguous range per worker. A worker takes the tasks of its own range
+ * from the front, in order, so that consecutive tasks (e.g. the games of the same table) tend to run on the same
+ * worker. Once its range is empty, the worker steals the back half of the range of another worker, so that workers
+ * whose tasks were quick do not sit idle while others still have slow tasks left. Each range has its own lock,
+ * which is only contended when a range is stolen from.
+ */
+class WorkStealingRanges {
+public:
+    WorkStealingRanges(unsigned int num_workers, std::int64_t num_tasks);
+
+    bool next(unsigned int worker_index, std::int64_t& task);
+
+protected:
+    /// @brief Remaining tasks of one worker. Aligned to a cache line, so that the ranges of different workers do not share one.
+    struct alignas(64) Range {
+        std::mutex mutex;       //< Protects begin and end.
+        std::int64_t begin;     //< First remaining task.
+        std::int64_t end;       //< One past the last remaining task.
+    };
+
+    std::vector<Range> m_ranges;    //< Range of each worker.
+};
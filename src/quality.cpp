@@ -0,0 +1,159 @@
+#include <algorithm>
+#include <cmath>
+
+#include "quality.hpp"
+
+/**
+ * @brief Default constructor.
+ * @details Zeroes all accumulators.
+ */
+QualityCriteria::QualityCriteria()
+    : num_games(0),
+      sample_accum{} {}
+
+/**
+ * @brief Adds the evaluation history of a single game to the accumulators.
+ * @details The number of moves of a game (M_g) is the size of its evaluation history minus one, i.e. the number of
+ * evaluations before the final evaluation of 1 or -1. For the duration, the game is counted in the histogram of the
+ * number of moves. For the lead change, the number of times the evaluation changes sign is counted, starting from
+ * the second move, since there will always be a new leader after the first move. For the late uncertainty, the
+ * absolute evaluation is sampled at NUM_SAMPLES evenly spaced time points t in [0, 1], interpolating linearly between
+ * moves. The time points are mapped to fractional moves t * (M_g + 1), so that the final evaluation is included;
+ * indices past the final evaluation (which only occur at t = 1 and in the last fraction of a move before it) are
+ * clamped to the final evaluation.
+ * @param evaluation_history A read-only span of doubles containing the evaluations with respect to player 0 of one
+ * game, ending with the final evaluation. Must hold at least two evaluations.
+ */
+void QualityCriteria::add_game(std::span<const double> evaluation_history) {
+    const size_t moves = evaluation_history.size() - 1;
+    if (num_games_by_moves.size() <= moves) {
+        num_games_by_moves.resize(moves + 1, 0);
+        lead_changes_by_moves.resize(moves + 1, 0);
+    }
+
+    ++num_games;
+    num_games_by_moves[moves] += 1;
+
+    int num_lead_changes = 0;
+    for (size_t k = 2; k < evaluation_history.size(); ++k) {
+        num_lead_changes += (std::signbit(evaluation_history[k]) != std::signbit(evaluation_history[k - 1])) ? 1 : 0;
+    }
+    lead_changes_by_moves[moves] += num_lead_changes;
+
+    const double M_g = static_cast<double>(evaluation_history.size());     // no minus one here, as we want to include the final evaluation of 1.0 or -1.0
+    const size_t last_index = evaluation_history.size() - 1;
+    for (int s = 0; s < NUM_SAMPLES; ++s) {
+        // t represents a time point in the game and falls in the interval [0, 1]
+        const double t = static_cast<double>(s) / static_cast<double>(NUM_SAMPLES - 1);
+        const double tM_g = t * M_g;    // corresponds to a fractional move
+        const size_t floor_index = static_cast<size_t>(tM_g);
+        const double move_fraction = tM_g - static_cast<double>(floor_index);     // fractional part of the move
+        const double floor_eval = std::abs(evaluation_history[std::min(floor_index, last_index)]);
+        const double ceil_eval = std::abs(evaluation_history[std::min(floor_index + 1, last_index)]);
+        const double fractional_eval = floor_eval + (ceil_eval - floor_eval) * move_fraction;   // evaluation of the fractional move
+        sample_accum[s] += std::llround(fractional_eval * SAMPLE_SCALE);
+    }
+}
+
+/**
+ * @brief Merges the accumulators of another QualityCriteria object into this one.
+ * @param other A read-only reference to the QualityCriteria object to merge.
+ */
+void QualityCriteria::merge(const QualityCriteria& other) {
+    if (num_games_by_moves.size() < other.num_games_by_moves.size()) {
+        num_games_by_moves.resize(other.num_games_by_moves.size(), 0);
+        lead_changes_by_moves.resize(other.lead_changes_by_moves.size(), 0);
+    }
+
+    num_games += other.num_games;
+    for (size_t m = 0; m < other.num_games_by_moves.size(); ++m) {
+        num_games_by_moves[m] += other.num_games_by_moves[m];
+        lead_changes_by_moves[m] += other.lead_changes_by_moves[m];
+    }
+    for (int s = 0; s < NUM_SAMPLES; ++s) {
+        sample_accum[s] += other.sample_accum[s];
+    }
+}
+
+/**
+ * @brief Computes the duration quality criterion.
+ * @details Calculates the average duration, measured as the deviation in the number of moves (M_g)
+ * from the preferred number of moves (M_pref). M_pref is assumed to be equal to the average number
+ * of moves over all games in the trial for simplicity. Since M_pref is only known once all games have
+ * been added, the deviation is computed from the number of games with each number of moves.
+ * @return A double in the interval [0, 1] representing the average duration. 0 indicates no deviation from
+ * the preferred number of turns, while 1 indicates maximum deviation from the preferred number of turns. The maximum is
+ * reached for games with 0 or 2M_g moves.
+ */
+double QualityCriteria::duration() const {
+    const double G = static_cast<double>(num_games);
+
+    // Set M_pref to the average number of moves
+    long long total_moves = 0;
+    for (size_t m = 0; m < num_games_by_moves.size(); ++m) {
+        total_moves += num_games_by_moves[m] * static_cast<long long>(m);
+    }
+    const double M_pref = static_cast<double>(total_moves) / G;
+
+    // Sum up duration values for all games
+    double acc = 0.0;
+    for (size_t m = 0; m < num_games_by_moves.size(); ++m) {
+        acc += static_cast<double>(num_games_by_moves[m]) * (std::abs(M_pref - static_cast<double>(m)) / M_pref);
+    }
+
+    // Return the average, or 1 if this value is greater than 1
+    return std::min(1.0, acc / G);
+}
+
+/**
+ * @brief Computes the lead change quality criterion.
+ * @details Calculates the average lead change, measured as the number of times the evaluation
+ * (taken with respect to player 0) changes sign, divided by the number of moves after the first. All games
+ * with the same number of moves share the divisor, so their lead changes are summed before dividing.
+ * @return A double in the interval [0, 1] representing the average lead change. 0 indicates no lead changes, while 1 indicates
+ * a lead change on every turn.
+ */
+double QualityCriteria::lead_change() const {
+    const double G = static_cast<double>(num_games);
+
+    double acc = 0.0;
+    for (size_t m = 0; m < num_games_by_moves.size(); ++m) {
+        if (num_games_by_moves[m] > 0) {
+            acc += static_cast<double>(lead_changes_by_moves[m]) / (static_cast<double>(m) - 1);
+        }
+    }
+
+    // Return the average
+    return acc / G;
+}
+
+/**
+ * @brief Computes the uncertainty (late) quality criterion.
+ * @details Calculates the late uncertainty, measured as an approximation of the area between the curve of the absolute value of
+ * the evaluations and the curve (line) extending from (0, 0) to (M_g - 1, 1). Intuitively, this captures the size of the lead
+ * difference with respect to either player (since the evaluation is zero-sum, taking the absolute value gives us this lead
+ * difference) over time. A game where one player has a large lead for most of the game would result in a large area below
+ * the lead curve and above the line from (0, 0) to (M_g - 1, 1), corresponding to a negative uncertainty (i.e., high certainty),
+ * while a game where no player has a lead lead for most of the game would result in a large area below the line from (0, 0) to
+ * (M_g - 1, 1) and above the lead curve, corresponding to a positive uncertainty (i.e., high uncertainty). 0.5 is added to the
+ * final result so that it falls between 0 and 1, like the other statistics. This version of the uncertainty formula weighs the
+ * late game more heavily. The average over games of the absolute evaluation at each time point is taken from the sums
+ * accumulated by add_game().
+ * @return A double in the interval [0, 1] representing the average late uncertainty. 0 indicates no uncertainty, as in a game
+ * where the absolute difference in evaluation is 1 after every move, while 1 indicates maximum uncertainty, as in a game where
+ * the difference in evaluation is 0 after every move.
+ */
+double QualityCriteria::late_uncertainty() const {
+    const double G = static_cast<double>(num_games);
+
+    // Calculate the sum of the samples across all games
+    double samples_acc = 0.0;
+    for (int s = 0; s < NUM_SAMPLES; ++s) {
+        const double t = static_cast<double>(s) / static_cast<double>(NUM_SAMPLES - 1);
+        const double games_acc = static_cast<double>(sample_accum[s]) / SAMPLE_SCALE;
+        samples_acc += std::min(1.0, t - (games_acc / G));
+    }
+
+    // Return 0.5 plus the average to get result in the interval [0, 1]
+    return 0.5 + (samples_acc / NUM_SAMPLES);
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+/**
+ * @struct QualityCriteria quality.hpp "src/quality.hpp"
+ * @brief Accumulates the duration, lead change, and uncertainty (late) quality criteria over the games of a trial.
+ * @details Each criterion is an average over games of a value computed from the game's evaluation history
+ * (taken with respect to player 0). Instead of keeping every history until the end of the trial, add_game()
+ * reduces a history to a few counts and sums as soon as the game has ended, so the memory used does not grow
+ * with the number of games. Like TrialData, one QualityCriteria object is owned by each worker and the objects
+ * are merged at the end. All accumulators are integers (the sampled evaluations of the late uncertainty are
+ * stored in fixed point), so the results do not depend on the order in which games are added or merged.
+ */
+struct QualityCriteria {
+    /// @brief Number of samples (rectangles) used to approximate the area for the late uncertainty.
+    static constexpr int NUM_SAMPLES = 100;
+
+    /// @brief Scale of the fixed-point sums of sampled evaluations. Each sample lies in [0, 1], so the sums of up to 2^31 games fit in 64 bits.
+    static constexpr double SAMPLE_SCALE = 4294967296.0;
+
+    long long num_games;                                    //< Number of games added.
+    std::vector<long long> num_games_by_moves;              //< Number of games with each number of moves (see add_game()).
+    std::vector<long long> lead_changes_by_moves;           //< Number of lead changes, summed over the games with each number of moves.
+    std::array<std::int64_t, NUM_SAMPLES> sample_accum;     //< Sum over all games of the absolute evaluation at each sample, in fixed point.
+
+    QualityCriteria();
+    void add_game(std::span<const double> evaluation_history);
+    void merge(const QualityCriteria& other);
+
+    double duration() const;
+    double lead_change() const;
+    double late_uncertainty() const;
+};
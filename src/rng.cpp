@@ -1,15 +1,59 @@
 #include <chrono>
+#include <cstdint>
 #include <random>
 
 #include "rng.hpp"
 
 /**
- * @brief Function that creates one instance of a global random number generator for use in all files, and then returns it.
- * @details Uses a Mersenne Twister from the standard library, seeded using the current time.
- * @return The random number generator instance.
+ * @brief Function that returns the calling thread's generator, without seeding it.
+ * @return A reference to the thread's generator instance.
  */
-std::mt19937_64& rng() {
-    static std::mt19937_64 rng;
-    rng.seed(std::chrono::system_clock::now().time_since_epoch().count());
+static Philox& thread_rng() {
+    thread_local Philox rng;
     return rng;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Flag recording whether the calling thread's generator has been seeded.
+ */
+static thread_local bool thread_rng_seeded = false;
+
+/**
+ * @brief Function that returns the calling thread's random number generator.
+ * @details Uses a counter-based Philox generator. Each thread has its own instance, which is positioned
+ * with seed_rng(). A thread that never calls seed_rng() uses the driver stream of a non-deterministic seed.
+ * @return The random number generator instance.
+ */
+Philox& rng() {
+    if (!thread_rng_seeded) {
+        seed_rng(random_seed(), DRIVER_STREAM);
+    }
+    return thread_rng();
+}
+
+/**
+ * @brief Function that moves the calling thread's random number generator to the start of a stream.
+ * @details This is an O(1) operation, so it is done before every game: game i of a trial uses stream i of
+ * the trial's seed. The values drawn during a game therefore do not depend on which thread runs the game
+ * or on which games that thread ran before, and any single game can be regenerated from its seed and index.
+ * @param seed A 64-bit integer representing the seed, e.g. as passed with the --seed command line option.
+ * @param stream A 64-bit integer identifying the stream.
+ */
+void seed_rng(std::uint64_t seed, std::uint64_t stream) {
+    thread_rng().seed(seed, stream);
+    thread_rng_seeded = true;
+}
+
+/**
+ * @brief Function that returns a non-deterministic seed.
+ * @details Combines the output of std::random_device with the current time, since std::random_device
+ * may be deterministic on some platforms.
+ * @return A 64-bit seed.
+ */
+std::uint64_t random_seed() {
+    std::random_device device;
+    const std::uint64_t entropy = (static_cast<std::uint64_t>(device()) << 32) ^ device();
+    const std::uint64_t time = static_cast<std::uint64_t>(std::chrono::system_clock::now().time_since_epoch().count());
+    const std::array<std::uint32_t, 4> mixed = Philox::block(entropy, time, 0);
+    return (static_cast<std::uint64_t>(mixed[0]) << 32) | mixed[1];
+}
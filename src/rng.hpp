@@ -1,8 +1,198 @@
 #pragma once
 
+#include <array>
+#include <cstdint>
+#include <limits>
 #include <random>
+#include <span>
+
+/**
+ * @class Philox rng.hpp "src/rng.hpp"
+ * @brief Counter-based random number generator (Philox4x32-10).
+ * @details Philox computes each block of four 32-bit outputs as a keyed bijection of a 128-bit counter,
+ * so any position in any stream can be generated in O(1) without generating the values before it. The key
+ * holds the seed of the trial, the upper half of the counter holds the stream (the index of the game being
+ * simulated), and the lower half of the counter holds the number of blocks drawn so far from the stream.
+ * The class satisfies the UniformRandomBitGenerator requirements, so it can be used with the distributions
+ * of the standard library. Dice are generated separately by fill_dice(), from a part of the counter space
+ * that operator() never reaches, so the dice of a game do not depend on how many other values were drawn.
+ * @attention Changing the round constants or the counter layout changes the games generated for every seed.
+ */
+class Philox {
+public:
+    using result_type = std::uint32_t;
+
+    /// @brief Default constructor, uses stream 0 of seed 0.
+    Philox() : Philox(0, 0) {};
+
+    /**
+     * @brief Constructor setting the seed and stream.
+     * @param seed A 64-bit integer representing the seed (the Philox key).
+     * @param stream A 64-bit integer identifying the stream.
+     */
+    Philox(std::uint64_t seed, std::uint64_t stream) {
+        this->seed(seed, stream);
+    }
+
+    /**
+     * @brief Moves the generator to the start of the given stream of the given seed.
+     * @param seed A 64-bit integer representing the seed (the Philox key).
+     * @param stream A 64-bit integer identifying the stream.
+     */
+    void seed(std::uint64_t seed, std::uint64_t stream) {
+        m_seed = seed;
+        m_stream = stream;
+        m_counter = 0;
+        m_index = m_buffer.size();
+    }
+
+    /**
+     * @brief Gets a generator for one of the sub-streams of the current stream.
+     * @details Sub-stream j starts at block (j + 1) << SUBSTREAM_SHIFT of the lower half of the counter, which
+     * operator() of the stream itself never reaches in practice, and is disjoint from the dice. The values drawn
+     * from a sub-stream therefore do not depend on how many values were drawn from the stream or its other sub-streams.
+     * @param index A 64-bit integer identifying the sub-stream, less than 2^15 - 1.
+     * @return A Philox object at the start of the sub-stream.
+     */
+    Philox substream(std::uint64_t index) const {
+        Philox result(m_seed, m_stream);
+        result.m_counter = (index + 1) << SUBSTREAM_SHIFT;
+        return result;
+    }
+
+    /**
+     * @brief Returns the next 32-bit output of the current stream.
+     * @return A uniformly distributed 32-bit unsigned integer.
+     */
+    result_type operator()() {
+        if (m_index == m_buffer.size()) {
+            m_buffer = block(m_seed, m_stream, m_counter++);
+            m_index = 0;
+        }
+        return m_buffer[m_index++];
+    }
+
+    /**
+     * @brief Fills a span with dice rolls from the dice sequence of the current stream.
+     * @details Die d of the sequence is computed from word d % 4 of block DICE_COUNTER_BIT | (d / 4) of the current
+     * stream, so any range of dice can be generated without generating the dice before it. Each 32-bit word w is
+     * mapped to 1 + floor(6 * w / 2^32) without rejection; the largest deviation from a fair die is below 2^-29.
+     * The loop computes each block independently of the others, which lets the compiler vectorize it.
+     * @param rolls A span of ints, each of which is set to a value between 1 and 6.
+     * @param first_die A 64-bit integer representing the index in the dice sequence of the first element of rolls.
+     */
+    void fill_dice(std::span<int> rolls, std::uint64_t first_die) const {
+        // Dice before the first block boundary
+        size_t i = 0;
+        for (; i < rolls.size() && ((first_die + i) & 3) != 0; ++i) {
+            const std::uint64_t d = first_die + i;
+            rolls[i] = to_die(block(m_seed, m_stream, DICE_COUNTER_BIT | (d >> 2))[d & 3]);
+        }
+
+        // Whole blocks
+        const std::uint64_t first_block = (first_die + i) >> 2;
+        const size_t num_blocks = (rolls.size() - i) / 4;
+        int* out = rolls.data() + i;
+        for (size_t b = 0; b < num_blocks; ++b) {
+            const std::array<std::uint32_t, 4> words = block(m_seed, m_stream, DICE_COUNTER_BIT | (first_block + b));
+            for (size_t j = 0; j < words.size(); ++j) {
+                out[4 * b + j] = to_die(words[j]);
+            }
+        }
+
+        // Dice after the last block boundary
+        for (i += 4 * num_blocks; i < rolls.size(); ++i) {
+            const std::uint64_t d = first_die + i;
+            rolls[i] = to_die(block(m_seed, m_stream, DICE_COUNTER_BIT | (d >> 2))[d & 3]);
+        }
+    }
+
+    /**
+     * @brief Computes the block of the dice sequence of a stream holding dice 4 * index to 4 * index + 3.
+     * @details Used to generate the dice of many games at once (see BatchGame), where each game has its own stream.
+     * @param seed A 64-bit integer representing the key.
+     * @param stream A 64-bit integer identifying the stream.
+     * @param index A 64-bit integer representing the index of the block within the dice sequence.
+     * @return An array of four 32-bit outputs, to be mapped to dice with to_die().
+     */
+    static constexpr std::array<std::uint32_t, 4> dice_block(std::uint64_t seed, std::uint64_t stream, std::uint64_t index) {
+        return block(seed, stream, DICE_COUNTER_BIT | index);
+    }
+
+    /**
+     * @brief Maps a 32-bit output to a die roll.
+     * @param word A 32-bit integer taken from a block of the dice sequence.
+     * @return An int between 1 and 6.
+     */
+    static constexpr int to_die(std::uint32_t word) {
+        return 1 + static_cast<int>((static_cast<std::uint64_t>(word) * 6) >> 32);
+    }
+
+    static constexpr result_type min() { return std::numeric_limits<result_type>::min(); }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    /**
+     * @brief Computes one block of the Philox4x32-10 function.
+     * @param seed A 64-bit integer representing the key.
+     * @param stream A 64-bit integer forming the upper half of the counter.
+     * @param counter A 64-bit integer forming the lower half of the counter.
+     * @return An array of four 32-bit outputs.
+     */
+    static constexpr std::array<std::uint32_t, 4> block(std::uint64_t seed, std::uint64_t stream, std::uint64_t counter) {
+        std::array<std::uint32_t, 4> ctr = {
+            static_cast<std::uint32_t>(counter), static_cast<std::uint32_t>(counter >> 32),
+            static_cast<std::uint32_t>(stream), static_cast<std::uint32_t>(stream >> 32)
+        };
+        std::uint32_t key_0 = static_cast<std::uint32_t>(seed);
+        std::uint32_t key_1 = static_cast<std::uint32_t>(seed >> 32);
+
+        for (int round = 0; round < 10; ++round) {
+            const std::uint64_t product_0 = static_cast<std::uint64_t>(0xD2511F53u) * ctr[0];
+            const std::uint64_t product_1 = static_cast<std::uint64_t>(0xCD9E8D57u) * ctr[2];
+            ctr = {
+                static_cast<std::uint32_t>(product_1 >> 32) ^ ctr[1] ^ key_0,
+                static_cast<std::uint32_t>(product_1),
+                static_cast<std::uint32_t>(product_0 >> 32) ^ ctr[3] ^ key_1,
+                static_cast<std::uint32_t>(product_0)
+            };
+            key_0 += 0x9E3779B9u;
+            key_1 += 0xBB67AE85u;
+        }
+
+        return ctr;
+    }
+
+protected:
+    /// @brief Bit of the lower half of the counter that is set for blocks holding dice.
+    static constexpr std::uint64_t DICE_COUNTER_BIT = std::uint64_t(1) << 63;
+
+    /// @brief Position in the lower half of the counter of the index of a sub-stream (see substream()).
+    static constexpr int SUBSTREAM_SHIFT = 48;
+
+    std::uint64_t m_seed;       //< The key of the generator.
+    std::uint64_t m_stream;     //< The upper half of the counter.
+    std::uint64_t m_counter;    //< The lower half of the counter, i.e. the index of the next block in the stream.
+    std::array<std::uint32_t, 4> m_buffer{};    //< The most recently computed block.
+    size_t m_index;             //< The index of the next unused output in m_buffer.
+};
+
+/**
+ * @brief Stream reserved for draws made outside of any game, e.g. by main().
+ * @details Game i of a trial uses stream i, so this is the one stream that no game can use.
+ */
+inline constexpr std::uint64_t DRIVER_STREAM = std::numeric_limits<std::uint64_t>::max();
 
 /**
  * @brief Function that returns a global random number generator for use in all files.
  */
-extern std::mt19937_64& rng();
\ No newline at end of file
+extern Philox& rng();
+
+/**
+ * @brief Function that moves the calling thread's random number generator to the start of a stream.
+ */
+void seed_rng(std::uint64_t seed, std::uint64_t stream);
+
+/**
+ * @brief Function that returns a non-deterministic seed for use with seed_rng().
+ */
+std::uint64_t random_seed();
@@ -0,0 +1,460 @@
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "game.hpp"
+#include "pool.hpp"
+#include "solitaire.hpp"
+
+/**
+ * @struct RowStateTables
+ * @brief Transitions of the states of a single row, generated at compile time.
+ */
+struct RowStateTables {
+    std::array<int, SolitaireTable::NUM_ROW_STATES> level;      //< Number of marks of each state, or 12 (more than any other state) if locked.
+    std::array<std::array<std::int8_t, GameConstants::NUM_CELLS_PER_ROW>, SolitaireTable::NUM_ROW_STATES> next;    //< State after marking each space, or -1 if it cannot be marked.
+    std::array<std::array<std::int8_t, GameConstants::NUM_CELLS_PER_ROW>, SolitaireTable::NUM_ROW_STATES> points;  //< Points scored by marking each space, including the mark of the lock.
+};
+
+/**
+ * @brief Row state transitions. States 1 to 55 hold the rightmost index r (0 to 9) and the number of marks c (1 to r + 1)
+ * as 1 + r * (r + 1) / 2 + (c - 1).
+ */
+static constexpr RowStateTables row_tables = [] {
+    RowStateTables tables{};
+    for (int s = 0; s < SolitaireTable::NUM_ROW_STATES; ++s) {
+        for (auto& next : tables.next[s]) {
+            next = -1;
+        }
+    }
+
+    tables.level[SolitaireTable::LOCKED_ROW] = static_cast<int>(GameConstants::NUM_CELLS_PER_ROW) + 1;
+    for (int rightmost = -1; rightmost < static_cast<int>(GameConstants::LOCK_INDEX); ++rightmost) {
+        for (int marks = (rightmost < 0 ? 0 : 1); marks <= rightmost + 1; ++marks) {
+            const int s = (rightmost < 0) ? SolitaireTable::EMPTY_ROW : 1 + rightmost * (rightmost + 1) / 2 + (marks - 1);
+            tables.level[s] = marks;
+
+            for (int j = rightmost + 1; j < static_cast<int>(GameConstants::NUM_CELLS_PER_ROW); ++j) {
+                if (j == static_cast<int>(GameConstants::LOCK_INDEX)) {
+                    if (marks >= GameConstants::MIN_MARKS_FOR_LOCK) {
+                        // Marking the lock also adds the mark of the lock itself
+                        tables.next[s][j] = SolitaireTable::LOCKED_ROW;
+                        tables.points[s][j] = static_cast<std::int8_t>(2 * marks + 3);
+                    }
+                }
+                else {
+                    tables.next[s][j] = static_cast<std::int8_t>(1 + j * (j + 1) / 2 + marks);
+                    tables.points[s][j] = static_cast<std::int8_t>(marks + 1);
+                }
+            }
+        }
+    }
+    return tables;
+}();
+
+/**
+ * @struct SolitaireFileHeader
+ * @brief Header at the start of a value table file.
+ */
+struct SolitaireFileHeader {
+    char magic[8];                  //< Identifies the file format.
+    std::uint32_t version;          //< Version of the file format.
+    std::uint32_t num_penalties;    //< Number of penalty counts in the table (MAX_PENALTIES).
+    std::uint64_t num_entries;      //< Number of values following the header.
+    std::uint64_t reserved;         //< Unused, keeps the values aligned.
+};
+
+static constexpr char SOLITAIRE_FILE_MAGIC[8] = {'Q', 'W', 'X', 'S', 'O', 'L', 'V', '\0'};
+static constexpr std::uint32_t SOLITAIRE_FILE_VERSION = 1;
+
+/**
+ * @brief Constructor taking ownership of a memory mapping of a value table file.
+ * @param map A pointer to the start of the mapping.
+ * @param map_size A size_t representing the size of the mapping, in bytes.
+ */
+SolitaireTable::SolitaireTable(void* map, std::size_t map_size)
+    : m_map(map),
+      m_map_size(map_size),
+      m_values(reinterpret_cast<const float*>(static_cast<const char*>(map) + sizeof(SolitaireFileHeader))) {}
+
+/**
+ * @brief Destructor, unmaps the file.
+ */
+SolitaireTable::~SolitaireTable() {
+    munmap(m_map, m_map_size);
+}
+
+/**
+ * @brief Gets the path of the value table used by agents.
+ * @return A string holding the value of the environment variable QWIXX_SOLITAIRE_TABLE if it is set, else solitaire_table.bin.
+ */
+std::string SolitaireTable::default_path() {
+    const char* path = std::getenv("QWIXX_SOLITAIRE_TABLE");
+    return (path != nullptr && path[0] != '\0') ? path : "solitaire_table.bin";
+}
+
+/**
+ * @brief Maps a value table file into memory.
+ * @details The file is mapped read-only and shared, so it is only read from disk once, however many agents use it.
+ * Tables are cached by path as long as one of them is in use, so all agents of a process share a single mapping.
+ * @param path A read-only reference to the path of a file written by solve().
+ * @return A shared pointer to the table.
+ * @throws std::runtime_error if the file cannot be opened or mapped, or is not a value table.
+ */
+std::shared_ptr<const SolitaireTable> SolitaireTable::load(const std::string& path) {
+    static std::mutex cache_mutex;
+    static std::map<std::string, std::weak_ptr<const SolitaireTable>> cache;
+
+    std::lock_guard<std::mutex> lock(cache_mutex);
+    if (auto table = cache[path].lock()) {
+        return table;
+    }
+
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Could not open the solitaire value table " + path + " (write it with --solve-solitaire).");
+    }
+
+    struct stat file_stat;
+    const std::size_t expected_size = sizeof(SolitaireFileHeader) + NUM_ENTRIES * sizeof(float);
+    if (fstat(fd, &file_stat) != 0 || static_cast<std::size_t>(file_stat.st_size) != expected_size) {
+        close(fd);
+        throw std::runtime_error("The solitaire value table " + path + " has the wrong size.");
+    }
+
+    void* map = mmap(nullptr, expected_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        throw std::runtime_error("Could not map the solitaire value table " + path + ".");
+    }
+
+    const auto* header = static_cast<const SolitaireFileHeader*>(map);
+    if (std::memcmp(header->magic, SOLITAIRE_FILE_MAGIC, sizeof(SOLITAIRE_FILE_MAGIC)) != 0 || header->version != SOLITAIRE_FILE_VERSION
+        || header->num_penalties != GameConstants::MAX_PENALTIES || header->num_entries != NUM_ENTRIES) {
+        munmap(map, expected_size);
+        throw std::runtime_error("The file " + path + " is not a solitaire value table of this version.");
+    }
+
+    std::shared_ptr<const SolitaireTable> table(new SolitaireTable(map, expected_size));
+    cache[path] = table;
+    return table;
+}
+
+/**
+ * @brief Gets the state of a row.
+ * @param row A uint16_t holding the bitmask of the marked spaces of the row.
+ * @param closed A bool which is true if the row has been locked by any player.
+ * @return An int representing the state of the row.
+ */
+int SolitaireTable::row_state(std::uint16_t row, bool closed) {
+    if (closed || ((row >> GameConstants::LOCK_INDEX) & 1)) {
+        return LOCKED_ROW;
+    }
+    if (row == 0) {
+        return EMPTY_ROW;
+    }
+    const int rightmost = std::bit_width(row) - 1;
+    return 1 + rightmost * (rightmost + 1) / 2 + (std::popcount(row) - 1);
+}
+
+/**
+ * @brief Gets the states of the rows of a player's scorepad.
+ * @details Rows locked by other players count as locked, since they can no longer be marked and bring the end of the game closer.
+ * @param scorepad A read-only reference to the scorepad of the player.
+ * @param state A read-only reference to the game state, used to find the locked rows.
+ * @return A Rows array holding the state of each row.
+ */
+SolitaireTable::Rows SolitaireTable::row_states(const Scorepad& scorepad, const State& state) {
+    Rows rows;
+    for (size_t i = 0; i < GameConstants::NUM_ROWS; ++i) {
+        rows[i] = row_state(scorepad.get_row_mask(static_cast<Color>(i)), state.locked_rows[i]);
+    }
+    return rows;
+}
+
+/**
+ * @brief Gets the state of a row after marking a space.
+ * @param row_state An int representing the state of the row.
+ * @param index A size_t representing the index of the space to mark.
+ * @return An int representing the new state of the row, or -1 if the space cannot be marked.
+ */
+int SolitaireTable::mark(int row_state, std::size_t index) {
+    return row_tables.next[row_state][index];
+}
+
+/**
+ * @brief Gets the points scored by marking a space.
+ * @param row_state An int representing the state of the row.
+ * @param index A size_t representing the index of the space to mark. The space must be markable.
+ * @return An int representing the increase in the score of the row, including the mark of the lock if the space is the lock.
+ */
+int SolitaireTable::mark_points(int row_state, std::size_t index) {
+    return row_tables.points[row_state][index];
+}
+
+/**
+ * @brief Checks whether the game has ended.
+ * @param rows A read-only reference to the states of the rows.
+ * @param penalties An int representing the number of penalties.
+ * @return A bool which is true if the player has MAX_PENALTIES penalties or two rows are locked.
+ */
+bool SolitaireTable::is_terminal(const Rows& rows, int penalties) {
+    return penalties >= GameConstants::MAX_PENALTIES || std::count(rows.begin(), rows.end(), LOCKED_ROW) >= 2;
+}
+
+/**
+ * @brief Gets the index of a position in the table.
+ * @details The red and yellow rows form an unordered pair, as do the green and blue rows, and the two pairs are unordered
+ * as well (see the class documentation). An unordered pair {a, b} with a <= b is indexed as b * (b + 1) / 2 + a.
+ * @param rows A read-only reference to the states of the rows.
+ * @param penalties An int representing the number of penalties, less than MAX_PENALTIES.
+ * @return A size_t representing the index of the value of the position.
+ */
+std::size_t SolitaireTable::entry_index(const Rows& rows, int penalties) {
+    auto pair_index = [](std::size_t a, std::size_t b) {
+        const std::size_t low = std::min(a, b);
+        const std::size_t high = std::max(a, b);
+        return high * (high + 1) / 2 + low;
+    };
+    const std::size_t top = pair_index(static_cast<std::size_t>(rows[0]), static_cast<std::size_t>(rows[1]));
+    const std::size_t bottom = pair_index(static_cast<std::size_t>(rows[2]), static_cast<std::size_t>(rows[3]));
+    return static_cast<std::size_t>(penalties) * NUM_ROW_KEYS + pair_index(top, bottom);
+}
+
+/**
+ * @brief Gets the optimal expected number of points still to be scored from a position.
+ * @param rows A read-only reference to the states of the rows.
+ * @param penalties An int representing the number of penalties.
+ * @return A double representing the expected future points (negative if penalties are expected to outweigh marks), 0 if the game has ended.
+ */
+double SolitaireTable::value(const Rows& rows, int penalties) const {
+    return is_terminal(rows, penalties) ? 0.0 : static_cast<double>(m_values[entry_index(rows, penalties)]);
+}
+
+/**
+ * @brief Computes the expected maximum of a constant and of independent random variables, one per row.
+ * @param base A double representing the constant.
+ * @param outcomes A reference to the values of each row's variable for each value of its die (all equally likely).
+ * Values of -infinity mean that nothing can be done with this die. Sorted in place.
+ * @return A double representing the expectation of the maximum.
+ */
+static double expected_max(double base, std::array<std::array<double, 6>, GameConstants::NUM_ROWS>& outcomes) {
+    std::array<double, 6 * GameConstants::NUM_ROWS> thresholds;
+    size_t num_thresholds = 0;
+    for (auto& row : outcomes) {
+        std::sort(row.begin(), row.end());
+        for (double outcome : row) {
+            if (outcome > base) {
+                thresholds[num_thresholds++] = outcome;
+            }
+        }
+    }
+    std::sort(thresholds.begin(), thresholds.begin() + num_thresholds);
+
+    // Probability that the maximum is at most v, for increasing v, using one pointer per row
+    std::array<size_t, GameConstants::NUM_ROWS> counts{};
+    auto cdf = [&](double v) {
+        double probability = 1.0;
+        for (size_t r = 0; r < GameConstants::NUM_ROWS; ++r) {
+            while (counts[r] < 6 && outcomes[r][counts[r]] <= v) {
+                ++counts[r];
+            }
+            probability *= static_cast<double>(counts[r]) / 6.0;
+        }
+        return probability;
+    };
+
+    double previous = cdf(base);
+    double expectation = base * previous;
+    for (size_t k = 0; k < num_thresholds; ++k) {
+        const double current = cdf(thresholds[k]);
+        expectation += thresholds[k] * (current - previous);
+        previous = current;
+    }
+    return expectation;
+}
+
+/**
+ * @brief Computes the optimal expected future points of a non-terminal position, from the values of the positions after it.
+ * @details For each roll of the white dice, the player chooses the best pair of actions knowing all dice. Taking the best
+ * pair is the same as taking the best of (a) the best first action followed by no second action (or the penalty, if
+ * neither action is used) and (b) for each row, the best first action followed by a second action in that row. Option (b)
+ * only depends on the die of that row, and the dice of the rows are independent, so the expectation over the colored dice
+ * is that of a maximum of independent variables, one per row. The points of a second action after each possible first
+ * action are computed once per position and reused for every roll.
+ * @param rows A read-only reference to the states of the rows.
+ * @param penalties An int representing the number of penalties.
+ * @param values A read-only reference to the table being computed, holding the values of all later positions.
+ * @return A double representing the expected future points.
+ */
+static double solve_position(const SolitaireTable::Rows& rows, int penalties, const std::vector<float>& values) {
+    constexpr double NONE = -std::numeric_limits<double>::infinity();
+    constexpr size_t NUM_CELLS = GameConstants::NUM_CELLS_PER_ROW;
+
+    auto lookup = [&](const SolitaireTable::Rows& r) {
+        return SolitaireTable::is_terminal(r, penalties) ? 0.0 : static_cast<double>(values[SolitaireTable::entry_index(r, penalties)]);
+    };
+
+    SolitaireTable::Rows penalty_rows = rows;
+    const double penalty_value = -GameConstants::PENALTY_VALUE
+        + (SolitaireTable::is_terminal(rows, penalties + 1) ? 0.0 : static_cast<double>(values[SolitaireTable::entry_index(penalty_rows, penalties + 1)]));
+
+    // Points plus future value of each second action, after no first action (0) or after marking row r at index j (1 + r * NUM_CELLS + j)
+    std::array<std::array<std::array<double, NUM_CELLS>, GameConstants::NUM_ROWS>, 1 + GameConstants::NUM_ROWS * NUM_CELLS> second;
+    std::array<bool, 1 + GameConstants::NUM_ROWS * NUM_CELLS> has_second{};
+    auto get_second = [&](size_t k, const SolitaireTable::Rows& rows_after_first) -> const auto& {
+        if (!has_second[k]) {
+            for (size_t r = 0; r < GameConstants::NUM_ROWS; ++r) {
+                for (size_t j = 0; j < NUM_CELLS; ++j) {
+                    const int next = SolitaireTable::mark(rows_after_first[r], j);
+                    if (next < 0) {
+                        second[k][r][j] = NONE;
+                        continue;
+                    }
+                    SolitaireTable::Rows rows_after_second = rows_after_first;
+                    rows_after_second[r] = next;
+                    second[k][r][j] = SolitaireTable::mark_points(rows_after_first[r], j) + lookup(rows_after_second);
+                }
+            }
+            has_second[k] = true;
+        }
+        return second[k];
+    };
+
+    double total = 0.0;
+    for (int white_1 = 1; white_1 <= 6; ++white_1) {
+        for (int white_2 = white_1; white_2 <= 6; ++white_2) {
+            const int white_sum = white_1 + white_2;
+            double base = NONE;
+            std::array<std::array<double, 6>, GameConstants::NUM_ROWS> outcomes;
+            for (auto& row : outcomes) {
+                row.fill(NONE);
+            }
+
+            // First action: none (row_1 = NUM_ROWS) or the white sum in row_1
+            for (size_t row_1 = 0; row_1 <= GameConstants::NUM_ROWS; ++row_1) {
+                SolitaireTable::Rows rows_after_first = rows;
+                double first_points = 0.0;
+                size_t k = 0;
+                if (row_1 < GameConstants::NUM_ROWS) {
+                    const size_t index_1 = sum_to_index_table[row_1][white_sum];
+                    const int next = SolitaireTable::mark(rows[row_1], index_1);
+                    if (next < 0) {
+                        continue;
+                    }
+                    first_points = SolitaireTable::mark_points(rows[row_1], index_1);
+                    rows_after_first[row_1] = next;
+                    k = 1 + row_1 * NUM_CELLS + index_1;
+
+                    // The game ends before the second action if this was the second lock
+                    if (SolitaireTable::is_terminal(rows_after_first, penalties)) {
+                        base = std::max(base, first_points);
+                        continue;
+                    }
+                    base = std::max(base, first_points + lookup(rows_after_first));
+                }
+                else {
+                    base = std::max(base, penalty_value);
+                }
+
+                const auto& second_points = get_second(k, rows_after_first);
+                for (size_t r = 0; r < GameConstants::NUM_ROWS; ++r) {
+                    if (rows_after_first[r] == SolitaireTable::LOCKED_ROW) {
+                        continue;
+                    }
+                    for (int die = 1; die <= 6; ++die) {
+                        const double best = std::max(second_points[r][sum_to_index_table[r][white_1 + die]],
+                                                     second_points[r][sum_to_index_table[r][white_2 + die]]);
+                        outcomes[r][die - 1] = std::max(outcomes[r][die - 1], first_points + best);
+                    }
+                }
+            }
+
+            total += ((white_1 == white_2) ? 1.0 : 2.0) * expected_max(base, outcomes);
+        }
+    }
+
+    return total / 36.0;
+}
+
+/**
+ * @brief Solves solitaire Qwixx and writes the value table to a file.
+ * @details Positions are grouped by level (the total number of marks, counting a locked row as 12, plus the number of
+ * penalties). Every turn raises the level, so the levels are solved from the highest to the lowest, and the positions
+ * of a level are spread over the workers of the pool.
+ * @param path A read-only reference to the path of the file to write.
+ * @param pool A reference to the WorkerPool used to solve the positions.
+ * @return A double representing the optimal expected score of a game, i.e. the value of the starting position.
+ * @throws std::runtime_error if the file cannot be written.
+ */
+double SolitaireTable::solve(const std::string& path, WorkerPool& pool) {
+    std::vector<float> values(NUM_ENTRIES, 0.0f);
+
+    // Rows of each class of symmetric rows, and the non-terminal entries of each level
+    std::vector<Rows> key_rows(NUM_ROW_KEYS);
+    const int max_level = static_cast<int>(GameConstants::NUM_ROWS) * row_tables.level[LOCKED_ROW] + GameConstants::MAX_PENALTIES;
+    std::vector<std::vector<std::uint32_t>> levels(static_cast<size_t>(max_level) + 1);
+    for (int a = 0; a < NUM_ROW_STATES; ++a) {
+        for (int b = a; b < NUM_ROW_STATES; ++b) {
+            for (int c = 0; c < NUM_ROW_STATES; ++c) {
+                for (int d = c; d < NUM_ROW_STATES; ++d) {
+                    const Rows rows = {a, b, c, d};
+                    const std::size_t key = entry_index(rows, 0);
+                    if (b * (b + 1) / 2 + a > d * (d + 1) / 2 + c || is_terminal(rows, 0)) {
+                        continue;
+                    }
+                    key_rows[key] = rows;
+                    const int level = row_tables.level[a] + row_tables.level[b] + row_tables.level[c] + row_tables.level[d];
+                    for (int p = 0; p < GameConstants::MAX_PENALTIES; ++p) {
+                        levels[level + p].push_back(static_cast<std::uint32_t>(entry_index(rows, p)));
+                    }
+                }
+            }
+        }
+    }
+
+    for (int level = max_level; level >= 0; --level) {
+        const std::vector<std::uint32_t>& entries = levels[level];
+        const std::int64_t chunk_size = 256;
+        std::atomic<std::int64_t> next_entry = 0;
+
+        pool.run(pool.size(), [&](unsigned int) {
+            for (std::int64_t begin = next_entry.fetch_add(chunk_size); begin < static_cast<std::int64_t>(entries.size()); begin = next_entry.fetch_add(chunk_size)) {
+                const std::int64_t end = std::min<std::int64_t>(static_cast<std::int64_t>(entries.size()), begin + chunk_size);
+                for (std::int64_t i = begin; i < end; ++i) {
+                    const std::uint32_t entry = entries[i];
+                    values[entry] = static_cast<float>(solve_position(key_rows[entry % NUM_ROW_KEYS], static_cast<int>(entry / NUM_ROW_KEYS), values));
+                }
+            }
+        });
+    }
+
+    SolitaireFileHeader header{};
+    std::memcpy(header.magic, SOLITAIRE_FILE_MAGIC, sizeof(SOLITAIRE_FILE_MAGIC));
+    header.version = SOLITAIRE_FILE_VERSION;
+    header.num_penalties = GameConstants::MAX_PENALTIES;
+    header.num_entries = NUM_ENTRIES;
+
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    file.write(reinterpret_cast<const char*>(values.data()), static_cast<std::streamsize>(values.size() * sizeof(float)));
+    if (!file) {
+        throw std::runtime_error("Could not write the solitaire value table " + path + ".");
+    }
+
+    const Rows start = {EMPTY_ROW, EMPTY_ROW, EMPTY_ROW, EMPTY_ROW};
+    return static_cast<double>(values[entry_index(start, 0)]);
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+#include "globals.hpp"
+
+class Scorepad;
+struct State;
+class WorkerPool;
+
+/**
+ * @class SolitaireTable solitaire.hpp "src/solitaire.hpp"
+ * @brief Optimal expected future score of every position of solitaire Qwixx, read from a memory-mapped file.
+ * @details In solitaire Qwixx, a single player is active on every turn: all six dice are rolled, the player may mark
+ * the sum of the white dice in any row (first action), then the sum of a white die and a colored die in the row of that
+ * color (second action), and takes a penalty if neither action was used. The game ends with the fourth penalty or the
+ * second lock. The future score of a player only depends on, for each row, the rightmost marked space and the number of
+ * marks (or whether the row is locked), and on the number of penalties. Each row therefore has NUM_ROW_STATES states: empty,
+ * one of the 55 pairs (rightmost index 0 to 9, 1 to rightmost index + 1 marks), or locked.
+ *
+ * The game is unchanged by swapping the red and yellow rows (and dice), by swapping the green and blue rows, and by swapping
+ * the top rows with the bottom rows while replacing each die value v with 7 - v. Positions are therefore stored once per
+ * class of symmetric positions: the rows are indexed as an unordered pair of unordered pairs of row states, which
+ * divides the number of entries by almost 8. The file holds a short header followed by one float per entry, the optimal
+ * expected number of points still to be scored (including penalties), for penalties 0 to MAX_PENALTIES - 1.
+ * Entries of positions where the game has ended (two rows locked) are 0.
+ *
+ * The table is built by solve(), which runs a backward induction from the positions closest to the end of the game. Every
+ * turn either marks a space or adds a penalty, so each position only depends on positions with more marks or penalties, and
+ * the positions of each level can be solved in parallel.
+ */
+class SolitaireTable {
+public:
+    static constexpr int NUM_ROW_STATES = 57;                       //< Number of states of a single row.
+    static constexpr int EMPTY_ROW = 0;                             //< State of a row without marks.
+    static constexpr int LOCKED_ROW = NUM_ROW_STATES - 1;           //< State of a row that has been locked (or closed).
+    static constexpr std::size_t NUM_ROW_PAIRS = NUM_ROW_STATES * (NUM_ROW_STATES + 1) / 2;        //< Number of unordered pairs of row states.
+    static constexpr std::size_t NUM_ROW_KEYS = NUM_ROW_PAIRS * (NUM_ROW_PAIRS + 1) / 2;           //< Number of classes of symmetric rows.
+    static constexpr std::size_t NUM_ENTRIES = NUM_ROW_KEYS * GameConstants::MAX_PENALTIES;        //< Number of values in the table.
+
+    /// @brief States of the four rows, in the order of the Color enum.
+    using Rows = std::array<int, GameConstants::NUM_ROWS>;
+
+    ~SolitaireTable();
+
+    SolitaireTable(const SolitaireTable&) = delete;
+    SolitaireTable& operator=(const SolitaireTable&) = delete;
+
+    static std::shared_ptr<const SolitaireTable> load(const std::string& path);
+    static double solve(const std::string& path, WorkerPool& pool);
+    static std::string default_path();
+
+    double value(const Rows& rows, int penalties) const;
+
+    static int row_state(std::uint16_t row, bool closed);
+    static Rows row_states(const Scorepad& scorepad, const State& state);
+    static int mark(int row_state, std::size_t index);
+    static int mark_points(int row_state, std::size_t index);
+    static bool is_terminal(const Rows& rows, int penalties);
+    static std::size_t entry_index(const Rows& rows, int penalties);
+
+protected:
+    SolitaireTable(void* map, std::size_t map_size);
+
+    void* m_map;                //< Start of the memory mapping of the file.
+    std::size_t m_map_size;     //< Size of the memory mapping, in bytes.
+    const float* m_values;      //< Values of the table, inside the mapping.
+};
@@ -0,0 +1,339 @@
+#include <algorithm>
+#include <cmath>
+#include <exception>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+
+#include "batch.hpp"
+#include "game.hpp"
+#include "rng.hpp"
+#include "tournament.hpp"
+
+/**
+ * @brief Computes a matrix comparing each pair of agents over the tables at which both were seated.
+ * @param data A read-only reference to the TournamentData object.
+ * @param use_scores A bool selecting the final scores (if true) or the wins (if false) of the agents.
+ * @return A matrix whose entry [i][j] is the average per game of the wins or scores of agent i, over the games at
+ * tables where agents i and j were both seated. Entries without such tables, including the diagonal, are NaN.
+ */
+static std::vector<std::vector<double>> pair_matrix(const TournamentData& data, bool use_scores) {
+    const size_t num_agents = data.agent_ids.size();
+    std::vector<std::vector<double>> sum(num_agents, std::vector<double>(num_agents, 0.0));
+    std::vector<std::vector<double>> num_games(num_agents, std::vector<double>(num_agents, 0.0));
+
+    for (size_t t = 0; t < data.tables.size(); ++t) {
+        const std::vector<size_t>& table = data.tables[t];
+        for (size_t a = 0; a < table.size(); ++a) {
+            const double value = use_scores ? static_cast<double>(data.results[t].score_accum[a]) : data.results[t].get_num_wins(a);
+            for (size_t b = 0; b < table.size(); ++b) {
+                if (a != b) {
+                    sum[table[a]][table[b]] += value;
+                    num_games[table[a]][table[b]] += data.games_per_table;
+                }
+            }
+        }
+    }
+
+    for (size_t i = 0; i < num_agents; ++i) {
+        for (size_t j = 0; j < num_agents; ++j) {
+            sum[i][j] = (num_games[i][j] > 0) ? sum[i][j] / num_games[i][j] : std::numeric_limits<double>::quiet_NaN();
+        }
+    }
+
+    return sum;
+}
+
+/**
+ * @brief Computes the win rate of each agent against each other agent.
+ * @details For 2-player tables, entry [i][j] is the win rate of agent i against agent j. At larger tables, it is the win
+ * rate of agent i over all games in which agent j was one of its opponents. Ties count as a fraction of a win.
+ * @return A matrix of doubles, with NaN on the diagonal.
+ */
+std::vector<std::vector<double>> TournamentData::win_rate_matrix() const {
+    return pair_matrix(*this, false);
+}
+
+/**
+ * @brief Computes the average score of each agent against each other agent.
+ * @details Entry [i][j] is the average final score of agent i over all games in which agent j was one of its opponents.
+ * @return A matrix of doubles, with NaN on the diagonal.
+ */
+std::vector<std::vector<double>> TournamentData::average_score_matrix() const {
+    return pair_matrix(*this, true);
+}
+
+/**
+ * @brief Computes the win rate of each agent over all of its games.
+ * @return A vector of doubles holding the win rate of each agent, where ties count as a fraction of a win.
+ */
+std::vector<double> TournamentData::win_rates() const {
+    std::vector<double> wins(agent_ids.size(), 0.0);
+    std::vector<double> num_games(agent_ids.size(), 0.0);
+    for (size_t t = 0; t < tables.size(); ++t) {
+        for (size_t a = 0; a < tables[t].size(); ++a) {
+            wins[tables[t][a]] += results[t].get_num_wins(a);
+            num_games[tables[t][a]] += games_per_table;
+        }
+    }
+
+    for (size_t i = 0; i < wins.size(); ++i) {
+        wins[i] /= num_games[i];
+    }
+    return wins;
+}
+
+/**
+ * @brief Computes the average final score of each agent over all of its games.
+ * @return A vector of doubles holding the average score of each agent.
+ */
+std::vector<double> TournamentData::average_scores() const {
+    std::vector<double> scores(agent_ids.size(), 0.0);
+    std::vector<double> num_games(agent_ids.size(), 0.0);
+    for (size_t t = 0; t < tables.size(); ++t) {
+        for (size_t a = 0; a < tables[t].size(); ++a) {
+            scores[tables[t][a]] += static_cast<double>(results[t].score_accum[a]);
+            num_games[tables[t][a]] += games_per_table;
+        }
+    }
+
+    for (size_t i = 0; i < scores.size(); ++i) {
+        scores[i] /= num_games[i];
+    }
+    return scores;
+}
+
+/**
+ * @brief Fits a rating to each agent from the results of all tables.
+ * @details The model is that of Bradley-Terry, extended to tables of more than 2 players: agent i has a strength
+ * gamma_i, and wins a game at a table T with probability gamma_i / (sum of gamma_j over the agents j at T). The
+ * strengths are found by maximum likelihood with the minorization-maximization iteration of Hunter (2004), where
+ * each tie counts as a fraction of a win, as in TrialData. So that agents that never (or always) win still get a
+ * finite rating, each agent is also given a prior of 1 win in 2 games against a virtual agent of strength 1.
+ * The ratings are given on the Elo scale, 400 * log10(gamma_i), shifted so that their average is 0: an agent rated
+ * 400 points above another is expected to win 10 times as often in a game between the two.
+ * @return A vector of doubles holding the rating of each agent.
+ */
+std::vector<double> TournamentData::ratings() const {
+    const size_t num_agents = agent_ids.size();
+    std::vector<double> wins(num_agents, 0.0);
+    for (size_t t = 0; t < tables.size(); ++t) {
+        for (size_t a = 0; a < tables[t].size(); ++a) {
+            wins[tables[t][a]] += results[t].get_num_wins(a);
+        }
+    }
+
+    std::vector<double> gamma(num_agents, 1.0);
+    std::vector<double> denominator(num_agents, 0.0);
+    const int max_iterations = 100000;
+    const double tolerance = 1e-12;
+    for (int iteration = 0; iteration < max_iterations; ++iteration) {
+        // Prior: 2 games against an agent of strength 1
+        for (size_t i = 0; i < num_agents; ++i) {
+            denominator[i] = 2.0 / (gamma[i] + 1.0);
+        }
+
+        for (const auto& table : tables) {
+            double table_strength = 0.0;
+            for (size_t i : table) {
+                table_strength += gamma[i];
+            }
+            for (size_t i : table) {
+                denominator[i] += games_per_table / table_strength;
+            }
+        }
+
+        double max_change = 0.0;
+        for (size_t i = 0; i < num_agents; ++i) {
+            const double updated = (wins[i] + 1.0) / denominator[i];
+            max_change = std::max(max_change, std::abs(std::log(updated / gamma[i])));
+            gamma[i] = updated;
+        }
+
+        if (max_change < tolerance) {
+            break;
+        }
+    }
+
+    std::vector<double> elo(num_agents, 0.0);
+    double mean = 0.0;
+    for (size_t i = 0; i < num_agents; ++i) {
+        elo[i] = 400.0 * std::log10(gamma[i]);
+        mean += elo[i] / static_cast<double>(num_agents);
+    }
+    for (double& rating : elo) {
+        rating -= mean;
+    }
+
+    return elo;
+}
+
+/**
+ * @brief Runs a round-robin tournament: the same number of games at every table of table_size distinct agents.
+ * @details Every table is split into tasks of a few games, which are handed out to the workers of the pool by a
+ * WorkStealingRanges object. Tables of slow agents (e.g. Computational) and of fast ones (e.g. Random) therefore
+ * keep all workers busy until the very end. A worker keeps the agents (or the BatchGame object) of the table it is
+ * playing, and only rebuilds them when its next task belongs to another table. With the batch engine, a worker
+ * playing a table supported by BatchGame keeps refilling the lanes with the games of its next tasks, as long as they
+ * belong to the same table. The results of each task are merged into the results of its table under a lock.
+ * Game g of every table uses stream g of the seed, like game g of run_trial(), so the results of each table are those
+ * of a trial of the same agents with the same seed, and they do not depend on the number of threads or the engine.
+ * @param agent_ids A read-only vector of ints holding the distinct agent numbers, as accepted by get_players(). The
+ * Human agent is not allowed.
+ * @param table_size A size_t representing the number of players at each table, between 2 and 5.
+ * @param games_per_table An int representing the number of games played at each table.
+ * @param pool A reference to the WorkerPool running the games.
+ * @param engine An Engine enum selecting how the games are simulated.
+ * @param seed A 64-bit integer representing the seed of the tournament.
+ * @return A TournamentData object holding the results of all tables.
+ */
+TournamentData run_tournament(const std::vector<int>& agent_ids, size_t table_size, int games_per_table, WorkerPool& pool,
+                              Engine engine, std::uint64_t seed) {
+    if (table_size < 2 || table_size > 5 || table_size > agent_ids.size()) {
+        throw std::runtime_error("Invalid table size for the tournament.");
+    }
+    if (games_per_table < 1) {
+        throw std::runtime_error("Invalid number of games per table for the tournament.");
+    }
+
+    TournamentData data;
+    data.agent_ids = agent_ids;
+    data.games_per_table = games_per_table;
+
+    std::vector<int> all_inputs = {games_per_table, 0};
+    all_inputs.insert(all_inputs.end(), agent_ids.begin(), agent_ids.end());
+    if (is_human_active(all_inputs, 23)) {
+        throw std::runtime_error("The Human agent cannot take part in a tournament.");
+    }
+    for (const auto& player : get_players(all_inputs)) {
+        data.agent_names.push_back(std::get<1>(player));
+    }
+
+    // Enumerate the tables in lexicographic order
+    std::vector<size_t> table(table_size);
+    for (size_t i = 0; i < table_size; ++i) {
+        table[i] = i;
+    }
+    while (true) {
+        data.tables.push_back(table);
+
+        size_t k = table_size;
+        while (k > 0 && table[k - 1] == agent_ids.size() - table_size + k - 1) {
+            --k;
+        }
+        if (k == 0) {
+            break;
+        }
+        ++table[k - 1];
+        for (size_t i = k; i < table_size; ++i) {
+            table[i] = table[i - 1] + 1;
+        }
+    }
+
+    const size_t num_tables = data.tables.size();
+    data.results.assign(num_tables, TrialData(table_size, false));
+    std::vector<std::mutex> result_mutexes(num_tables);
+
+    // Number of games in each task. Small enough that the slowest tables are spread over several workers,
+    // large enough that handing out tasks costs nothing next to playing them.
+    const std::int64_t task_size = 64;
+    const std::int64_t tasks_per_table = (games_per_table + task_size - 1) / task_size;
+    WorkStealingRanges tasks(pool.size(), static_cast<std::int64_t>(num_tables) * tasks_per_table);
+    std::vector<std::exception_ptr> worker_errors(pool.size(), nullptr);
+
+    auto worker = [&](unsigned int worker_index) {
+        try {
+            // State of the table this worker is playing
+            std::int64_t current_table = -1;
+            std::vector<int> inputs;
+            std::vector<std::tuple<std::unique_ptr<Agent>, std::string>> players;
+            std::unique_ptr<Game> game;
+            std::unique_ptr<BatchGame> batch;
+            GameData stats;
+
+            std::int64_t task = 0;
+            bool has_task = tasks.next(worker_index, task);
+            while (has_task) {
+                const std::int64_t t = task / tasks_per_table;
+                std::int64_t begin = (task % tasks_per_table) * task_size;
+                std::int64_t end = std::min<std::int64_t>(games_per_table, begin + task_size);
+
+                if (t != current_table) {
+                    current_table = t;
+                    inputs = {games_per_table, 0};
+                    for (size_t i : data.tables[t]) {
+                        inputs.push_back(agent_ids[i]);
+                    }
+                    game.reset();
+                    batch.reset();
+                }
+                const std::vector<int> table_ids(inputs.begin() + 2, inputs.end());
+
+                TrialData local(table_size, false);
+                if (engine == Engine::Batch && BatchGame::supports(table_ids)) {
+                    if (!batch) {
+                        batch = std::make_unique<BatchGame>(table_ids, seed, false);
+                    }
+
+                    // Keep claiming games from this worker's next tasks for as long as they belong to the same table
+                    bool table_done = false;
+                    has_task = false;
+                    auto claim_game = [&]() {
+                        while (!table_done && begin == end) {
+                            if (!tasks.next(worker_index, task)) {
+                                table_done = true;
+                            }
+                            else if (task / tasks_per_table != t) {
+                                table_done = true;
+                                has_task = true;
+                            }
+                            else {
+                                begin = (task % tasks_per_table) * task_size;
+                                end = std::min<std::int64_t>(games_per_table, begin + task_size);
+                            }
+                        }
+                        return table_done ? -1 : static_cast<int>(begin++);
+                    };
+                    batch->run(claim_game, [&](int, const GameData& game_stats) {
+                        local.add_game(game_stats);
+                    });
+                }
+                else {
+                    if (!game) {
+                        players = get_players(inputs);
+                        std::vector<Agent*> player_ptrs;
+                        for (const auto& player : players) {
+                            player_ptrs.push_back(std::get<0>(player).get());
+                        }
+                        game = std::make_unique<Game>(player_ptrs, false, false);
+                    }
+
+                    for (std::int64_t i = begin; i < end; ++i) {
+                        seed_rng(seed, static_cast<std::uint64_t>(i));
+                        game->reset();
+                        game->run(stats);
+                        local.add_game(stats);
+                    }
+                    has_task = tasks.next(worker_index, task);
+                }
+
+                std::lock_guard<std::mutex> lock(result_mutexes[t]);
+                data.results[t].merge(local);
+            }
+        }
+        catch (...) {
+            worker_errors[worker_index] = std::current_exception();
+        }
+    };
+
+    pool.run(pool.size(), worker);
+
+    for (const auto& error : worker_errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    return data;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "pool.hpp"
+#include "trial.hpp"
+
+/**
+ * @struct TournamentData tournament.hpp "src/tournament.hpp"
+ * @brief Holds the results of a round-robin tournament.
+ * @details A tournament plays the same number of games at every table of table_size distinct agents drawn from a
+ * list of agents, with the agents seated in the order of the list. The results of each table are kept as a TrialData
+ * object, from which the matrices and ratings comparing the agents are computed.
+ */
+struct TournamentData {
+    std::vector<int> agent_ids;                 //< Agent numbers, as accepted by get_players().
+    std::vector<std::string> agent_names;       //< Name of each agent.
+    std::vector<std::vector<size_t>> tables;    //< Agents seated at each table, as indices into agent_ids.
+    std::vector<TrialData> results;             //< Results of each table, with the players in seat order.
+    int games_per_table;                        //< Number of games played at each table.
+
+    std::vector<std::vector<double>> win_rate_matrix() const;
+    std::vector<std::vector<double>> average_score_matrix() const;
+    std::vector<double> win_rates() const;
+    std::vector<double> average_scores() const;
+    std::vector<double> ratings() const;
+};
+
+TournamentData run_tournament(const std::vector<int>& agent_ids, size_t table_size, int games_per_table, WorkerPool& pool,
+                              Engine engine, std::uint64_t seed);
@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <bit>
+
+#include "transposition.hpp"
+
+/**
+ * @brief Constructor creating an empty table.
+ * @param log2_buckets An unsigned int representing the base-2 logarithm of the number of buckets. Each bucket takes
+ * up 32 bytes.
+ */
+TranspositionTable::TranspositionTable(unsigned int log2_buckets)
+    : m_buckets(std::make_unique<Bucket[]>(std::size_t(1) << log2_buckets)),
+      m_bucket_mask((std::uint64_t(1) << log2_buckets) - 1),
+      m_generation(1),
+      m_probes(0),
+      m_hits(0),
+      m_stores(0),
+      m_replacements(0) {}
+
+/**
+ * @brief Starts a new search, after which no entry of an earlier search matches.
+ * @details Takes constant time, except once every MAX_GENERATION searches, when the table is cleared.
+ * @attention Must not be called while other threads are using the table.
+ */
+void TranspositionTable::new_search() {
+    if (m_generation.load(std::memory_order_relaxed) == MAX_GENERATION) {
+        clear();
+        return;
+    }
+    m_generation.fetch_add(1, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Empties the table and resets the counters.
+ * @attention Must not be called while other threads are using the table.
+ */
+void TranspositionTable::clear() {
+    for (std::uint64_t b = 0; b <= m_bucket_mask; ++b) {
+        for (Slot& slot : m_buckets[b].slots) {
+            slot.check.store(0, std::memory_order_relaxed);
+            slot.data.store(0, std::memory_order_relaxed);
+        }
+    }
+    m_generation.store(1, std::memory_order_relaxed);
+    m_probes.store(0, std::memory_order_relaxed);
+    m_hits.store(0, std::memory_order_relaxed);
+    m_stores.store(0, std::memory_order_relaxed);
+    m_replacements.store(0, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Looks up the value of a position.
+ * @param key A 64-bit integer representing the hash of the position.
+ * @param depth An int representing the depth the value is needed for. Values searched deeper are returned too.
+ * @return A double option holding the value stored for the position in the current search, or the null option if there is none.
+ */
+std::optional<double> TranspositionTable::probe(std::uint64_t key, int depth) {
+    m_probes.fetch_add(1, std::memory_order_relaxed);
+    const std::uint32_t generation = m_generation.load(std::memory_order_relaxed);
+    for (const Slot& slot : m_buckets[key & m_bucket_mask].slots) {
+        const std::uint64_t data = slot.data.load(std::memory_order_relaxed);
+        const std::uint64_t check = slot.check.load(std::memory_order_relaxed);
+        if ((check ^ data) == key && unpack_generation(data) == generation && unpack_depth(data) >= depth) {
+            m_hits.fetch_add(1, std::memory_order_relaxed);
+            return unpack_value(data);
+        }
+    }
+    return std::nullopt;
+}
+
+/**
+ * @brief Stores the value of a position, following the replacement policy described in the class documentation.
+ * @param key A 64-bit integer representing the hash of the position.
+ * @param depth An int representing the depth the value was searched to, between 0 and 255.
+ * @param value A double representing the value. It is stored as a float.
+ */
+void TranspositionTable::store(std::uint64_t key, int depth, double value) {
+    m_stores.fetch_add(1, std::memory_order_relaxed);
+    const std::uint32_t generation = m_generation.load(std::memory_order_relaxed);
+    std::array<Slot, 2>& slots = m_buckets[key & m_bucket_mask].slots;
+
+    // Lambda to write an entry into a slot, counting the replacement of a live entry of another key
+    auto write = [&](Slot& slot, std::uint64_t old_data, bool same_key) {
+        if (!same_key && old_data != 0 && unpack_generation(old_data) == generation) {
+            m_replacements.fetch_add(1, std::memory_order_relaxed);
+        }
+        const std::uint64_t data = pack(depth, generation, value);
+        slot.data.store(data, std::memory_order_relaxed);
+        slot.check.store(key ^ data, std::memory_order_relaxed);
+    };
+
+    std::array<std::uint64_t, 2> old_data;
+    for (size_t s = 0; s < slots.size(); ++s) {
+        old_data[s] = slots[s].data.load(std::memory_order_relaxed);
+        const bool same_key = (slots[s].check.load(std::memory_order_relaxed) ^ old_data[s]) == key;
+        if (same_key) {
+            // Keep the deeper value of the current search
+            if (unpack_generation(old_data[s]) != generation || unpack_depth(old_data[s]) <= depth) {
+                write(slots[s], old_data[s], true);
+            }
+            return;
+        }
+    }
+
+    const bool first_slot_stale = unpack_generation(old_data[0]) != generation;
+    if (first_slot_stale || unpack_depth(old_data[0]) <= depth) {
+        write(slots[0], old_data[0], false);
+    }
+    else {
+        write(slots[1], old_data[1], false);
+    }
+}
+
+/**
+ * @brief Gets the counters of the table.
+ * @return The Statistics of the table.
+ */
+TranspositionTable::Statistics TranspositionTable::statistics() const {
+    return {m_probes.load(std::memory_order_relaxed), m_hits.load(std::memory_order_relaxed),
+            m_stores.load(std::memory_order_relaxed), m_replacements.load(std::memory_order_relaxed)};
+}
+
+/**
+ * @brief Packs an entry into a data word.
+ * @details The value takes up the low 32 bits, as a float, the depth the next 8 bits, and the generation the high 24 bits.
+ * @return A 64-bit integer representing the data word.
+ */
+std::uint64_t TranspositionTable::pack(int depth, std::uint32_t generation, double value) {
+    const std::uint32_t value_bits = std::bit_cast<std::uint32_t>(static_cast<float>(value));
+    const std::uint64_t depth_bits = static_cast<std::uint64_t>(std::clamp(depth, 0, 255));
+    return static_cast<std::uint64_t>(value_bits) | (depth_bits << 32) | (static_cast<std::uint64_t>(generation) << 40);
+}
+
+/// @brief Unpacks the depth of a data word.
+int TranspositionTable::unpack_depth(std::uint64_t data) {
+    return static_cast<int>((data >> 32) & 0xFF);
+}
+
+/// @brief Unpacks the generation of a data word.
+std::uint32_t TranspositionTable::unpack_generation(std::uint64_t data) {
+    return static_cast<std::uint32_t>(data >> 40);
+}
+
+/// @brief Unpacks the value of a data word.
+double TranspositionTable::unpack_value(std::uint64_t data) {
+    return static_cast<double>(std::bit_cast<float>(static_cast<std::uint32_t>(data)));
+}
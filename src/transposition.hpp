@@ -0,0 +1,81 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+/**
+ * @class TranspositionTable transposition.hpp "src/transposition.hpp"
+ * @brief A fixed-size table of search values keyed by position hash (see State::key()), which any number of threads
+ * can read and write at the same time without locks.
+ * @details The table has 2^log2_buckets buckets of two slots, and a key goes to the bucket given by its low bits. Each
+ * slot holds two 64-bit atomic words: the data (the value as a float, the depth it was searched to, and the search
+ * generation) and the key XOR the data. A slot matches a key if the XOR of its words gives back the key, so an entry
+ * torn by two threads writing the same slot at once does not match any key, and is simply lost, as in the lockless
+ * hashing scheme of Hyatt and Mann.
+ *
+ * Replacement policy: the first slot of a bucket keeps the deepest entry, and is only replaced by an entry searched at
+ * least as deep, or once its entry is from an earlier search. The second slot takes every other entry. A new key thus
+ * never fails to be stored, while expensive entries survive the many shallow ones. Entries from earlier searches never
+ * match: new_search() moves to the next generation, which empties the table without touching its memory.
+ *
+ * The counters of probes, hits, stores, and replacements of entries of the current search are updated with relaxed
+ * atomic increments, so they are exact once all threads using the table have finished.
+ */
+class TranspositionTable {
+public:
+    /**
+     * @struct Statistics
+     * @brief Counts of the operations on a table since it was created or last cleared.
+     */
+    struct Statistics {
+        std::uint64_t probes;           //< Calls to probe().
+        std::uint64_t hits;             //< Calls to probe() that found a value.
+        std::uint64_t stores;           //< Calls to store().
+        std::uint64_t replacements;     //< Calls to store() that overwrote an entry of the current search with another key.
+
+        /// @brief Gets the fraction of probes that found a value, or 0 if there were none.
+        double hit_rate() const { return probes == 0 ? 0.0 : static_cast<double>(hits) / static_cast<double>(probes); }
+    };
+
+    explicit TranspositionTable(unsigned int log2_buckets);
+
+    TranspositionTable(const TranspositionTable&) = delete;
+    TranspositionTable& operator=(const TranspositionTable&) = delete;
+
+    void new_search();
+    void clear();
+    std::optional<double> probe(std::uint64_t key, int depth);
+    void store(std::uint64_t key, int depth, double value);
+    Statistics statistics() const;
+
+protected:
+    /// @brief Largest generation that fits in the data word. The table is cleared when the generation wraps around.
+    static constexpr std::uint32_t MAX_GENERATION = (1u << 24) - 1;
+
+    /// @brief One entry: the key XOR the data, and the data.
+    struct Slot {
+        std::atomic<std::uint64_t> check;
+        std::atomic<std::uint64_t> data;
+    };
+
+    /// @brief Two slots sharing a key's bucket. Aligned so that a bucket never straddles two cache lines.
+    struct alignas(32) Bucket {
+        std::array<Slot, 2> slots;
+    };
+
+    std::unique_ptr<Bucket[]> m_buckets;        //< The buckets of the table.
+    std::uint64_t m_bucket_mask;                //< Number of buckets minus 1.
+    std::atomic<std::uint32_t> m_generation;    //< Generation of the current search, from 1 to MAX_GENERATION.
+    std::atomic<std::uint64_t> m_probes;        //< See Statistics.
+    std::atomic<std::uint64_t> m_hits;          //< See Statistics.
+    std::atomic<std::uint64_t> m_stores;        //< See Statistics.
+    std::atomic<std::uint64_t> m_replacements;  //< See Statistics.
+
+    static std::uint64_t pack(int depth, std::uint32_t generation, double value);
+    static int unpack_depth(std::uint64_t data);
+    static std::uint32_t unpack_generation(std::uint64_t data);
+    static double unpack_value(std::uint64_t data);
+};
@@ -0,0 +1,678 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <exception>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+
+#include "agent.hpp"
+#include "batch.hpp"
+#include "game.hpp"
+#include "pool.hpp"
+#include "rng.hpp"
+#include "trial.hpp"
+
+/**
+ * @brief Default constructor.
+ * @details Zeroes the accumulators for each player. The minimum and maximum number of turns
+ * are initialized to the extreme values of an int, so that the first game added always replaces them.
+ * @param num_players A size_t representing the number of players in each game of the trial.
+ * @param use_evaluation A bool indicating whether the games use the evaluation function.
+ */
+TrialData::TrialData(size_t num_players, bool use_evaluation)
+    : win_shares_accum(num_players, 0),
+      score_accum(num_players, 0),
+      num_games(0),
+      num_turns_accum(0),
+      min_turns(std::numeric_limits<int>::max()),
+      max_turns(std::numeric_limits<int>::min()),
+      use_evaluation(use_evaluation) {}
+
+/**
+ * @brief Adds the results of a single game to the accumulators.
+ * @details Each winner receives 1 / (number of winners) wins, so that ties are split evenly. The wins are
+ * counted in integer shares of WIN_SHARE_DENOMINATOR, so that the totals do not depend on the order in which
+ * games are added or merged.
+ * @param data A read-only reference to the GameData object returned by Game::run().
+ */
+void TrialData::add_game(const GameData& data) {
+    // Add wins and scores for each player to the relevant accumulators
+    for (size_t j = 0; j < win_shares_accum.size(); ++j) {
+        if (std::find(data.winners.begin(), data.winners.end(), j) != data.winners.end()) {
+            win_shares_accum[j] += WIN_SHARE_DENOMINATOR / static_cast<long long>(data.winners.size());
+        }
+
+        score_accum[j] += data.final_score[j];
+    }
+
+    ++num_games;
+
+    // Update the accumulator for the number of turns, as well as the minimum and maximum numbers of turns, if applicable
+    num_turns_accum += data.num_turns;
+    min_turns = std::min(min_turns, data.num_turns);
+    max_turns = std::max(max_turns, data.num_turns);
+
+    if (use_evaluation) {
+        quality.add_game(data.p0_evaluation_history);
+    }
+}
+
+/**
+ * @brief Merges the accumulators of another TrialData object into this one.
+ * @param other A read-only reference to the TrialData object to merge. Must have the same number of players.
+ */
+void TrialData::merge(const TrialData& other) {
+    for (size_t j = 0; j < win_shares_accum.size(); ++j) {
+        win_shares_accum[j] += other.win_shares_accum[j];
+        score_accum[j] += other.score_accum[j];
+    }
+
+    num_games += other.num_games;
+    num_turns_accum += other.num_turns_accum;
+    min_turns = std::min(min_turns, other.min_turns);
+    max_turns = std::max(max_turns, other.max_turns);
+    quality.merge(other.quality);
+}
+
+/**
+ * @brief Computes the log-likelihood ratios of both tests after the games of a trial.
+ * @param data A read-only reference to the TrialData object holding the games of a 2-player trial.
+ * @return An array of two doubles, the log-likelihood ratios of the alternatives that player 0 and player 1 are stronger.
+ */
+std::array<double, 2> SequentialTest::log_likelihood_ratios(const TrialData& data) const {
+    // Total shares of player 0 and of player 1
+    const double wins = static_cast<double>(data.win_shares_accum[0]) / static_cast<double>(TrialData::WIN_SHARE_DENOMINATOR);
+    const double losses = static_cast<double>(data.num_games) - wins;
+    const double up = std::log1p(2.0 * margin);
+    const double down = std::log1p(-2.0 * margin);
+    return {wins * up + losses * down, wins * down + losses * up};
+}
+
+/**
+ * @brief Gets the bound a log-likelihood ratio must reach to declare a player stronger.
+ * @return A double representing log(2 / (1 - confidence)).
+ */
+double SequentialTest::upper_threshold() const {
+    return std::log(2.0 / (1.0 - confidence));
+}
+
+/**
+ * @brief Gets the bound both log-likelihood ratios must be at or below to find no significant difference.
+ * @return A double representing log(1 - confidence).
+ */
+double SequentialTest::lower_threshold() const {
+    return std::log(1.0 - confidence);
+}
+
+/**
+ * @brief Gets the outcome of the test after the games of a trial.
+ * @param data A read-only reference to the TrialData object holding the games of a 2-player trial.
+ * @return An Outcome enum.
+ */
+SequentialTest::Outcome SequentialTest::decision(const TrialData& data) const {
+    const std::array<double, 2> llr = log_likelihood_ratios(data);
+    if (llr[0] >= upper_threshold()) {
+        return PLAYER_0_STRONGER;
+    }
+    if (llr[1] >= upper_threshold()) {
+        return PLAYER_1_STRONGER;
+    }
+    if (llr[0] <= lower_threshold() && llr[1] <= lower_threshold()) {
+        return NO_DIFFERENCE;
+    }
+    return UNDECIDED;
+}
+
+/**
+ * @brief Runs all games of a trial, possibly on several worker threads of a pool.
+ * @details Each worker constructs its own agents with get_players() (agents store per-game state, so they
+ * cannot be shared between threads), repeatedly claims the next chunk of games from a shared counter, runs
+ * those games on a single reused Game object, and accumulates the results into its own TrialData object.
+ * The results of all workers are merged at the end. A game involving a human player always runs on the calling thread, since it needs to
+ * interact with the terminal. Before game i is constructed, the worker moves its random number generator
+ * to stream i of the given seed. Every game therefore sees the same random values no matter which worker
+ * runs it, and since all accumulators are integers, the statistics of a trial only depend on the seed.
+ * With the batch engine, and if BatchGame supports the agents, each worker instead runs its games in lockstep on a BatchGame object, which refills its lanes from the same
+ * shared counter. Since BatchGame plays exactly the same games, the statistics do not depend on the engine.
+ * If a sequential test is given, the results are instead collected per chunk by the worker running it, without locking,
+ * and each completed chunk is handed over under a lock, once per chunk. The chunks are handed to the test in order,
+ * each one once it and all earlier chunks have completed. As soon as the test reaches a decision, no more chunks
+ * are claimed, and the games of later chunks that were already running are discarded. The trial therefore stops after
+ * the same number of games (a multiple of the chunk size, or num_simulations) for any number of workers and either engine.
+ * @param inputs A read-only vector of ints containing the user inputs as collected by get_inputs().
+ * @param num_simulations An int representing the number of games to run, or the maximum number if a sequential test is used.
+ * @param use_evaluation A bool indicating whether the evaluation function should be used.
+ * @param pool A reference to the WorkerPool running the games. All of its workers are used, unless there are fewer games.
+ * @param engine An Engine enum selecting how the games are simulated.
+ * @param seed A 64-bit integer representing the seed of the trial.
+ * @param test A read-only reference to the SequentialTest used to stop the trial early, if enabled. Requires 2 players.
+ * @param saved_game An int representing the index of the game whose evaluation history is saved.
+ * @param saved_history A reference to a vector into which the evaluation history of game saved_game is copied.
+ * Left untouched if use_evaluation is false.
+ * @return A TrialData object holding the accumulated statistics of all games.
+ */
+TrialData run_trial(const std::vector<int>& inputs, int num_simulations, bool use_evaluation, WorkerPool& pool,
+                    Engine engine, std::uint64_t seed, const SequentialTest& test, int saved_game, std::vector<double>& saved_history) {
+    const bool human_active = is_human_active(inputs, 23);
+    const size_t num_players = inputs.size() - 2;
+    const std::vector<int> agent_ids(inputs.begin() + 2, inputs.end());
+    const bool use_batch = engine == Engine::Batch && BatchGame::supports(agent_ids);
+
+    if (test.enabled() && num_players != 2) {
+        throw std::runtime_error("The sequential test requires exactly 2 players.");
+    }
+
+    // Never use more workers than there are games, and only one if a human is playing
+    unsigned int num_threads = std::max(1u, std::min(pool.size(), static_cast<unsigned int>(num_simulations)));
+    if (human_active) {
+        num_threads = 1;
+    }
+
+    std::vector<TrialData> worker_data(num_threads, TrialData(num_players, use_evaluation));
+    std::vector<std::exception_ptr> worker_errors(num_threads, nullptr);
+
+    // Number of games claimed by a worker at a time. Large enough to keep contention on the counter
+    // negligible, small enough to balance the load at the end of the trial.
+    // The counter is 64-bit, so that claiming chunks past the last game cannot overflow it.
+    const std::int64_t chunk_size = 64;
+    std::atomic<std::int64_t> next_game = 0;
+
+    // State of the sequential test: the results of the completed chunks that cannot be tested yet, the first chunk not
+    // tested yet, and the results of all tested chunks. Each worker collects the chunks it is running in its own map,
+    // with their number of games done, and only takes the lock to hand over a completed chunk.
+    std::mutex test_mutex;
+    std::map<std::int64_t, TrialData> pending_chunks;
+    std::int64_t next_chunk = 0;
+    TrialData tested_data(num_players, use_evaluation);
+    std::atomic<bool> stopped = false;
+    std::vector<std::map<std::int64_t, std::tuple<std::int64_t, TrialData>>> worker_chunks(test.enabled() ? num_threads : 0);
+
+    // Lambda adding the results of game i to the statistics
+    auto add_game = [&](unsigned int worker_index, std::int64_t i, const GameData& stats) {
+        // Copy this game's evaluation history if it is the saved one.
+        // Each game is run by exactly one worker, so no synchronization is needed.
+        if (use_evaluation && i == saved_game) {
+            saved_history = stats.p0_evaluation_history;
+        }
+
+        if (!test.enabled()) {
+            worker_data[worker_index].add_game(stats);
+            return;
+        }
+
+        // All games of a chunk are run by the worker that claimed it
+        const std::int64_t chunk_index = i / chunk_size;
+        auto& chunks = worker_chunks[worker_index];
+        auto chunk = chunks.find(chunk_index);
+        if (chunk == chunks.end()) {
+            chunk = chunks.emplace(chunk_index, std::tuple(0, TrialData(num_players, use_evaluation))).first;
+        }
+        auto& [games_done, chunk_data] = chunk->second;
+        chunk_data.add_game(stats);
+        ++games_done;
+
+        const std::int64_t chunk_games = std::min<std::int64_t>(num_simulations, (chunk_index + 1) * chunk_size) - chunk_index * chunk_size;
+        if (games_done < chunk_games) {
+            return;
+        }
+
+        std::lock_guard<std::mutex> lock(test_mutex);
+        if (!stopped) {
+            pending_chunks.emplace(chunk_index, std::move(chunk_data));
+        }
+        chunks.erase(chunk);
+
+        // Test the completed chunks that follow the last tested one
+        while (!stopped) {
+            const auto next = pending_chunks.find(next_chunk);
+            if (next == pending_chunks.end()) {
+                break;
+            }
+
+            tested_data.merge(next->second);
+            pending_chunks.erase(next);
+            ++next_chunk;
+            stopped = test.decision(tested_data) != SequentialTest::UNDECIDED;
+        }
+    };
+
+    // Lambda run by each worker, claiming chunks of games until none are left
+    auto worker = [&](unsigned int worker_index) {
+        try {
+            if (use_batch) {
+                // Claim chunks of games as lanes of the batch become free
+                std::int64_t chunk_begin = 0;
+                std::int64_t chunk_end = 0;
+                auto claim_game = [&]() {
+                    if (chunk_begin == chunk_end) {
+                        if (stopped) {
+                            return -1;
+                        }
+                        chunk_begin = next_game.fetch_add(chunk_size);
+                        chunk_end = std::max(chunk_begin, std::min<std::int64_t>(num_simulations, chunk_begin + chunk_size));
+                        if (chunk_begin == chunk_end) {
+                            return -1;
+                        }
+                    }
+                    return static_cast<int>(chunk_begin++);
+                };
+
+                // The batch holds large arrays, so it is kept on the heap
+                auto batch = std::make_unique<BatchGame>(agent_ids, seed, use_evaluation);
+                batch->run(claim_game, [&](int i, const GameData& stats) {
+                    add_game(worker_index, i, stats);
+                });
+                return;
+            }
+
+            const std::vector<std::tuple<std::unique_ptr<Agent>, std::string>> players = get_players(inputs);
+
+            std::vector<Agent*> player_ptrs;
+            for (const auto& player : players) {
+                player_ptrs.push_back(std::get<0>(player).get());
+            }
+
+            // The game and its results are reused for all games run by this worker
+            Game game = Game(player_ptrs, human_active, use_evaluation);
+            GameData stats;
+
+            for (std::int64_t begin = next_game.fetch_add(chunk_size); begin < num_simulations && !stopped; begin = next_game.fetch_add(chunk_size)) {
+                const std::int64_t end = std::min<std::int64_t>(num_simulations, begin + chunk_size);
+                for (std::int64_t i = begin; i < end; ++i) {
+                    // Reset and run the game using the random stream of this game
+                    seed_rng(seed, static_cast<std::uint64_t>(i));
+                    game.reset();
+                    game.run(stats);
+
+                    add_game(worker_index, i, stats);
+                }
+            }
+        }
+        catch (...) {
+            worker_errors[worker_index] = std::current_exception();
+        }
+    };
+
+    // Run the workers on the pool, using the calling thread as the first worker
+    pool.run(num_threads, worker);
+
+    for (const auto& error : worker_errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    if (test.enabled()) {
+        return tested_data;
+    }
+
+    // Reduce the per-worker results
+    TrialData data(num_players, use_evaluation);
+    for (const auto& d : worker_data) {
+        data.merge(d);
+    }
+
+    return data;
+}
+
+/**
+ * @brief Default constructor.
+ * @details Zeroes the accumulators.
+ * @param num_agents A size_t representing the number of agents.
+ * @param games_per_deal A 64-bit integer representing the number of games in each deal.
+ */
+PairedStats::PairedStats(size_t num_agents, long long games_per_deal)
+    : num_agents(num_agents),
+      games_per_deal(games_per_deal),
+      num_deals(0) {
+
+    for (size_t m = 0; m < NUM_MEASURES; ++m) {
+        sum[m].assign(num_agents, 0);
+        cross_sum[m].assign(num_agents * num_agents, 0);
+        game_square_sum[m].assign(num_agents, 0);
+    }
+}
+
+/**
+ * @brief Adds the results of a single deal to the accumulators.
+ * @param deal_sum A read-only reference to the total of each agent over the games of the deal, for each measure.
+ * @param deal_square_sum A read-only reference to the sum of the squared values of each agent over the games of the deal, for each measure.
+ */
+void PairedStats::add_deal(const std::array<std::vector<long long>, NUM_MEASURES>& deal_sum,
+                           const std::array<std::vector<long long>, NUM_MEASURES>& deal_square_sum) {
+    ++num_deals;
+    for (size_t m = 0; m < NUM_MEASURES; ++m) {
+        for (size_t a = 0; a < num_agents; ++a) {
+            sum[m][a] += deal_sum[m][a];
+            game_square_sum[m][a] += deal_square_sum[m][a];
+            for (size_t b = 0; b < num_agents; ++b) {
+                cross_sum[m][a * num_agents + b] += deal_sum[m][a] * deal_sum[m][b];
+            }
+        }
+    }
+}
+
+/**
+ * @brief Merges the accumulators of another PairedStats object into this one.
+ * @param other A read-only reference to the PairedStats object to merge. Must have the same number of agents and seatings.
+ */
+void PairedStats::merge(const PairedStats& other) {
+    num_deals += other.num_deals;
+    for (size_t m = 0; m < NUM_MEASURES; ++m) {
+        for (size_t a = 0; a < num_agents; ++a) {
+            sum[m][a] += other.sum[m][a];
+            game_square_sum[m][a] += other.game_square_sum[m][a];
+        }
+        for (size_t k = 0; k < cross_sum[m].size(); ++k) {
+            cross_sum[m][k] += other.cross_sum[m][k];
+        }
+    }
+}
+
+/**
+ * @brief Gets the scale of a measure, i.e. the value of one unit of its accumulators.
+ * @param measure A Measure enum.
+ * @return A double representing the scale.
+ */
+static double measure_scale(PairedStats::Measure measure) {
+    return (measure == PairedStats::WIN_RATE) ? 1.0 / static_cast<double>(TrialData::WIN_SHARE_DENOMINATOR) : 1.0;
+}
+
+/**
+ * @brief Gets the average value of a measure for an agent, over all games.
+ * @param measure A Measure enum.
+ * @param agent A size_t representing the index of the agent.
+ * @return A double representing the average win rate or score.
+ */
+double PairedStats::mean(Measure measure, size_t agent) const {
+    return static_cast<double>(sum[measure][agent]) * measure_scale(measure) / static_cast<double>(num_deals * games_per_deal);
+}
+
+/**
+ * @brief Gets the standard error of mean() computed from the variance between deals.
+ * @param measure A Measure enum.
+ * @param agent A size_t representing the index of the agent.
+ * @return A double representing the standard error, or NaN if there are fewer than 2 deals.
+ */
+double PairedStats::paired_error(Measure measure, size_t agent) const {
+    return difference_error(measure, agent, num_agents);
+}
+
+/**
+ * @brief Gets the standard error that mean() would have if all games were independent.
+ * @param measure A Measure enum.
+ * @param agent A size_t representing the index of the agent.
+ * @return A double representing the standard error, or NaN if there is only 1 game.
+ */
+double PairedStats::independent_error(Measure measure, size_t agent) const {
+    const double n = static_cast<double>(num_deals * games_per_deal);
+    const double scale = measure_scale(measure);
+    const double mean_value = static_cast<double>(sum[measure][agent]) * scale / n;
+    const double variance = (static_cast<double>(game_square_sum[measure][agent]) * scale * scale - n * mean_value * mean_value) / (n - 1.0);
+    return std::sqrt(std::max(0.0, variance) / n);
+}
+
+/**
+ * @brief Gets the standard error of the difference between the means of two agents, computed from the variance between deals.
+ * @details The deal averages of the two agents are paired, so their correlation (e.g. from sharing the same dice) reduces the error.
+ * @param measure A Measure enum.
+ * @param agent A size_t representing the index of the first agent.
+ * @param other A size_t representing the index of the second agent, or num_agents to get the paired error of the first agent alone.
+ * @return A double representing the standard error, or NaN if there are fewer than 2 deals.
+ */
+double PairedStats::difference_error(Measure measure, size_t agent, size_t other) const {
+    const double n = static_cast<double>(num_deals);
+    const double scale = measure_scale(measure) / static_cast<double>(games_per_deal);
+
+    // Sums over deals of x and x^2, where x is the difference of the deal averages of the two agents
+    double x_sum = static_cast<double>(sum[measure][agent]);
+    double x_square_sum = static_cast<double>(cross_sum[measure][agent * num_agents + agent]);
+    if (other < num_agents) {
+        x_sum -= static_cast<double>(sum[measure][other]);
+        x_square_sum += static_cast<double>(cross_sum[measure][other * num_agents + other])
+                      - 2.0 * static_cast<double>(cross_sum[measure][agent * num_agents + other]);
+    }
+    x_sum *= scale;
+    x_square_sum *= scale * scale;
+
+    const double variance = (x_square_sum - x_sum * x_sum / n) / (n - 1.0);
+    return std::sqrt(std::max(0.0, variance) / n);
+}
+
+/**
+ * @brief Constructs the Game object of one seating of a deal of run_rotated_trial().
+ * @details The agent of each seat draws its random choices from the sub-stream given by its index in inputs (see
+ * Game::set_agent_substreams()), so its draws are the same in every seating.
+ * @param players A read-only reference to the agents, in the order of inputs.
+ * @param seating A read-only reference to a vector of size_t, where seating[s] is the index of the agent in seat s.
+ * @param use_evaluation A bool indicating whether the evaluation function should be used.
+ * @return The Game object of the seating.
+ */
+static Game make_seated_game(const std::vector<std::tuple<std::unique_ptr<Agent>, std::string>>& players,
+                             const std::vector<size_t>& seating, bool use_evaluation) {
+    std::vector<Agent*> player_ptrs;
+    std::vector<std::uint64_t> substreams;
+    for (const size_t agent : seating) {
+        player_ptrs.push_back(std::get<0>(players[agent]).get());
+        substreams.push_back(agent);
+    }
+
+    Game game(player_ptrs, false, use_evaluation);
+    game.set_agent_substreams(substreams);
+    return game;
+}
+
+/**
+ * @brief Runs a trial with common random numbers and seat rotation.
+ * @details Deal d plays one game for each permutation of the seats of the agents (2 games for 2 players, up to 120 for 5),
+ * all with stream d of the seed. Since the dice and the starting seat are drawn from their own parts of the stream, every
+ * seating sees exactly the same dice and the same starting seat, and only the agents' decisions differ. In particular,
+ * for 2 players, each agent plays both sides of the same dice. The deals are claimed in chunks by the workers of the pool,
+ * as in run_trial(). Each worker keeps one Game object (with its own agents) per seating, since the position of an agent is
+ * fixed when the game is constructed. The games are always simulated by Game objects, since the games of a deal must be
+ * combined before they are added to the paired statistics. The agents that make random choices draw them from
+ * sub-stream i of stream d, where i is the agent's index in the order of inputs (see make_seated_game()), so an
+ * agent's draws follow it from seat to seat and stay common to all seatings as long as its decisions are.
+ * @param inputs A read-only vector of ints containing the user inputs as collected by get_inputs(). Must not include a human player.
+ * @param num_deals An int representing the number of deals to play.
+ * @param use_evaluation A bool indicating whether the evaluation function should be used.
+ * @param pool A reference to the WorkerPool running the games.
+ * @param seed A 64-bit integer representing the seed of the trial.
+ * @param paired A reference to a PairedStats object receiving the statistics of the agents, indexed in the order of inputs.
+ * @return A TrialData object holding the statistics of all games, indexed by seat.
+ */
+TrialData run_rotated_trial(const std::vector<int>& inputs, int num_deals, bool use_evaluation, WorkerPool& pool,
+                            std::uint64_t seed, PairedStats& paired) {
+    if (is_human_active(inputs, 23)) {
+        throw std::runtime_error("Seat rotation cannot be used with a human player.");
+    }
+
+    const size_t num_players = inputs.size() - 2;
+
+    // Enumerate the seatings, where seating[s] is the agent in seat s
+    std::vector<std::vector<size_t>> seatings;
+    std::vector<size_t> seating(num_players);
+    for (size_t i = 0; i < num_players; ++i) {
+        seating[i] = i;
+    }
+    do {
+        seatings.push_back(seating);
+    } while (std::next_permutation(seating.begin(), seating.end()));
+
+    const unsigned int num_threads = std::max(1u, std::min(pool.size(), static_cast<unsigned int>(num_deals)));
+    std::vector<TrialData> worker_data(num_threads, TrialData(num_players, use_evaluation));
+    std::vector<PairedStats> worker_paired(num_threads, PairedStats(num_players, static_cast<long long>(seatings.size())));
+    std::vector<std::exception_ptr> worker_errors(num_threads, nullptr);
+
+    const std::int64_t chunk_size = 64;
+    std::atomic<std::int64_t> next_deal = 0;
+
+    auto worker = [&](unsigned int worker_index) {
+        try {
+            // One set of agents and one Game object per seating
+            std::vector<std::vector<std::tuple<std::unique_ptr<Agent>, std::string>>> players;
+            std::vector<Game> games;
+            for (const auto& seats : seatings) {
+                players.push_back(get_players(inputs));
+                games.push_back(make_seated_game(players.back(), seats, use_evaluation));
+            }
+
+            GameData stats;
+            std::array<std::vector<long long>, PairedStats::NUM_MEASURES> deal_sum;
+            std::array<std::vector<long long>, PairedStats::NUM_MEASURES> deal_square_sum;
+
+            for (std::int64_t begin = next_deal.fetch_add(chunk_size); begin < num_deals; begin = next_deal.fetch_add(chunk_size)) {
+                const std::int64_t end = std::min<std::int64_t>(num_deals, begin + chunk_size);
+                for (std::int64_t d = begin; d < end; ++d) {
+                    for (size_t m = 0; m < PairedStats::NUM_MEASURES; ++m) {
+                        deal_sum[m].assign(num_players, 0);
+                        deal_square_sum[m].assign(num_players, 0);
+                    }
+
+                    for (size_t p = 0; p < seatings.size(); ++p) {
+                        seed_rng(seed, static_cast<std::uint64_t>(d));
+                        games[p].reset();
+                        games[p].run(stats);
+                        worker_data[worker_index].add_game(stats);
+
+                        for (size_t s = 0; s < num_players; ++s) {
+                            const size_t agent = seatings[p][s];
+                            const bool won = std::find(stats.winners.begin(), stats.winners.end(), s) != stats.winners.end();
+                            const long long win_shares = won ? TrialData::WIN_SHARE_DENOMINATOR / static_cast<long long>(stats.winners.size()) : 0;
+                            const long long score = stats.final_score[s];
+                            deal_sum[PairedStats::WIN_RATE][agent] += win_shares;
+                            deal_square_sum[PairedStats::WIN_RATE][agent] += win_shares * win_shares;
+                            deal_sum[PairedStats::SCORE][agent] += score;
+                            deal_square_sum[PairedStats::SCORE][agent] += score * score;
+                        }
+                    }
+
+                    worker_paired[worker_index].add_deal(deal_sum, deal_square_sum);
+                }
+            }
+        }
+        catch (...) {
+            worker_errors[worker_index] = std::current_exception();
+        }
+    };
+
+    pool.run(num_threads, worker);
+
+    for (const auto& error : worker_errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    TrialData data(num_players, use_evaluation);
+    paired = PairedStats(num_players, static_cast<long long>(seatings.size()));
+    for (unsigned int w = 0; w < num_threads; ++w) {
+        data.merge(worker_data[w]);
+        paired.merge(worker_paired[w]);
+    }
+
+    return data;
+}
+
+/**
+ * @brief Replays a single game of a trial.
+ * @details Game i of a trial run by run_trial() only depends on the agents and on stream i of the seed, and a game of
+ * deal i of a trial run by run_rotated_trial() only depends on the agents, their seating, and stream i of the seed, so
+ * either can be played again on its own, e.g. to get the evaluation history of a game that was not saved during the trial.
+ * @param inputs A read-only vector of ints containing the user inputs as collected by get_inputs(). Must not include a human player.
+ * @param use_evaluation A bool indicating whether the evaluation function should be used.
+ * @param seed A 64-bit integer representing the seed of the trial.
+ * @param game_index An int representing the index of the game in the trial, or of its deal with seat rotation.
+ * @param seating A read-only reference to a vector of size_t holding the seating of the game in its deal of
+ * run_rotated_trial(), where seating[s] is the index in inputs of the agent in seat s, or empty for a game of run_trial().
+ * @param stats A reference to the GameData object receiving the results of the game.
+ */
+void replay_game(const std::vector<int>& inputs, bool use_evaluation, std::uint64_t seed, int game_index,
+                 const std::vector<size_t>& seating, GameData& stats) {
+    const std::vector<std::tuple<std::unique_ptr<Agent>, std::string>> players = get_players(inputs);
+
+    std::vector<Agent*> player_ptrs;
+    for (const auto& player : players) {
+        player_ptrs.push_back(std::get<0>(player).get());
+    }
+
+    Game game = seating.empty() ? Game(player_ptrs, false, use_evaluation) : make_seated_game(players, seating, use_evaluation);
+    seed_rng(seed, static_cast<std::uint64_t>(game_index));
+    game.reset();
+    game.run(stats);
+}
+
+/**
+ * @brief Gets the players of the game from the user inputs.
+ * @details For each integer in the vector of inputs starting after the first two (which are for
+ * the number of simulations and whether to use the evaluation function), create a tuple consisting
+ * of a unique pointer to a newly-constructed agent corresponding to that integer, plus a string
+ * representing the name of the agent.
+ * @param inputs A read-only vector of ints containing the user inputs as collected by the get_inputs() function.
+ * @return A vector of tuples of unique pointers to agents and strings representing the agent names.
+ */
+std::vector<std::tuple<std::unique_ptr<Agent>, std::string>> get_players(const std::vector<int>& inputs) {
+    std::vector<std::tuple<std::unique_ptr<Agent>, std::string>> players;
+    for (auto it = inputs.begin() + 2; it != inputs.end(); ++it) {
+        // It would be preferable to directly map these values to the desired constructor, but I
+        // don't know how to do that. This is fine for a small number of agents, though.
+        if (*it == 0) {
+            players.push_back(std::tuple(std::make_unique<Random>(), "Random"));
+        }
+        else if (*it >= 1 && *it <= 10) {
+            std::string name = "Greedy" + std::to_string(*it) + "Skip";
+            players.push_back(std::tuple(std::make_unique<Greedy>(*it), name));
+        }
+        else if (*it >= 11 && *it <= 20) {
+            std::string name = "Greedy" + std::to_string((*it - 10)) + "SkipImproved";
+            players.push_back(std::tuple(std::make_unique<GreedyImproved>(*it - 10), name));
+        }
+        else if (*it == 21) {
+            players.push_back(std::tuple(std::make_unique<RushLocks>(), "RushLocks"));
+        }
+        else if (*it == 22) {
+            players.push_back(std::tuple(std::make_unique<Computational>(), "Computational"));
+        }
+        else if (*it == 23) {
+            players.push_back(std::tuple(std::make_unique<Human>(), "Human"));
+        }
+        else if (*it == 24) {
+            players.push_back(std::tuple(std::make_unique<Solitaire>(), "Solitaire"));
+        }
+        else if (*it >= 25 && *it <= 29) {
+            // The node budget grows by a factor of 5 with each step
+            long long max_nodes = 2000;
+            for (int k = 25; k < *it; ++k) {
+                max_nodes *= 5;
+            }
+            std::string name = "Expectimax" + std::to_string(*it - 24);
+            players.push_back(std::tuple(std::make_unique<Expectimax>(max_nodes), name));
+        }
+        else if (*it >= 30 && *it <= 34) {
+            // The number of rollouts grows by a factor of 4 with each step
+            int rollouts_per_move = 250;
+            for (int k = 30; k < *it; ++k) {
+                rollouts_per_move *= 4;
+            }
+            std::string name = "Mcts" + std::to_string(*it - 29);
+            players.push_back(std::tuple(std::make_unique<Mcts>(rollouts_per_move), name));
+        }
+        else {
+            players.push_back(std::tuple(std::make_unique<Random>(), "Random"));
+        }
+    }
+
+    return players;
+}
+
+/**
+ * @brief Checks if a human player is present in the game.
+ * @param inputs A read-only vector of ints containing the user inputs as collected by the get_inputs() function.
+ * @param human_id An int corresponding to the human agent.
+ * @return A bool which is true if a human player was found, else false.
+ */
+bool is_human_active(const std::vector<int>& inputs, int human_id) {
+    return std::find(inputs.begin() + 2, inputs.end(), human_id) != inputs.end();
+}
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "agent.hpp"
+#include "game.hpp"
+#include "pool.hpp"
+#include "quality.hpp"
+
+/**
+ * @enum Engine trial.hpp "src/trial.hpp"
+ * @brief Used to select how the games of a trial are simulated.
+ */
+enum class Engine {
+    Scalar,     //< Every game is run by a Game object.
+    Batch       //< Games are run in lockstep by a BatchGame object if it supports the agents, else as for Scalar.
+};
+
+/**
+ * @struct TrialData trial.hpp "src/trial.hpp"
+ * @brief Accumulates statistics over the games of a trial.
+ * @details A trial is a sequence of simulated games between the same agents. When a trial
+ * is run on several threads, each worker owns one TrialData object and adds the results of
+ * its own games to it. The per-worker objects are then merged into a single TrialData object
+ * once all workers have finished. If the evaluation function is used, the quality criteria
+ * are accumulated from the evaluation history of each game as well. All sums are 64-bit integers,
+ * and the memory used does not depend on the number of games, so a trial can run any number of
+ * games that fits in an int.
+ */
+struct TrialData {
+    /// @brief Number of shares a win is split into. Divisible by every possible number of tied winners.
+    static constexpr long long WIN_SHARE_DENOMINATOR = 60;
+
+    std::vector<long long> win_shares_accum;    //< Number of win shares for each player. Ties award each winner an equal number of shares.
+    std::vector<long long> score_accum;     //< Sum of the final scores for each player.
+    long long num_games;                    //< Number of games added.
+    long long num_turns_accum;              //< Sum of the number of turns over all games.
+    int min_turns;                          //< Minimum number of turns over all games.
+    int max_turns;                          //< Maximum number of turns over all games.
+    bool use_evaluation;                    //< Whether the games have evaluation histories to accumulate into quality.
+    QualityCriteria quality;                //< Quality criteria of the games. Only accumulated if use_evaluation is true.
+
+    TrialData(size_t num_players, bool use_evaluation);
+    void add_game(const GameData& data);
+    void merge(const TrialData& other);
+
+    /**
+     * @brief Gets the number of wins of the given player.
+     * @param player A size_t representing the position of the player.
+     * @return A double representing the number of wins, where tied games count as a fraction of a win.
+     */
+    double get_num_wins(size_t player) const {
+        return static_cast<double>(win_shares_accum[player]) / static_cast<double>(WIN_SHARE_DENOMINATOR);
+    }
+};
+
+/**
+ * @struct SequentialTest trial.hpp "src/trial.hpp"
+ * @brief A pair of sequential probability ratio tests (SPRT) deciding whether one of two players is stronger, used to
+ * stop a trial early.
+ * @details Each test weighs the null hypothesis that player 0 wins with probability 0.5 against an alternative: player 0
+ * wins with probability 0.5 + margin for the first test, and 0.5 - margin for the second. A game won by player 0 with
+ * share s (1 for a win, 1/2 for a tie, 0 for a loss, as in TrialData) adds s * log(q / 0.5) + (1 - s) * log((1 - q) / 0.5)
+ * to the log-likelihood ratio of the test whose alternative is q. The trial stops as soon as either ratio reaches
+ * log(2 / (1 - confidence)), which declares that player stronger, or once both ratios are at or below
+ * log(1 - confidence), which finds no significant difference.
+ *
+ * Guarantees: the likelihood ratio of a test is a nonnegative supermartingale under its null hypothesis (ties only make
+ * it smaller), and its inverse under its alternative (neglecting ties), so by Ville's inequality, for any number of
+ * games and however the trial is stopped:
+ * - if both players are equally strong, a player is declared stronger with probability at most 1 - confidence;
+ * - if a player wins with probability at least 0.5 + margin, no significant difference is found with probability at
+ *   most 1 - confidence, and the other player is declared stronger with probability at most (1 - confidence) / 2.
+ * For win rates strictly between 0.5 and 0.5 + margin, either outcome may be reached. The ratios drift towards their
+ * bounds whatever the true win rate, so the trial usually stops well before the maximum number of games, but a trial
+ * that reaches it ends undecided.
+ */
+struct SequentialTest {
+    /// @brief Outcomes of the test.
+    enum Outcome {
+        UNDECIDED,          //< Neither player declared stronger, and no significant difference found yet.
+        PLAYER_0_STRONGER,  //< Player 0 wins more than half of the games.
+        PLAYER_1_STRONGER,  //< Player 1 wins more than half of the games.
+        NO_DIFFERENCE       //< No player wins 0.5 + margin of the games.
+    };
+
+    double confidence;  //< Confidence required to stop, in (0.5, 1), or 0 if all games are always run.
+    double margin;      //< Distance from 0.5 of the win rates of the alternative hypotheses, in (0, 0.5).
+
+    /// @brief Checks whether the test is used.
+    bool enabled() const { return confidence > 0.0; }
+
+    std::array<double, 2> log_likelihood_ratios(const TrialData& data) const;
+    double upper_threshold() const;
+    double lower_threshold() const;
+    Outcome decision(const TrialData& data) const;
+};
+
+/**
+ * @struct PairedStats trial.hpp "src/trial.hpp"
+ * @brief Accumulates paired statistics of the agents over the deals of a trial with seat rotation.
+ * @details A deal is a set of games played with the same dice and the same starting seat, one for each way of seating
+ * the agents (see run_rotated_trial()). Since every agent meets the same luck in every seat, the average result of an
+ * agent over a deal varies much less from deal to deal than the result of a single game, and its standard error over
+ * the deals is the paired standard error. For comparison, the standard error that the same number of independent
+ * games would give is kept as well. Two measures are tracked for each agent: its win rate (where ties count as a
+ * fraction of a win) and its final score. All sums are 64-bit integers, so the results do not depend on the order in
+ * which deals are added or merged.
+ */
+struct PairedStats {
+    /// @brief Measures tracked for each agent.
+    enum Measure {
+        WIN_RATE,       //< Win shares, in units of 1 / TrialData::WIN_SHARE_DENOMINATOR.
+        SCORE,          //< Final scores.
+        NUM_MEASURES
+    };
+
+    size_t num_agents;                                          //< Number of agents.
+    long long games_per_deal;                                   //< Number of seatings, i.e. games in each deal.
+    long long num_deals;                                        //< Number of deals added.
+    std::array<std::vector<long long>, NUM_MEASURES> sum;       //< Sum over deals of the total of each agent over the deal.
+    std::array<std::vector<long long>, NUM_MEASURES> cross_sum; //< Sum over deals of the products of the deal totals of each pair of agents, indexed [a * num_agents + b].
+    std::array<std::vector<long long>, NUM_MEASURES> game_square_sum;   //< Sum over games of the squared value of each agent.
+
+    PairedStats(size_t num_agents, long long games_per_deal);
+    void add_deal(const std::array<std::vector<long long>, NUM_MEASURES>& deal_sum,
+                  const std::array<std::vector<long long>, NUM_MEASURES>& deal_square_sum);
+    void merge(const PairedStats& other);
+
+    double mean(Measure measure, size_t agent) const;
+    double paired_error(Measure measure, size_t agent) const;
+    double independent_error(Measure measure, size_t agent) const;
+    double difference_error(Measure measure, size_t agent, size_t other) const;
+};
+
+TrialData run_trial(const std::vector<int>& inputs, int num_simulations, bool use_evaluation, WorkerPool& pool,
+                    Engine engine, std::uint64_t seed, const SequentialTest& test, int saved_game, std::vector<double>& saved_history);
+TrialData run_rotated_trial(const std::vector<int>& inputs, int num_deals, bool use_evaluation, WorkerPool& pool,
+                            std::uint64_t seed, PairedStats& paired);
+void replay_game(const std::vector<int>& inputs, bool use_evaluation, std::uint64_t seed, int game_index,
+                 const std::vector<size_t>& seating, GameData& stats);
+
+std::vector<std::tuple<std::unique_ptr<Agent>, std::string>> get_players(const std::vector<int>& inputs);
+bool is_human_active(const std::vector<int>& inputs, int human_id);
@@ -0,0 +1,287 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "game.hpp"
+#include "rng.hpp"
+#include "trial.hpp"
+#include "tuning.hpp"
+
+/// @brief Number of tuned parameters.
+static constexpr size_t NUM_PARAMETERS = 5;
+
+/// @brief Number of agents in the opponent pool.
+static constexpr size_t NUM_OPPONENTS = 3;
+
+/// @brief Gain of the SPSA step size.
+static constexpr double STEP_GAIN = 0.1;
+
+/// @brief Generations added to the step size schedule, which keeps the first steps from being too large.
+static constexpr double STEP_STABILITY = 10.0;
+
+/// @brief Gain of the SPSA perturbation size.
+static constexpr double PERTURBATION_GAIN = 0.05;
+
+/// @brief Low half of the stream used to draw the perturbation of a generation. Deals use the lower indices.
+static constexpr std::uint64_t PERTURBATION_STREAM = 0xFFFFFFFF;
+
+/// @brief Bit of a stream that is set for the deals validating a challenger to the best parameters. Never set by a generation below 2^31.
+static constexpr std::uint64_t VALIDATION_STREAM_BIT = std::uint64_t(1) << 63;
+
+/**
+ * @brief Gets pointers to the members of a Parameters object, in the order of the checkpoint file.
+ * @param parameters A reference to the Parameters object.
+ * @return An array of pointers to alpha, mu, delta, sigma, and epsilon.
+ */
+static std::array<double*, NUM_PARAMETERS> parameter_fields(Computational::Parameters& parameters) {
+    return {&parameters.alpha, &parameters.mu, &parameters.delta, &parameters.sigma, &parameters.epsilon};
+}
+
+/**
+ * @brief Creates an agent of the opponent pool.
+ * @details The opponents are Greedy2SkipImproved, RushLocks, and the Computational agent with its default parameters,
+ * which do not depend on QWIXX_COMPUTATIONAL_PARAMETERS, so every generation of a run is measured against the same pool.
+ * @param opponent A size_t representing the index of the opponent, less than NUM_OPPONENTS.
+ * @return A unique pointer to the newly-constructed agent.
+ */
+static std::unique_ptr<Agent> make_opponent(size_t opponent) {
+    switch (opponent) {
+        case 0: return std::make_unique<GreedyImproved>(2);
+        case 1: return std::make_unique<RushLocks>();
+        default: return std::make_unique<Computational>(Computational::Parameters{});
+    }
+}
+
+/**
+ * @brief Constructor for a new run starting from the default parameters.
+ * @param seed A 64-bit integer representing the seed of the run.
+ * @param games_per_opponent An int representing the number of deals played by each candidate against each opponent per generation.
+ */
+TuningState::TuningState(std::uint64_t seed, int games_per_opponent)
+    : seed(seed),
+      games_per_opponent(games_per_opponent),
+      generation(0),
+      current(),
+      best(),
+      best_win_rate(-1.0) {}
+
+/**
+ * @brief Reads a tuning state from a checkpoint file written by save().
+ * @param path A read-only reference to a string holding the path of the file.
+ * @return The TuningState read from the file.
+ * @throws std::runtime_error if the file cannot be opened or is not a checkpoint file.
+ */
+TuningState TuningState::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file) {
+        throw std::runtime_error("Could not open the tuning checkpoint " + path + ".");
+    }
+
+    TuningState state(0, 0);
+    std::string seed_name, games_name, generation_name, current_name, best_name, best_win_rate_name;
+    file >> seed_name >> state.seed >> games_name >> state.games_per_opponent >> generation_name >> state.generation >> current_name;
+    for (double* value : parameter_fields(state.current)) {
+        file >> *value;
+    }
+    file >> best_name;
+    for (double* value : parameter_fields(state.best)) {
+        file >> *value;
+    }
+    file >> best_win_rate_name >> state.best_win_rate;
+
+    if (file.fail() || seed_name != "seed" || games_name != "games_per_opponent" || generation_name != "generation"
+        || current_name != "current" || best_name != "best" || best_win_rate_name != "best_win_rate"
+        || state.games_per_opponent < 1 || state.generation < 0) {
+        throw std::runtime_error("The file " + path + " is not a tuning checkpoint.");
+    }
+    return state;
+}
+
+/**
+ * @brief Writes the tuning state to a checkpoint file.
+ * @details The file is a few "name value..." lines, with doubles written with enough digits to be read back exactly.
+ * It is written to a temporary file first and then renamed, so a run stopped while saving keeps its previous checkpoint.
+ * @param path A read-only reference to a string holding the path of the file.
+ * @throws std::runtime_error if the file cannot be written.
+ */
+void TuningState::save(const std::string& path) const {
+    const std::string temporary_path = path + ".tmp";
+    std::ofstream file(temporary_path);
+    file << std::setprecision(std::numeric_limits<double>::max_digits10)
+         << "seed " << seed << "\ngames_per_opponent " << games_per_opponent << "\ngeneration " << generation << "\ncurrent";
+    for (const double value : {current.alpha, current.mu, current.delta, current.sigma, current.epsilon}) {
+        file << ' ' << value;
+    }
+    file << "\nbest";
+    for (const double value : {best.alpha, best.mu, best.delta, best.sigma, best.epsilon}) {
+        file << ' ' << value;
+    }
+    file << "\nbest_win_rate " << best_win_rate << '\n';
+    file.close();
+
+    if (!file || std::rename(temporary_path.c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("Could not write the tuning checkpoint " + path + ".");
+    }
+}
+
+/**
+ * @brief Plays deals of two sets of parameters of the Computational agent against the opponent pool.
+ * @details Each set of parameters plays games_per_opponent deals against each opponent of the pool (see make_opponent()),
+ * where a deal is two 2-player games with the same dice, one in each seat. Both sets play exactly the same deals, so
+ * the difference of their win rates is not blurred by the luck of the dice. The deals are claimed in chunks by the
+ * workers of the pool. Deal d against opponent o uses stream first_stream | (o * games_per_opponent + d) of the seed,
+ * and wins are summed as integers, so the results do not depend on the number of threads.
+ * @param candidates A read-only reference to an array holding the two sets of parameters.
+ * @param seed A 64-bit integer representing the seed of the run.
+ * @param first_stream A 64-bit integer representing the stream of the first deal, with the low 32 bits clear.
+ * @param games_per_opponent An int representing the number of deals played against each opponent.
+ * @param pool A reference to the WorkerPool running the games.
+ * @return An array holding the win rate of each set of parameters against the pool.
+ */
+static std::array<double, 2> play_deals(const std::array<Computational::Parameters, 2>& candidates, std::uint64_t seed,
+                                        std::uint64_t first_stream, int games_per_opponent, WorkerPool& pool) {
+    const std::int64_t num_deals = static_cast<std::int64_t>(NUM_OPPONENTS) * games_per_opponent;
+    const unsigned int num_threads = static_cast<unsigned int>(std::max<std::int64_t>(1, std::min<std::int64_t>(pool.size(), num_deals)));
+    std::vector<std::array<long long, 2>> worker_win_shares(num_threads, {0, 0});
+    std::vector<std::exception_ptr> worker_errors(num_threads, nullptr);
+
+    const std::int64_t chunk_size = 16;
+    std::atomic<std::int64_t> next_deal = 0;
+
+    auto worker = [&](unsigned int worker_index) {
+        try {
+            // One pair of agents and one Game object for each candidate, opponent, and seat of the candidate
+            std::vector<std::unique_ptr<Agent>> agents;
+            std::vector<Game> games;
+            for (const Computational::Parameters& candidate : candidates) {
+                for (size_t o = 0; o < NUM_OPPONENTS; ++o) {
+                    for (size_t seat = 0; seat < 2; ++seat) {
+                        Agent* tuned = agents.emplace_back(std::make_unique<Computational>(candidate)).get();
+                        Agent* opponent = agents.emplace_back(make_opponent(o)).get();
+                        games.push_back(Game(seat == 0 ? std::vector<Agent*>{tuned, opponent} : std::vector<Agent*>{opponent, tuned}, false, false));
+                    }
+                }
+            }
+
+            GameData stats;
+            for (std::int64_t begin = next_deal.fetch_add(chunk_size); begin < num_deals; begin = next_deal.fetch_add(chunk_size)) {
+                const std::int64_t end = std::min(num_deals, begin + chunk_size);
+                for (std::int64_t d = begin; d < end; ++d) {
+                    const size_t o = static_cast<size_t>(d / games_per_opponent);
+                    for (size_t c = 0; c < candidates.size(); ++c) {
+                        for (size_t seat = 0; seat < 2; ++seat) {
+                            seed_rng(seed, first_stream | static_cast<std::uint64_t>(d));
+                            Game& game = games[(c * NUM_OPPONENTS + o) * 2 + seat];
+                            game.reset();
+                            game.run(stats);
+                            if (std::find(stats.winners.begin(), stats.winners.end(), seat) != stats.winners.end()) {
+                                worker_win_shares[worker_index][c] += TrialData::WIN_SHARE_DENOMINATOR / static_cast<long long>(stats.winners.size());
+                            }
+                        }
+                    }
+                }
+            }
+        }
+        catch (...) {
+            worker_errors[worker_index] = std::current_exception();
+        }
+    };
+
+    pool.run(num_threads, worker);
+
+    for (const auto& error : worker_errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    std::array<double, 2> win_rates;
+    const double num_games = static_cast<double>(2 * num_deals) * static_cast<double>(TrialData::WIN_SHARE_DENOMINATOR);
+    for (size_t c = 0; c < candidates.size(); ++c) {
+        long long win_shares = 0;
+        for (const auto& shares : worker_win_shares) {
+            win_shares += shares[c];
+        }
+        win_rates[c] = static_cast<double>(win_shares) / num_games;
+    }
+    return win_rates;
+}
+
+/**
+ * @brief Runs one generation of SPSA (simultaneous perturbation stochastic approximation) on the parameters of the
+ * Computational agent, and updates the tuning state.
+ * @details Every parameter is kept in [0, 1], since each is a discount factor or a fraction. In generation k, a random
+ * sign is drawn for each parameter, and the two candidates are the current parameters moved forward and backward by
+ * c_k = PERTURBATION_GAIN / (k + 1)^0.101 along these signs. Both candidates play the same deals against the opponent
+ * pool (see play_deals()), with the streams starting at k << 32, and each parameter moves by
+ * a_k * (difference of the win rates) / (2 * c_k * its sign), with a_k = STEP_GAIN / (k + 1 + STEP_STABILITY)^0.602,
+ * as in Spall's standard gain sequences.
+ *
+ * The average win rate of the two candidates estimates that of the current parameters. Taking the parameters with the
+ * highest such estimate would mostly pick the luckiest generation, so an estimate above the win rate of the best
+ * parameters only makes the current parameters a challenger: the challenger and the best parameters then play the same
+ * fresh deals, with the streams starting at VALIDATION_STREAM_BIT | (k << 32), and the challenger becomes the best
+ * parameters if it wins more of them. The win rate of the best parameters is the one measured on these deals.
+ * @param state A reference to the TuningState, which is moved to the next generation.
+ * @param pool A reference to the WorkerPool running the games.
+ * @return The TuningGeneration holding the candidates and their win rates.
+ * @throws std::runtime_error if a generation has more deals than fit in the low half of a stream.
+ */
+TuningGeneration run_tuning_generation(TuningState& state, WorkerPool& pool) {
+    const std::int64_t num_deals = static_cast<std::int64_t>(NUM_OPPONENTS) * state.games_per_opponent;
+    if (num_deals >= static_cast<std::int64_t>(PERTURBATION_STREAM)) {
+        throw std::runtime_error("Too many games per opponent for a tuning run.");
+    }
+
+    const double k = static_cast<double>(state.generation);
+    const double step = STEP_GAIN / std::pow(k + 1.0 + STEP_STABILITY, 0.602);
+    const double perturbation = PERTURBATION_GAIN / std::pow(k + 1.0, 0.101);
+    const std::uint64_t generation_stream = static_cast<std::uint64_t>(state.generation) << 32;
+
+    // Draw a sign for each parameter, and build the candidates
+    Philox perturbation_rng(state.seed, generation_stream | PERTURBATION_STREAM);
+    std::array<double, NUM_PARAMETERS> signs;
+    for (double& sign : signs) {
+        sign = (perturbation_rng() & 1) != 0 ? 1.0 : -1.0;
+    }
+
+    TuningGeneration result{{state.current, state.current}, {0.0, 0.0}, false};
+    for (size_t c = 0; c < result.candidates.size(); ++c) {
+        const std::array<double*, NUM_PARAMETERS> fields = parameter_fields(result.candidates[c]);
+        for (size_t i = 0; i < NUM_PARAMETERS; ++i) {
+            *fields[i] = std::clamp(*fields[i] + (c == 0 ? perturbation : -perturbation) * signs[i], 0.0, 1.0);
+        }
+    }
+
+    result.win_rates = play_deals(result.candidates, state.seed, generation_stream, state.games_per_opponent, pool);
+
+    // An estimate above that of the best parameters may just be lucky, so the current parameters must also beat the
+    // best ones on fresh deals before replacing them
+    const double win_rate = 0.5 * (result.win_rates[0] + result.win_rates[1]);
+    if (win_rate > state.best_win_rate) {
+        const std::array<double, 2> validation_win_rates = play_deals({state.current, state.best}, state.seed,
+                                                                      VALIDATION_STREAM_BIT | generation_stream, state.games_per_opponent, pool);
+        if (state.best_win_rate < 0.0 || validation_win_rates[0] > validation_win_rates[1]) {
+            state.best = state.current;
+            state.best_win_rate = validation_win_rates[0];
+            result.new_best = true;
+        }
+    }
+
+    const std::array<double*, NUM_PARAMETERS> fields = parameter_fields(state.current);
+    const double gradient_scale = (result.win_rates[0] - result.win_rates[1]) / (2.0 * perturbation);
+    for (size_t i = 0; i < NUM_PARAMETERS; ++i) {
+        *fields[i] = std::clamp(*fields[i] + step * gradient_scale / signs[i], 0.0, 1.0);
+    }
+    ++state.generation;
+
+    return result;
+}
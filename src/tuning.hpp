@@ -0,0 +1,40 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+#include "agent.hpp"
+#include "pool.hpp"
+
+/**
+ * @struct TuningState tuning.hpp "src/tuning.hpp"
+ * @brief The progress of a tuning run of the parameters of the Computational agent.
+ * @details Holds everything the next generation depends on, so a run stopped after any generation and resumed from
+ * the saved state (see save() and load()) continues exactly as if it had not been stopped, with any number of threads.
+ */
+struct TuningState {
+    std::uint64_t seed;                         //< Seed of the games and perturbations of the run.
+    int games_per_opponent;                     //< Number of deals played by each candidate against each opponent per generation.
+    int generation;                             //< Number of generations completed.
+    Computational::Parameters current;          //< Current estimate of the best parameters.
+    Computational::Parameters best;             //< Parameters that beat every earlier best on fresh deals (see run_tuning_generation()).
+    double best_win_rate;                       //< Win rate of the best parameters on the deals that validated them, or -1 before the first generation.
+
+    TuningState(std::uint64_t seed, int games_per_opponent);
+
+    static TuningState load(const std::string& path);
+    void save(const std::string& path) const;
+};
+
+/**
+ * @struct TuningGeneration tuning.hpp "src/tuning.hpp"
+ * @brief The candidates played in one generation of a tuning run, and their win rates.
+ */
+struct TuningGeneration {
+    std::array<Computational::Parameters, 2> candidates;    //< The current parameters moved forward and backward along the perturbation.
+    std::array<double, 2> win_rates;                        //< Win rate of each candidate against the opponent pool.
+    bool new_best;                                          //< Whether the current parameters were validated and became the best ones.
+};
+
+TuningGeneration run_tuning_generation(TuningState& state, WorkerPool& pool);
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "globals.hpp"
+
+/**
+ * @struct ZobristKeys zobrist.hpp "src/zobrist.hpp"
+ * @brief Random 64-bit keys for each feature of a position, combined with XOR into the position's hash.
+ * @details Each Scorepad keeps the XOR of the keys of its marked spaces and of its penalty count, and each State the
+ * XOR of the keys of the current player and of the locked rows (see State::key()). Marking a space or a penalty,
+ * locking a row, or passing the turn then changes the hash with one or two XORs. The keys of the turn count are not
+ * part of State::key(); searches whose values depend on the turn count mix them in themselves.
+ */
+struct ZobristKeys {
+    /// @brief Number of turn counts with their own key.
+    static constexpr size_t NUM_TURN_COUNT_KEYS = 64;
+
+    std::array<std::array<std::uint64_t, GameConstants::NUM_CELLS_PER_ROW>, GameConstants::NUM_ROWS> marks;    //< Key of each space of a scorepad.
+    std::array<std::uint64_t, GameConstants::MAX_PENALTIES + 1> penalties;      //< Key of each penalty count.
+    std::array<std::uint64_t, GameConstants::MAX_PLAYERS> curr_player;          //< Key of each current player.
+    std::array<std::uint64_t, GameConstants::NUM_ROWS> locked_rows;             //< Key of each locked row.
+    std::array<std::uint64_t, NUM_TURN_COUNT_KEYS> turn_counts;                 //< Key of each turn count.
+};
+
+/**
+ * @brief The keys used for Zobrist hashing.
+ * @details Drawn from SplitMix64 with a fixed seed, so the hash of a position is the same in every build and run.
+ * Generated at compile time.
+ */
+inline constexpr ZobristKeys zobrist_keys = [] {
+    std::uint64_t seed = 0x5157495858484153ull;
+    auto next = [&seed]() {
+        seed += 0x9E3779B97F4A7C15ull;
+        std::uint64_t x = seed;
+        x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+        x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+        return x ^ (x >> 31);
+    };
+
+    ZobristKeys keys{};
+    for (auto& row : keys.marks) {
+        for (std::uint64_t& key : row) {
+            key = next();
+        }
+    }
+    for (std::uint64_t& key : keys.penalties) {
+        key = next();
+    }
+    for (std::uint64_t& key : keys.curr_player) {
+        key = next();
+    }
+    for (std::uint64_t& key : keys.locked_rows) {
+        key = next();
+    }
+    for (std::uint64_t& key : keys.turn_counts) {
+        key = next();
+    }
+    return keys;
+}();
@@ -0,0 +1,61 @@
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include "game.hpp"
+#include "pool.hpp"
+#include "trial.hpp"
+
+/**
+ * @brief Checks whether two TrialData objects hold the same statistics.
+ * @param a A read-only reference to the first TrialData object.
+ * @param b A read-only reference to the second TrialData object.
+ * @return A bool which is true if all statistics are equal, else false.
+ */
+static bool same_statistics(const TrialData& a, const TrialData& b) {
+    return a.win_shares_accum == b.win_shares_accum && a.score_accum == b.score_accum && a.num_games == b.num_games
+           && a.num_turns_accum == b.num_turns_accum && a.min_turns == b.min_turns && a.max_turns == b.max_turns
+           && a.quality.num_games_by_moves == b.quality.num_games_by_moves
+           && a.quality.lead_changes_by_moves == b.quality.lead_changes_by_moves
+           && a.quality.sample_accum == b.quality.sample_accum;
+}
+
+/**
+ * @brief Test entry point.
+ * @details Runs rotated trials between agents that make random choices, and replays every game of every deal on its
+ * own with replay_game(). The replayed games must give exactly the statistics of the trial, i.e. every seating of a
+ * deal, including the original seating whose evaluation history main() prints, is replayed as it was played.
+ * @return An integer representing the exit status, 0 if all checks passed.
+ */
+int main() {
+    const std::uint64_t seed = 11;
+    const int num_deals = 3;
+    const std::vector<std::vector<int>> matchups = {
+        {num_deals, 1, 0, 30},  // Random vs Mcts1
+        {num_deals, 1, 25, 0},  // Expectimax1 vs Random
+    };
+    const std::vector<std::vector<size_t>> seatings = {{0, 1}, {1, 0}};
+
+    WorkerPool pool(2);
+    int failures = 0;
+    for (const std::vector<int>& inputs : matchups) {
+        PairedStats paired(2, static_cast<long long>(seatings.size()));
+        const TrialData trial = run_rotated_trial(inputs, num_deals, true, pool, seed, paired);
+
+        TrialData replayed(2, true);
+        for (int d = 0; d < num_deals; ++d) {
+            for (const std::vector<size_t>& seating : seatings) {
+                GameData stats;
+                replay_game(inputs, true, seed, d, seating, stats);
+                replayed.add_game(stats);
+            }
+        }
+
+        if (!same_statistics(trial, replayed)) {
+            std::cerr << "Replayed games differ from the rotated trial of agents " << inputs[2] << " and " << inputs[3] << '\n';
+            ++failures;
+        }
+    }
+
+    return failures == 0 ? 0 : 1;
+}